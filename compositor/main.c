@@ -570,6 +570,7 @@ usage(int error_code)
 		"Options for fbdev-backend.so:\n\n"
 		"  --tty=TTY\t\tThe tty to use\n"
 		"  --device=DEVICE\tThe framebuffer device to use\n"
+		"  --pixman-threads=N\tRender tiles with N worker threads\n"
 		"\n");
 #endif
 
@@ -595,6 +596,11 @@ usage(int error_code)
 		"  --transform=TR\tThe output transformation, TR is one of:\n"
 		"\tnormal 90 180 270 flipped flipped-90 flipped-180 flipped-270\n"
 		"  --use-pixman\t\tUse the pixman (CPU) renderer (default: no rendering)\n"
+		"  --pixman-threads=N\tRender tiles with N worker threads\n"
+		"  --refresh=MHZ\t\tRefresh rate of the outputs in mHz (default: 60000)\n"
+		"  --free-running\tRepaint as fast as possible, without pacing frames\n"
+		"  --virtual-clock\tAdvance presentation timestamps by exactly one\n"
+		"\t\t\trefresh period per frame\n"
 		"  --no-outputs\t\tDo not create any virtual outputs\n"
 		"\n");
 #endif
@@ -857,6 +863,8 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	struct xkb_rule_names xkb_names;
 	struct weston_config_section *s;
 	int repaint_msec;
+	int adaptive_repaint_window;
+	int coalesce_pointer_motion;
 	int vt_switching;
 
 	s = weston_config_get_section(config, "keyboard", NULL, NULL);
@@ -892,8 +900,19 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	} else {
 		ec->repaint_msec = repaint_msec;
 	}
-	weston_log("Output repaint window is %d ms maximum.\n",
-		   ec->repaint_msec);
+	weston_config_section_get_bool(s, "adaptive-repaint-window",
+				       &adaptive_repaint_window, false);
+	ec->adaptive_repaint_window = adaptive_repaint_window;
+	weston_config_section_get_bool(s, "coalesce-pointer-motion",
+				       &coalesce_pointer_motion, false);
+	ec->coalesce_pointer_motion = coalesce_pointer_motion;
+
+	if (ec->adaptive_repaint_window)
+		weston_log("Output repaint window is adaptive, "
+			   "%d ms until measured.\n", ec->repaint_msec);
+	else
+		weston_log("Output repaint window is %d ms maximum.\n",
+			   ec->repaint_msec);
 
 	return 0;
 }
@@ -1227,6 +1246,10 @@ load_headless_backend(struct weston_compositor *c,
 		{ WESTON_OPTION_INTEGER, "width", 0, &parsed_options->width },
 		{ WESTON_OPTION_INTEGER, "height", 0, &parsed_options->height },
 		{ WESTON_OPTION_BOOLEAN, "use-pixman", 0, &config.use_pixman },
+		{ WESTON_OPTION_INTEGER, "pixman-threads", 0, &config.pixman_threads },
+		{ WESTON_OPTION_INTEGER, "refresh", 0, &config.refresh },
+		{ WESTON_OPTION_BOOLEAN, "free-running", 0, &config.free_running },
+		{ WESTON_OPTION_BOOLEAN, "virtual-clock", 0, &config.virtual_clock },
 		{ WESTON_OPTION_STRING, "transform", 0, &transform },
 		{ WESTON_OPTION_BOOLEAN, "no-outputs", 0, &no_outputs },
 	};
@@ -1387,6 +1410,7 @@ load_fbdev_backend(struct weston_compositor *c,
 	const struct weston_option fbdev_options[] = {
 		{ WESTON_OPTION_INTEGER, "tty", 0, &config.tty },
 		{ WESTON_OPTION_STRING, "device", 0, &config.device },
+		{ WESTON_OPTION_INTEGER, "pixman-threads", 0, &config.pixman_threads },
 	};
 
 	parse_options(fbdev_options, ARRAY_LENGTH(fbdev_options), argc, argv);
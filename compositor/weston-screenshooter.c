@@ -26,6 +26,8 @@
 #include "config.h"
 
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <linux/input.h>
 
 #include "compositor.h"
@@ -40,6 +42,7 @@ struct screenshooter {
 	struct weston_process process;
 	struct wl_listener destroy_listener;
 	struct weston_recorder *recorder;
+	enum weston_recorder_compression recorder_compression;
 };
 
 static void
@@ -154,7 +157,9 @@ recorder_binding(struct weston_keyboard *keyboard, uint32_t time,
 			output = container_of(ec->output_list.next,
 					      struct weston_output, link);
 
-		shooter->recorder = weston_recorder_start(output, filename);
+		shooter->recorder =
+			weston_recorder_start_compressed(output, filename,
+					shooter->recorder_compression);
 	}
 }
 
@@ -172,6 +177,8 @@ WL_EXPORT void
 screenshooter_create(struct weston_compositor *ec)
 {
 	struct screenshooter *shooter;
+	struct weston_config_section *section;
+	char *compression;
 
 	shooter = zalloc(sizeof *shooter);
 	if (shooter == NULL)
@@ -179,6 +186,18 @@ screenshooter_create(struct weston_compositor *ec)
 
 	shooter->ec = ec;
 
+	section = weston_config_get_section(wet_get_config(ec),
+					    "recorder", NULL, NULL);
+	weston_config_section_get_string(section, "compression",
+					 &compression, "none");
+	if (strcmp(compression, "zlib") == 0)
+		shooter->recorder_compression =
+			WESTON_RECORDER_COMPRESSION_ZLIB;
+	else if (strcmp(compression, "none") != 0)
+		weston_log("Invalid recorder compression \"%s\", "
+			   "using none\n", compression);
+	free(compression);
+
 	shooter->global = wl_global_create(ec->wl_display,
 					   &weston_screenshooter_interface, 1,
 					   shooter, bind_shooter);
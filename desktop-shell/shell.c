@@ -567,7 +567,7 @@ create_focus_surface(struct weston_compositor *ec,
 	}
 
 	surface->committed = focus_surface_committed;
-	surface->output = output;
+	weston_surface_set_output(surface, output);
 	surface->is_mapped = true;
 	surface->committed_private = fsurf;
 	weston_surface_set_label_func(surface, focus_surface_get_label);
@@ -2374,6 +2374,7 @@ desktop_surface_removed(struct weston_desktop_surface *desktop_surface,
 	    shsurf->shell->win_close_animation_type == ANIMATION_FADE) {
 		pixman_region32_fini(&surface->pending.input);
 		pixman_region32_init(&surface->pending.input);
+		surface->pending.input_changed = true;
 		pixman_region32_fini(&surface->input);
 		pixman_region32_init(&surface->input);
 		weston_fade_run(shsurf->view, 1.0, 0.0, 300.0,
@@ -2424,7 +2425,7 @@ map(struct desktop_shell *shell, struct shell_surface *shsurf,
 	weston_view_update_transform(shsurf->view);
 	shsurf->view->is_mapped = true;
 	if (shsurf->state.maximized) {
-		surface->output = shsurf->output;
+		weston_surface_set_output(surface, shsurf->output);
 		shsurf->view->output = shsurf->output;
 	}
 
@@ -2511,7 +2512,7 @@ desktop_surface_committed(struct weston_desktop_surface *desktop_surface,
 		shell_configure_fullscreen(shsurf);
 	} else if (shsurf->state.maximized) {
 		set_maximized_position(shell, shsurf);
-		surface->output = shsurf->output;
+		weston_surface_set_output(surface, shsurf->output);
 	} else {
 		float from_x, from_y;
 		float to_x, to_y;
@@ -2910,7 +2911,8 @@ desktop_shell_set_background(struct wl_client *client,
 	surface->committed = background_committed;
 	surface->committed_private = shell;
 	weston_surface_set_label_func(surface, background_get_label);
-	surface->output = wl_resource_get_user_data(output_resource);
+	weston_surface_set_output(surface,
+				  wl_resource_get_user_data(output_resource));
 	view->output = surface->output;
 	weston_desktop_shell_send_configure(resource, 0,
 					    surface_resource,
@@ -2979,7 +2981,8 @@ desktop_shell_set_panel(struct wl_client *client,
 	surface->committed = panel_committed;
 	surface->committed_private = shell;
 	weston_surface_set_label_func(surface, panel_get_label);
-	surface->output = wl_resource_get_user_data(output_resource);
+	weston_surface_set_output(surface,
+				  wl_resource_get_user_data(output_resource));
 	view->output = surface->output;
 	weston_desktop_shell_send_configure(resource, 0,
 					    surface_resource,
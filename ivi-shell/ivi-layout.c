@@ -853,6 +853,7 @@ commit_screen_list(struct ivi_layout *layout)
 
 	/* Clear view list of layout ivi_layer */
 	wl_list_init(&layout->layout_layer.view_list.link);
+	weston_compositor_view_list_dirty(layout->compositor);
 
 	wl_list_for_each(iviscrn, &layout->screen_list, link) {
 		if (iviscrn->order.dirty) {
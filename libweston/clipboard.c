@@ -31,6 +31,7 @@
 #include <linux/input.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/uio.h>
 
 #include "compositor.h"
@@ -41,6 +42,7 @@ struct clipboard_source {
 	struct wl_array contents;
 	struct clipboard *clipboard;
 	struct wl_event_source *event_source;
+	struct wl_list clients;		/* clipboard_client::link */
 	uint32_t serial;
 	int refcount;
 	int fd;
@@ -53,6 +55,14 @@ struct clipboard {
 	struct clipboard_source *source;
 };
 
+struct clipboard_client {
+	struct wl_event_source *event_source;
+	struct wl_list link;
+	size_t offset;
+	struct clipboard_source *source;
+	int fd;
+};
+
 static void clipboard_client_create(struct clipboard_source *source, int fd);
 
 static void
@@ -77,6 +87,18 @@ clipboard_source_unref(struct clipboard_source *source)
 	free(source);
 }
 
+/* Clients are sent the contents as they come in, and wait for more once
+ * they have all of it while the source is still being read. */
+static void
+clipboard_source_wake_clients(struct clipboard_source *source)
+{
+	struct clipboard_client *client;
+
+	wl_list_for_each(client, &source->clients, link)
+		wl_event_source_fd_update(client->event_source,
+					  WL_EVENT_WRITABLE);
+}
+
 static int
 clipboard_source_data(int fd, uint32_t mask, void *data)
 {
@@ -98,12 +120,21 @@ clipboard_source_data(int fd, uint32_t mask, void *data)
 		close(fd);
 		source->event_source = NULL;
 	} else if (len < 0) {
-		clipboard_source_unref(source);
-		clipboard->source = NULL;
+		wl_event_source_remove(source->event_source);
+		close(fd);
+		source->event_source = NULL;
+		clipboard_source_wake_clients(source);
+		if (clipboard->source == source) {
+			clipboard->source = NULL;
+			clipboard_source_unref(source);
+		}
+		return 1;
 	} else {
 		source->contents.size += len;
 	}
 
+	clipboard_source_wake_clients(source);
+
 	return 1;
 }
 
@@ -148,6 +179,7 @@ clipboard_source_create(struct clipboard *clipboard,
 
 	wl_array_init(&source->contents);
 	wl_array_init(&source->base.mime_types);
+	wl_list_init(&source->clients);
 	source->base.resource = NULL;
 	source->base.accept = clipboard_source_accept;
 	source->base.send = clipboard_source_send;
@@ -182,33 +214,46 @@ clipboard_source_create(struct clipboard *clipboard,
 	return NULL;
 }
 
-struct clipboard_client {
-	struct wl_event_source *event_source;
-	size_t offset;
-	struct clipboard_source *source;
-};
+static void
+clipboard_client_destroy(struct clipboard_client *client)
+{
+	close(client->fd);
+	wl_event_source_remove(client->event_source);
+	wl_list_remove(&client->link);
+	clipboard_source_unref(client->source);
+	free(client);
+}
 
 static int
 clipboard_client_data(int fd, uint32_t mask, void *data)
 {
 	struct clipboard_client *client = data;
+	struct clipboard_source *source = client->source;
 	char *p;
 	size_t size;
 	int len;
 
-	size = client->source->contents.size;
-	p = client->source->contents.data;
-	len = write(fd, p + client->offset, size - client->offset);
-	if (len > 0)
+	size = source->contents.size;
+	p = source->contents.data;
+	if (client->offset < size) {
+		len = write(fd, p + client->offset, size - client->offset);
+		if (len < 0 && errno == EAGAIN)
+			return 1;
+		if (len <= 0) {
+			clipboard_client_destroy(client);
+			return 1;
+		}
 		client->offset += len;
-
-	if (client->offset == size || len <= 0) {
-		close(fd);
-		wl_event_source_remove(client->event_source);
-		clipboard_source_unref(client->source);
-		free(client);
 	}
 
+	if (client->offset < size)
+		return 1;
+
+	if (source->event_source)
+		wl_event_source_fd_update(client->event_source, 0);
+	else
+		clipboard_client_destroy(client);
+
 	return 1;
 }
 
@@ -221,14 +266,27 @@ clipboard_client_create(struct clipboard_source *source, int fd)
 		wl_display_get_event_loop(seat->compositor->wl_display);
 
 	client = zalloc(sizeof *client);
-	if (client == NULL)
+	if (client == NULL) {
+		close(fd);
 		return;
+	}
+
+	/* A slow reader must not block the compositor */
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 
-	client->source = source;
-	source->refcount++;
 	client->event_source =
 		wl_event_loop_add_fd(loop, fd, WL_EVENT_WRITABLE,
 				     clipboard_client_data, client);
+	if (client->event_source == NULL) {
+		close(fd);
+		free(client);
+		return;
+	}
+
+	client->fd = fd;
+	client->source = source;
+	source->refcount++;
+	wl_list_insert(&source->clients, &client->link);
 }
 
 static void
@@ -1198,6 +1198,31 @@ cursor_bo_update(struct drm_backend *b, struct gbm_bo *bo,
 		weston_log("failed update cursor: %m\n");
 }
 
+static void
+drm_output_move_cursor_plane(struct drm_output *output, struct weston_view *ev)
+{
+	struct drm_backend *b = to_drm_backend(output->base.compositor);
+	float x, y;
+
+	weston_view_to_global_float(ev, 0, 0, &x, &y);
+
+	/* From global to output space, output transform is guaranteed to be
+	 * NORMAL by drm_output_prepare_cursor_view().
+	 */
+	x = (x - output->base.x) * output->base.current_scale;
+	y = (y - output->base.y) * output->base.current_scale;
+
+	if (output->cursor_plane.x != x || output->cursor_plane.y != y) {
+		if (drmModeMoveCursor(b->drm.fd, output->crtc_id, x, y)) {
+			weston_log("failed to move cursor: %m\n");
+			b->cursors_are_broken = 1;
+		}
+
+		output->cursor_plane.x = x;
+		output->cursor_plane.y = y;
+	}
+}
+
 static void
 drm_output_set_cursor(struct drm_output *output)
 {
@@ -1206,7 +1231,6 @@ drm_output_set_cursor(struct drm_output *output)
 	struct drm_backend *b = to_drm_backend(output->base.compositor);
 	EGLint handle;
 	struct gbm_bo *bo;
-	float x, y;
 
 	output->cursor_view = NULL;
 	if (ev == NULL) {
@@ -1234,23 +1258,22 @@ drm_output_set_cursor(struct drm_output *output)
 		}
 	}
 
-	weston_view_to_global_float(ev, 0, 0, &x, &y);
+	drm_output_move_cursor_plane(output, ev);
+}
 
-	/* From global to output space, output transform is guaranteed to be
-	 * NORMAL by drm_output_prepare_cursor_view().
-	 */
-	x = (x - output->base.x) * output->base.current_scale;
-	y = (y - output->base.y) * output->base.current_scale;
+static int
+drm_output_move_cursor(struct weston_output *output_base,
+		       struct weston_view *ev)
+{
+	struct drm_output *output = to_drm_output(output_base);
+	struct drm_backend *b = to_drm_backend(output_base->compositor);
 
-	if (output->cursor_plane.x != x || output->cursor_plane.y != y) {
-		if (drmModeMoveCursor(b->drm.fd, output->crtc_id, x, y)) {
-			weston_log("failed to move cursor: %m\n");
-			b->cursors_are_broken = 1;
-		}
+	if (ev->plane != &output->cursor_plane || b->cursors_are_broken)
+		return -1;
 
-		output->cursor_plane.x = x;
-		output->cursor_plane.y = y;
-	}
+	drm_output_move_cursor_plane(output, ev);
+
+	return b->cursors_are_broken ? -1 : 0;
 }
 
 static void
@@ -2390,6 +2413,7 @@ drm_output_enable(struct weston_output *base)
 	output->base.start_repaint_loop = drm_output_start_repaint_loop;
 	output->base.repaint = drm_output_repaint;
 	output->base.assign_planes = drm_assign_planes;
+	output->base.move_cursor = drm_output_move_cursor;
 	output->base.set_dpms = drm_set_dpms;
 	output->base.switch_mode = drm_output_switch_mode;
 
@@ -758,6 +758,9 @@ fbdev_backend_create(struct weston_compositor *compositor,
 	if (pixman_renderer_init(compositor) < 0)
 		goto out_launcher;
 
+	if (pixman_renderer_set_threads(compositor, param->pixman_threads) < 0)
+		weston_log("Falling back to single threaded rendering\n");
+
 	if (fbdev_output_create(backend, param->device) < 0)
 		goto out_launcher;
 
@@ -34,7 +34,7 @@ extern "C" {
 
 #include "compositor.h"
 
-#define WESTON_FBDEV_BACKEND_CONFIG_VERSION 2
+#define WESTON_FBDEV_BACKEND_CONFIG_VERSION 3
 
 struct libinput_device;
 
@@ -52,6 +52,10 @@ struct weston_fbdev_backend_config {
 	 */
 	void (*configure_device)(struct weston_compositor *compositor,
 				 struct libinput_device *device);
+
+	/** Number of worker threads for tiled pixman rendering, 0 to
+	 * render on the compositor thread only. */
+	int pixman_threads;
 };
 
 #ifdef  __cplusplus
@@ -36,6 +36,7 @@
 #include "compositor.h"
 #include "compositor-headless.h"
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 #include "pixman-renderer.h"
 #include "presentation-time-server-protocol.h"
 #include "windowed-output-api.h"
@@ -46,6 +47,10 @@ struct headless_backend {
 
 	struct weston_seat fake_seat;
 	bool use_pixman;
+
+	int refresh;		/* mHz */
+	bool free_running;
+	bool virtual_clock;
 };
 
 struct headless_output {
@@ -53,6 +58,8 @@ struct headless_output {
 
 	struct weston_mode mode;
 	struct wl_event_source *finish_frame_timer;
+	struct wl_event_source *finish_frame_idle;
+	struct timespec vblank_base;	/* virtual clock origin, msc 0 */
 	uint32_t *image_buf;
 	pixman_image_t *image;
 };
@@ -69,40 +76,152 @@ to_headless_backend(struct weston_compositor *base)
 	return container_of(base->backend, struct headless_backend, base);
 }
 
+/* The virtual clock ticks at the configured refresh rate even in free
+ * running mode, where the outputs advertise no refresh rate at all. */
+static int64_t
+headless_output_period_nsec(struct headless_output *output)
+{
+	struct headless_backend *b = to_headless_backend(output->base.compositor);
+
+	return millihz_to_nsec(b->refresh);
+}
+
+/* Return the msc of the last virtual vblank at or before the current time. */
+static uint64_t
+headless_output_current_msc(struct headless_output *output)
+{
+	struct timespec now, gone;
+
+	weston_compositor_read_presentation_clock(output->base.compositor, &now);
+	timespec_sub(&gone, &now, &output->vblank_base);
+
+	return timespec_to_nsec(&gone) / headless_output_period_nsec(output);
+}
+
 static void
-headless_output_start_repaint_loop(struct weston_output *output)
+headless_output_vblank_time(struct headless_output *output, uint64_t msc,
+			    struct timespec *ts)
 {
+	timespec_add_nsec(ts, &output->vblank_base,
+			  msc * headless_output_period_nsec(output));
+}
+
+static void
+headless_output_start_repaint_loop(struct weston_output *output_base)
+{
+	struct headless_output *output = to_headless_output(output_base);
+	struct headless_backend *b = to_headless_backend(output_base->compositor);
 	struct timespec ts;
 
-	weston_compositor_read_presentation_clock(output->compositor, &ts);
-	weston_output_finish_frame(output, &ts, WP_PRESENTATION_FEEDBACK_INVALID);
+	if (!b->virtual_clock) {
+		weston_compositor_read_presentation_clock(output_base->compositor,
+							  &ts);
+	} else {
+		/* A free running virtual clock only advances with frames. */
+		if (!b->free_running)
+			output_base->msc = headless_output_current_msc(output);
+
+		headless_output_vblank_time(output, output_base->msc, &ts);
+	}
+
+	weston_output_finish_frame(output_base, &ts,
+				   WP_PRESENTATION_FEEDBACK_INVALID);
+}
+
+static void
+headless_output_finish_frame(struct headless_output *output)
+{
+	struct headless_backend *b = to_headless_backend(output->base.compositor);
+	struct timespec ts;
+	uint64_t msc;
+
+	if (!b->virtual_clock) {
+		output->base.msc++;
+		weston_compositor_read_presentation_clock(output->base.compositor,
+							  &ts);
+	} else {
+		/* A late frame is presented on the next vblank, not the
+		 * one it missed. */
+		msc = output->base.msc + 1;
+		if (!b->free_running)
+			msc = MAX(msc, headless_output_current_msc(output));
+
+		output->base.msc = msc;
+		headless_output_vblank_time(output, msc, &ts);
+	}
+
+	weston_output_finish_frame(&output->base, &ts, 0);
 }
 
 static int
 finish_frame_handler(void *data)
 {
 	struct headless_output *output = data;
-	struct timespec ts;
 
-	weston_compositor_read_presentation_clock(output->base.compositor, &ts);
-	weston_output_finish_frame(&output->base, &ts, 0);
+	headless_output_finish_frame(output);
 
 	return 1;
 }
 
+static void
+finish_frame_idle_handler(void *data)
+{
+	struct headless_output *output = data;
+
+	output->finish_frame_idle = NULL;
+	headless_output_finish_frame(output);
+}
+
+/* Return the delay in milliseconds until the next frame completes. */
+static int
+headless_output_frame_delay(struct headless_output *output)
+{
+	struct headless_backend *b = to_headless_backend(output->base.compositor);
+	struct timespec now, next, left;
+	uint64_t msc;
+	int64_t nsec;
+
+	if (!b->virtual_clock) {
+		nsec = headless_output_period_nsec(output);
+	} else {
+		msc = MAX(output->base.msc,
+			  headless_output_current_msc(output)) + 1;
+		headless_output_vblank_time(output, msc, &next);
+
+		weston_compositor_read_presentation_clock(output->base.compositor,
+							  &now);
+		timespec_sub(&left, &next, &now);
+
+		/* round up so the timer never fires before the vblank */
+		nsec = timespec_to_nsec(&left) + 999999;
+	}
+
+	return MAX(nsec / 1000000, 1);
+}
+
 static int
 headless_output_repaint(struct weston_output *output_base,
 		       pixman_region32_t *damage)
 {
 	struct headless_output *output = to_headless_output(output_base);
 	struct weston_compositor *ec = output->base.compositor;
+	struct headless_backend *b = to_headless_backend(ec);
+	struct wl_event_loop *loop;
 
 	ec->renderer->repaint_output(&output->base, damage);
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
 				 &ec->primary_plane.damage, damage);
 
-	wl_event_source_timer_update(output->finish_frame_timer, 16);
+	if (b->free_running) {
+		loop = wl_display_get_event_loop(ec->wl_display);
+		output->finish_frame_idle =
+			wl_event_loop_add_idle(loop, finish_frame_idle_handler,
+					       output);
+	} else {
+		wl_event_source_timer_update(output->finish_frame_timer,
+					     headless_output_frame_delay(output));
+	}
 
 	return 0;
 }
@@ -117,6 +236,10 @@ headless_output_disable(struct weston_output *base)
 		return 0;
 
 	wl_event_source_remove(output->finish_frame_timer);
+	if (output->finish_frame_idle) {
+		wl_event_source_remove(output->finish_frame_idle);
+		output->finish_frame_idle = NULL;
+	}
 
 	if (b->use_pixman) {
 		pixman_renderer_output_destroy(&output->base);
@@ -149,6 +272,10 @@ headless_output_enable(struct weston_output *base)
 	output->finish_frame_timer =
 		wl_event_loop_add_timer(loop, finish_frame_handler, output);
 
+	output->base.msc = 0;
+	weston_compositor_read_presentation_clock(b->compositor,
+						  &output->vblank_base);
+
 	if (b->use_pixman) {
 		output->image_buf = malloc(output->base.current_mode->width *
 					   output->base.current_mode->height * 4);
@@ -184,6 +311,7 @@ headless_output_set_size(struct weston_output *base,
 			 int width, int height)
 {
 	struct headless_output *output = to_headless_output(base);
+	struct headless_backend *b = to_headless_backend(base->compositor);
 	int output_width, output_height;
 
 	/* We can only be called once. */
@@ -199,7 +327,8 @@ headless_output_set_size(struct weston_output *base,
 		WL_OUTPUT_MODE_CURRENT | WL_OUTPUT_MODE_PREFERRED;
 	output->mode.width = output_width;
 	output->mode.height = output_height;
-	output->mode.refresh = 60000;
+	/* A refresh rate of 0 means unknown, frames are not paced. */
+	output->mode.refresh = b->free_running ? 0 : b->refresh;
 	wl_list_init(&output->base.mode_list);
 	wl_list_insert(&output->base.mode_list, &output->mode.link);
 
@@ -283,9 +412,17 @@ headless_backend_create(struct weston_compositor *compositor,
 	b->base.destroy = headless_destroy;
 	b->base.restore = headless_restore;
 
+	b->refresh = config->refresh;
+	b->free_running = config->free_running;
+	b->virtual_clock = config->virtual_clock;
+
 	b->use_pixman = config->use_pixman;
 	if (b->use_pixman) {
 		pixman_renderer_init(compositor);
+
+		if (pixman_renderer_set_threads(compositor,
+						config->pixman_threads) < 0)
+			weston_log("Falling back to single threaded rendering\n");
 	}
 
 	if (!b->use_pixman && noop_renderer_init(compositor) < 0)
@@ -332,6 +469,9 @@ backend_init(struct weston_compositor *compositor,
 	config_init_to_defaults(&config);
 	memcpy(&config, config_base, config_base->struct_size);
 
+	if (config.refresh <= 0)
+		config.refresh = 60000;
+
 	b = headless_backend_create(compositor, &config);
 	if (b == NULL)
 		return -1;
@@ -34,13 +34,29 @@ extern "C" {
 
 #include "compositor.h"
 
-#define WESTON_HEADLESS_BACKEND_CONFIG_VERSION 2
+#define WESTON_HEADLESS_BACKEND_CONFIG_VERSION 4
 
 struct weston_headless_backend_config {
 	struct weston_backend_config base;
 
 	/** Whether to use the pixman renderer instead of the OpenGL ES renderer. */
 	int use_pixman;
+
+	/** Number of worker threads for tiled pixman rendering, 0 to
+	 * render on the compositor thread only. */
+	int pixman_threads;
+
+	/** Refresh rate of the outputs in mHz, 0 for the 60 Hz default. */
+	int refresh;
+
+	/** Whether to start the next frame as soon as the previous one has
+	 * been drawn instead of pacing frames at the refresh rate. The
+	 * outputs then advertise an unknown refresh rate. */
+	int free_running;
+
+	/** Whether to report presentation timestamps from a virtual clock
+	 * that advances by exactly one refresh period per frame. */
+	int virtual_clock;
 };
 
 #ifdef  __cplusplus
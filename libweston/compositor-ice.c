@@ -126,6 +126,7 @@ struct ice_output {
 	struct ice_plane planes[4];
 	struct ice_plane cursor_plane;
 	struct ice_cursor cursor;
+	struct weston_plane_planner planner;
 	gdl_upp_zorder_t pending_zorder;
 	gdl_upp_zorder_t zorder;
 	int num_planes;
@@ -1597,6 +1598,34 @@ ice_output_assign_cursor_view(struct ice_output *output,
 	return &plane->base;
 }
 
+static int
+ice_output_move_cursor(struct weston_output *base, struct weston_view *view)
+{
+	struct ice_output *output = ice_output(base);
+	struct ice_plane *plane = &output->cursor_plane;
+	int ret;
+
+	if (view->plane != &plane->base || output->flip_pending ||
+	    plane->pending_scanout.valid || !plane->scanout.valid ||
+	    plane->scanout.fb_id != output->cursor.surface_info.id)
+		return -1;
+
+	dbg("move cursor\n");
+
+	// only the plane rectangles change: the stacking order is kept and
+	// the cursor surface is flipped again, so the flip completes at once
+	if (ice_plane_assign_cursor(plane, &output->cursor, view))
+		return -1;
+
+	memset(&output->pending_zorder, 0, sizeof (gdl_upp_zorder_t));
+
+	ret = ice_plane_commit_flip(plane);
+	if (ret == 0)
+		ret = ice_plane_finish_flip(plane);
+
+	return ret;
+}
+
 static struct weston_plane *
 ice_output_assign_sideband_view(struct ice_output *output,
 				struct weston_view *view)
@@ -1677,11 +1706,13 @@ ice_output_assign_graphics_view(struct ice_output *output,
 }
 
 static struct weston_plane *
-ice_output_assign_plane(struct ice_output *output, struct weston_view *view,
+ice_output_assign_plane(struct ice_output *output,
+			struct weston_plane_candidate *candidate,
 			pixman_region32_t *composited_region)
 {
 	struct weston_compositor *ec = output->base.compositor;
 	struct ice_backend *backend = ice_backend(ec);
+	struct weston_view *view = candidate->view;
 	struct weston_plane *plane;
 	struct weston_plane *primary;
 	struct weston_surface *surface;
@@ -1694,18 +1725,28 @@ ice_output_assign_plane(struct ice_output *output, struct weston_view *view,
 		return primary;
 	}
 
+	/* Set for occluded views too, which may be uncovered and put on a
+	 * plane later without a new commit. */
+	surface = view->surface;
+	surface->keep_buffer = surface->buffer_ref.buffer &&
+		!wl_shm_buffer_get(surface->buffer_ref.buffer->resource);
+
+	if (candidate->occluded) {
+		// hidden by opaque views above, no need for a plane
+		view->psf_flags = 0;
+		return &output->planner.occluded_plane;
+	}
+
 	if (view->layer_link.layer == &ec->cursor_layer) {
 		if ((plane = ice_output_assign_cursor_view(output, view)))
 			return plane;
 	}
 
-	surface = view->surface;
-	surface->keep_buffer = surface->buffer_ref.buffer &&
-		!wl_shm_buffer_get(surface->buffer_ref.buffer->resource);
-
+	/* The composited framebuffer only matters where the view is
+	 * visible, but it covers the whole of the views it composites. */
 	pixman_region32_init(&overlap);
 	pixman_region32_intersect(&overlap, composited_region,
-				  &view->transform.boundingbox);
+				  &candidate->visible);
 
 	plane = ice_output_assign_sideband_view(output, view);
 	if (plane == NULL && pixman_region32_not_empty(&overlap))
@@ -1736,9 +1777,8 @@ static void
 ice_output_assign_planes(struct weston_output *output)
 {
 	struct ice_output *iceout = ice_output(output);
-	struct weston_compositor *compositor = output->compositor;
+	struct weston_plane_candidate *candidate;
 	struct weston_plane *plane;
-	struct weston_view *ev;
 	pixman_region32_t composited_region;
 
 	dbg("assign planes\n");
@@ -1754,9 +1794,9 @@ ice_output_assign_planes(struct weston_output *output)
 	 * be composited using the GPU with the SRB api.
 	 *
 	 * Views are assigned to planes starting at the bottom of the stack.
-	 * Unfortunately we cannot easily know if the view is hidden or
-	 * overlapped, so we might be assigning a plane for nothing. It is
-	 * assumed the TV shell does not stack windows on each other.
+	 * Views hidden by opaque views above them get no plane, and a
+	 * view only needs the primary plane if composited views below it
+	 * overlap its visible part.
 	 *
 	 * The framebuffer background needs to be transparent and the clear
 	 * damage must be tracked. For that we use the transparent and opaque
@@ -1764,11 +1804,14 @@ ice_output_assign_planes(struct weston_output *output)
 	 * back off the primary plane.
 	 */
 
+	weston_plane_planner_update(&iceout->planner);
+
 	pixman_region32_init(&composited_region);
 
-	wl_list_for_each_reverse(ev, &compositor->view_list, link) {
-		plane = ice_output_assign_plane(iceout, ev, &composited_region);
-		weston_view_move_to_plane(ev, plane);
+	weston_plane_planner_for_each(candidate, &iceout->planner) {
+		plane = ice_output_assign_plane(iceout, candidate,
+						&composited_region);
+		weston_view_move_to_plane(candidate->view, plane);
 	}
 
 	pixman_region32_fini(&composited_region);
@@ -1900,6 +1943,7 @@ ice_output_destroy(struct weston_output *base)
 		weston_plane_release(&output->planes[i].base);
 
 	weston_plane_release(&output->cursor_plane.base);
+	weston_plane_planner_release(&output->planner);
 	weston_output_destroy(&output->base);
 
 	free(output);
@@ -2056,6 +2100,8 @@ create_output(struct ice_backend *b, gdl_display_id_t disp_id,
 	weston_output_init(&output->base, ec, 0, 0, 0, 0,
 			   WL_OUTPUT_TRANSFORM_NORMAL, 1);
 
+	weston_plane_planner_init(&output->planner, ec);
+
 	ice_plane_init(&output->cursor_plane, GDL_PLANE_ID_IAP_B, output);
 	weston_compositor_stack_plane(ec, &output->cursor_plane.base, NULL);
 
@@ -2083,6 +2129,7 @@ create_output(struct ice_backend *b, gdl_display_id_t disp_id,
 	output->base.start_repaint_loop = ice_output_start_repaint_loop;
 	output->base.assign_planes = ice_output_assign_planes;
 	output->base.repaint = ice_output_repaint;
+	output->base.move_cursor = ice_output_move_cursor;
 	output->base.switch_mode = ice_output_switch_mode;
 	output->base.destroy = ice_output_destroy;
 	//output->base.disable_planes = 1;
@@ -2103,6 +2150,7 @@ create_output(struct ice_backend *b, gdl_display_id_t disp_id,
 	return output;
 
 err_output:
+	weston_plane_planner_release(&output->planner);
 	weston_output_destroy(&output->base);
 	ice_output_clear_modes(output);
 	free(output);
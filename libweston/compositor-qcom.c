@@ -143,6 +143,8 @@ struct qcom_output {
 	struct qcom_fence *current_fence, *next_fence;
 
 	pixman_region32_t previous_damage;
+
+	struct weston_plane_planner planner;
 };
 
 struct qcom_plane {
@@ -1002,11 +1004,13 @@ reject:
 }
 
 static struct weston_plane *
-qcom_output_assign_plane(struct qcom_output *output, struct weston_view *view,
+qcom_output_assign_plane(struct qcom_output *output,
+			 struct weston_plane_candidate *candidate,
 			 pixman_region32_t *composited_region)
 {
 	struct weston_compositor *ec = output->base.compositor;
 	struct qcom_backend *backend = qcom_backend(ec);
+	struct weston_view *view = candidate->view;
 	struct weston_plane *plane;
 	struct weston_plane *primary;
 	struct weston_surface *surface;
@@ -1019,6 +1023,12 @@ qcom_output_assign_plane(struct qcom_output *output, struct weston_view *view,
 		return primary;
 	}
 
+	if (candidate->occluded) {
+		// hidden by opaque views above, do not waste a pipe on it
+		view->psf_flags = 0;
+		return &output->planner.occluded_plane;
+	}
+
 #if 0
 	if (view->layer_link.layer == &ec->cursor_layer) {
 		if ((plane = ice_output_assign_cursor_view(output, view)))
@@ -1039,9 +1049,11 @@ qcom_output_assign_plane(struct qcom_output *output, struct weston_view *view,
 	    extents->x1, extents->y1);
 #endif
 
+	/* The composited framebuffer only matters where the view is
+	 * visible, but it covers the whole of the views it composites. */
 	pixman_region32_init(&overlap);
 	pixman_region32_intersect(&overlap, composited_region,
-				  &view->transform.boundingbox);
+				  &candidate->visible);
 
 	plane = NULL;
 	if (!pixman_region32_not_empty(&overlap))
@@ -1074,19 +1086,22 @@ static void
 qcom_output_assign_planes(struct weston_output *base)
 {
 	struct qcom_output *output = qcom_output(base);
-	struct weston_compositor *compositor = base->compositor;
+	struct weston_plane_candidate *candidate;
 	struct weston_plane *plane;
-	struct weston_view *ev;
 	pixman_region32_t composited_region;
 
 	dbg("assign planes\n");
 
+	weston_plane_planner_update(&output->planner);
+	dbg("%d views, %d occluded\n", output->planner.n_candidates,
+	    output->planner.n_occluded);
+
 	pixman_region32_init(&composited_region);
 
-	wl_list_for_each_reverse(ev, &compositor->view_list, link) {
-		plane = qcom_output_assign_plane(output, ev,
+	weston_plane_planner_for_each(candidate, &output->planner) {
+		plane = qcom_output_assign_plane(output, candidate,
 						 &composited_region);
-		weston_view_move_to_plane(ev, plane);
+		weston_view_move_to_plane(candidate->view, plane);
 	}
 
 	pixman_region32_fini(&composited_region);
@@ -1408,6 +1423,7 @@ qcom_output_destroy(struct weston_output *base)
 	if (close(output->fd) < 0)
 		weston_log("failed to close frame buffer: %m\n");
 
+	weston_plane_planner_release(&output->planner);
 	weston_output_destroy(&output->base);
 
 	free(output);
@@ -1516,6 +1532,7 @@ qcom_output_create(struct qcom_backend *backend, const char *device)
 	output->base.disable = NULL;
 
 	weston_output_init(&output->base, backend->compositor);
+	weston_plane_planner_init(&output->planner, backend->compositor);
 	weston_compositor_add_pending_output(&output->base,
 					     backend->compositor);
 
@@ -30,6 +30,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <linux/input.h>
 
 #if HAVE_FREERDP_VERSION_H
@@ -112,14 +115,52 @@ struct rdp_peers_item {
 	int flags;
 	freerdp_peer *peer;
 	struct weston_seat *seat;
+	/* Damage of the frames skipped while the peer could not keep up */
+	pixman_region32_t missed_damage;
 
 	struct wl_list link;
 };
 
+enum rdp_codec {
+	RDP_CODEC_RAW = (1 << 0),
+	RDP_CODEC_NSC = (1 << 1),
+	RDP_CODEC_RFX = (1 << 2),
+};
+
+/* Encodes the damage of a repaint on a worker thread, once per codec for
+ * all the peers using it. The worker owns everything but the mutex
+ * protected fields from the start of a job until done_fd is signalled. */
+struct rdp_encoder {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool job_ready;		/* queued or being encoded, protected by mutex */
+	bool quit;		/* protected by mutex */
+	int done_fd;
+	struct wl_event_source *done_source;
+
+	/* Compositor thread only: a job is out, its result not sent yet */
+	bool busy;
+	/* Damage of the repaints to encode next */
+	pixman_region32_t pending_damage;
+
+	pixman_image_t *snapshot;	/* the damaged pixels of the job */
+	pixman_region32_t damage;
+	uint32_t codecs;
+	RFX_CONTEXT *rfx_context;
+	RFX_RECT *rfx_rects;
+	wStream *rfx_stream;
+	NSC_CONTEXT *nsc_context;
+	wStream *nsc_stream;
+	BYTE *raw_data;		/* the damaged rectangles flipped, in order */
+	size_t raw_size;
+};
+
 struct rdp_output {
 	struct weston_output base;
 	struct wl_event_source *finish_frame_timer;
 	pixman_image_t *shadow_surface;
+	struct rdp_encoder encoder;
 
 	struct wl_list peers;
 };
@@ -336,6 +377,512 @@ rdp_peer_refresh_region(pixman_region32_t *region, freerdp_peer *peer)
 		rdp_peer_refresh_raw(region, output->shadow_surface, peer);
 }
 
+static uint32_t
+rdp_peer_codec(freerdp_peer *peer)
+{
+	rdpSettings *settings = peer->settings;
+
+	if (settings->RemoteFxCodec)
+		return RDP_CODEC_RFX;
+	else if (settings->NSCodec)
+		return RDP_CODEC_NSC;
+	else
+		return RDP_CODEC_RAW;
+}
+
+static void
+rdp_encoder_encode_rfx(struct rdp_encoder *encoder)
+{
+	pixman_region32_t *damage = &encoder->damage;
+	pixman_image_t *image = encoder->snapshot;
+	int width, height, nrects, i;
+	pixman_box32_t *region, *rects;
+	uint32_t *ptr;
+	RFX_RECT *rfxRect, *rfx_rects;
+
+	Stream_Clear(encoder->rfx_stream);
+	Stream_SetPosition(encoder->rfx_stream, 0);
+
+	width = (damage->extents.x2 - damage->extents.x1);
+	height = (damage->extents.y2 - damage->extents.y1);
+
+	ptr = pixman_image_get_data(image) + damage->extents.x1 +
+				damage->extents.y1 * (pixman_image_get_stride(image) / sizeof(uint32_t));
+
+	rects = pixman_region32_rectangles(damage, &nrects);
+	rfx_rects = realloc(encoder->rfx_rects, nrects * sizeof *rfxRect);
+	if (!rfx_rects) {
+		encoder->codecs &= ~RDP_CODEC_RFX;
+		return;
+	}
+	encoder->rfx_rects = rfx_rects;
+
+	for (i = 0; i < nrects; i++) {
+		region = &rects[i];
+		rfxRect = &encoder->rfx_rects[i];
+
+		rfxRect->x = (region->x1 - damage->extents.x1);
+		rfxRect->y = (region->y1 - damage->extents.y1);
+		rfxRect->width = (region->x2 - region->x1);
+		rfxRect->height = (region->y2 - region->y1);
+	}
+
+	rfx_compose_message(encoder->rfx_context, encoder->rfx_stream,
+			encoder->rfx_rects, nrects, (BYTE *)ptr, width, height,
+			pixman_image_get_stride(image));
+}
+
+static void
+rdp_encoder_encode_nsc(struct rdp_encoder *encoder)
+{
+	pixman_region32_t *damage = &encoder->damage;
+	pixman_image_t *image = encoder->snapshot;
+	int width, height;
+	uint32_t *ptr;
+
+	Stream_Clear(encoder->nsc_stream);
+	Stream_SetPosition(encoder->nsc_stream, 0);
+
+	width = (damage->extents.x2 - damage->extents.x1);
+	height = (damage->extents.y2 - damage->extents.y1);
+
+	ptr = pixman_image_get_data(image) + damage->extents.x1 +
+				damage->extents.y1 * (pixman_image_get_stride(image) / sizeof(uint32_t));
+
+	nsc_compose_message(encoder->nsc_context, encoder->nsc_stream, (BYTE *)ptr,
+			width, height, pixman_image_get_stride(image));
+}
+
+static void
+rdp_encoder_encode_raw(struct rdp_encoder *encoder)
+{
+	pixman_box32_t *rect;
+	size_t size = 0;
+	BYTE *dest;
+	int nrects, i;
+
+	rect = pixman_region32_rectangles(&encoder->damage, &nrects);
+	for (i = 0; i < nrects; i++)
+		size += (size_t)(rect[i].x2 - rect[i].x1) *
+			(rect[i].y2 - rect[i].y1) * 4;
+
+	if (size > encoder->raw_size) {
+		dest = realloc(encoder->raw_data, size);
+		if (!dest) {
+			encoder->codecs &= ~RDP_CODEC_RAW;
+			return;
+		}
+		encoder->raw_data = dest;
+		encoder->raw_size = size;
+	}
+
+	dest = encoder->raw_data;
+	for (i = 0; i < nrects; i++) {
+		pixman_image_flipped_subrect(&rect[i], encoder->snapshot, dest);
+		dest += (rect[i].x2 - rect[i].x1) * (rect[i].y2 - rect[i].y1) * 4;
+	}
+}
+
+static void
+rdp_encoder_signal_done(struct rdp_encoder *encoder)
+{
+	uint64_t one = 1;
+	ssize_t len;
+
+	do {
+		len = write(encoder->done_fd, &one, sizeof one);
+	} while (len < 0 && errno == EINTR);
+
+	/* EAGAIN: the counter is full, so the compositor has a wakeup
+	 * pending already. */
+	if (len < 0 && errno != EAGAIN)
+		weston_log("Failed to signal the RDP encoder job: %m\n");
+}
+
+static void *
+rdp_encoder_thread(void *data)
+{
+	struct rdp_encoder *encoder = data;
+
+	pthread_mutex_lock(&encoder->mutex);
+	for (;;) {
+		while (!encoder->job_ready && !encoder->quit)
+			pthread_cond_wait(&encoder->cond, &encoder->mutex);
+		if (encoder->quit)
+			break;
+		pthread_mutex_unlock(&encoder->mutex);
+
+		if (encoder->codecs & RDP_CODEC_RFX)
+			rdp_encoder_encode_rfx(encoder);
+		if (encoder->codecs & RDP_CODEC_NSC)
+			rdp_encoder_encode_nsc(encoder);
+		if (encoder->codecs & RDP_CODEC_RAW)
+			rdp_encoder_encode_raw(encoder);
+
+		pthread_mutex_lock(&encoder->mutex);
+		encoder->job_ready = false;
+		pthread_cond_broadcast(&encoder->cond);
+		rdp_encoder_signal_done(encoder);
+	}
+	pthread_mutex_unlock(&encoder->mutex);
+
+	return NULL;
+}
+
+/* Hands the pending damage to the encoder, unless it is still busy with
+ * the last one: the frames in between are dropped and their damage sent
+ * with the next. */
+static void
+rdp_encoder_start(struct rdp_output *output)
+{
+	struct rdp_encoder *encoder = &output->encoder;
+	struct rdp_peers_item *item;
+	pixman_box32_t *rects;
+	uint32_t codecs = 0;
+	int nrects, i;
+
+	if (encoder->busy ||
+	    !pixman_region32_not_empty(&encoder->pending_damage))
+		return;
+
+	wl_list_for_each(item, &output->peers, link) {
+		if ((item->flags & RDP_PEER_ACTIVATED) &&
+		    (item->flags & RDP_PEER_OUTPUT_ENABLED))
+			codecs |= rdp_peer_codec(item->peer);
+	}
+
+	/* Peers get a full refresh when they are activated. */
+	if (!codecs) {
+		pixman_region32_clear(&encoder->pending_damage);
+		return;
+	}
+
+	/* The next repaints draw into the shadow surface while the job is
+	 * encoded, it works on a copy of the damaged pixels. */
+	rects = pixman_region32_rectangles(&encoder->pending_damage, &nrects);
+	for (i = 0; i < nrects; i++)
+		pixman_image_composite32(PIXMAN_OP_SRC, output->shadow_surface,
+					 NULL, encoder->snapshot,
+					 rects[i].x1, rects[i].y1, 0, 0,
+					 rects[i].x1, rects[i].y1,
+					 rects[i].x2 - rects[i].x1,
+					 rects[i].y2 - rects[i].y1);
+
+	pixman_region32_copy(&encoder->damage, &encoder->pending_damage);
+	pixman_region32_clear(&encoder->pending_damage);
+	encoder->codecs = codecs;
+	encoder->busy = true;
+
+	pthread_mutex_lock(&encoder->mutex);
+	encoder->job_ready = true;
+	pthread_cond_broadcast(&encoder->cond);
+	pthread_mutex_unlock(&encoder->mutex);
+}
+
+/* Waits for the job being encoded and drops its result */
+static void
+rdp_encoder_cancel(struct rdp_encoder *encoder)
+{
+	pthread_mutex_lock(&encoder->mutex);
+	while (encoder->job_ready)
+		pthread_cond_wait(&encoder->cond, &encoder->mutex);
+	pthread_mutex_unlock(&encoder->mutex);
+
+	encoder->busy = false;
+	pixman_region32_clear(&encoder->pending_damage);
+}
+
+static void
+rdp_peer_send_surface_bits(freerdp_peer *peer, pixman_box32_t *extents,
+			   UINT32 codecID, wStream *stream)
+{
+	rdpUpdate *update = peer->update;
+	SURFACE_BITS_COMMAND cmd;
+
+	memset(&cmd, 0, sizeof(cmd));
+#ifdef HAVE_SKIP_COMPRESSION
+	cmd.skipCompression = TRUE;
+#endif
+	cmd.destLeft = extents->x1;
+	cmd.destTop = extents->y1;
+	cmd.destRight = extents->x2;
+	cmd.destBottom = extents->y2;
+	cmd.bpp = 32;
+	cmd.codecID = codecID;
+	cmd.width = extents->x2 - extents->x1;
+	cmd.height = extents->y2 - extents->y1;
+	cmd.bitmapDataLength = Stream_GetPosition(stream);
+	cmd.bitmapData = Stream_Buffer(stream);
+
+	update->SurfaceBits(update->context, &cmd);
+}
+
+static void
+rdp_peer_send_raw(freerdp_peer *peer, struct rdp_encoder *encoder)
+{
+	rdpUpdate *update = peer->update;
+	SURFACE_FRAME_MARKER *marker = &update->surface_frame_marker;
+	SURFACE_BITS_COMMAND cmd;
+	pixman_box32_t *rect;
+	BYTE *data = encoder->raw_data;
+	int nrects, i;
+	int heightIncrement, remainingHeight, top;
+
+	rect = pixman_region32_rectangles(&encoder->damage, &nrects);
+	if (!nrects)
+		return;
+
+	marker->frameId++;
+	marker->frameAction = SURFACECMD_FRAMEACTION_BEGIN;
+	update->SurfaceFrameMarker(peer->context, marker);
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.bpp = 32;
+	cmd.codecID = 0;
+
+	for (i = 0; i < nrects; i++, rect++) {
+		cmd.destLeft = rect->x1;
+		cmd.destRight = rect->x2;
+		cmd.width = rect->x2 - rect->x1;
+
+		heightIncrement = peer->settings->MultifragMaxRequestSize / (16 + cmd.width * 4);
+		remainingHeight = rect->y2 - rect->y1;
+		top = rect->y1;
+
+		while (remainingHeight) {
+			cmd.height = MIN(remainingHeight, heightIncrement);
+			cmd.destTop = top;
+			cmd.destBottom = top + cmd.height;
+			cmd.bitmapDataLength = cmd.width * cmd.height * 4;
+			/* The rectangle is flipped, its last rows come first */
+			cmd.bitmapData = data +
+				(rect->y2 - cmd.destBottom) * cmd.width * 4;
+
+			update->SurfaceBits(peer->context, &cmd);
+
+			remainingHeight -= cmd.height;
+			top += cmd.height;
+		}
+
+		data += (rect->x2 - rect->x1) * (rect->y2 - rect->y1) * 4;
+	}
+
+	marker->frameAction = SURFACECMD_FRAMEACTION_END;
+	update->SurfaceFrameMarker(peer->context, marker);
+}
+
+#if FREERDP_VERSION_MAJOR >= 2
+/* Wakes the peer up when its socket drains, see rdp_peer_flush_missed() */
+static void
+rdp_peer_watch_writable(freerdp_peer *peer, bool watch)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	uint32_t mask = WL_EVENT_READABLE;
+	int i;
+
+	if (watch)
+		mask |= WL_EVENT_WRITABLE;
+
+	for (i = 0; i < MAX_FREERDP_FDS; i++) {
+		if (context->events[i])
+			wl_event_source_fd_update(context->events[i], mask);
+	}
+}
+
+/* Sends a write blocked peer what it missed once it drained, as there may
+ * be no further frame to carry it when the screen went idle meanwhile. */
+static void
+rdp_peer_flush_missed(freerdp_peer *peer)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	struct rdp_peers_item *item = &context->item;
+
+	peer->DrainOutputBuffer(peer);
+	if (peer->IsWriteBlocked(peer))
+		return;
+
+	if ((item->flags & RDP_PEER_ACTIVATED) &&
+	    (item->flags & RDP_PEER_OUTPUT_ENABLED) &&
+	    pixman_region32_not_empty(&item->missed_damage)) {
+		rdp_peer_refresh_region(&item->missed_damage, peer);
+		pixman_region32_clear(&item->missed_damage);
+	}
+
+	rdp_peer_watch_writable(peer, peer->IsWriteBlocked(peer));
+}
+#endif
+
+static void
+rdp_peer_send_encoded(struct rdp_encoder *encoder, struct rdp_peers_item *item)
+{
+	freerdp_peer *peer = item->peer;
+	uint32_t codec = rdp_peer_codec(peer);
+
+#if FREERDP_VERSION_MAJOR >= 2
+	/* A peer that cannot keep up skips frames instead of stalling the
+	 * compositor, and is sent what it missed once it drained. */
+	if (peer->IsWriteBlocked(peer)) {
+		pixman_region32_union(&item->missed_damage,
+				      &item->missed_damage, &encoder->damage);
+		rdp_peer_watch_writable(peer, true);
+		return;
+	}
+#endif
+
+	if (!(encoder->codecs & codec)) {
+		/* Activated after the job started */
+		pixman_region32_union(&item->missed_damage,
+				      &item->missed_damage, &encoder->damage);
+	} else if (codec == RDP_CODEC_RFX) {
+		rdp_peer_send_surface_bits(peer, &encoder->damage.extents,
+					   peer->settings->RemoteFxCodecId,
+					   encoder->rfx_stream);
+	} else if (codec == RDP_CODEC_NSC) {
+		rdp_peer_send_surface_bits(peer, &encoder->damage.extents,
+					   peer->settings->NSCodecId,
+					   encoder->nsc_stream);
+	} else {
+		rdp_peer_send_raw(peer, encoder);
+	}
+
+	/* Sent from the shadow surface, which is at least as recent as the
+	 * frame just sent. */
+	if (pixman_region32_not_empty(&item->missed_damage)) {
+		rdp_peer_refresh_region(&item->missed_damage, peer);
+		pixman_region32_clear(&item->missed_damage);
+	}
+}
+
+static int
+rdp_encoder_done(int fd, uint32_t mask, void *data)
+{
+	struct rdp_output *output = data;
+	struct rdp_encoder *encoder = &output->encoder;
+	struct rdp_peers_item *item;
+	uint64_t count;
+	bool done;
+
+	if (read(fd, &count, sizeof count) != sizeof count)
+		return 0;
+
+	pthread_mutex_lock(&encoder->mutex);
+	done = !encoder->job_ready;
+	pthread_mutex_unlock(&encoder->mutex);
+
+	/* Still encoding, or cancelled */
+	if (!done || !encoder->busy)
+		return 0;
+
+	wl_list_for_each(item, &output->peers, link) {
+		if ((item->flags & RDP_PEER_ACTIVATED) &&
+		    (item->flags & RDP_PEER_OUTPUT_ENABLED))
+			rdp_peer_send_encoded(encoder, item);
+	}
+
+	encoder->busy = false;
+	rdp_encoder_start(output);
+
+	return 0;
+}
+
+static void
+rdp_encoder_release(struct rdp_encoder *encoder)
+{
+	if (encoder->done_source)
+		wl_event_source_remove(encoder->done_source);
+	if (encoder->done_fd >= 0)
+		close(encoder->done_fd);
+	if (encoder->snapshot)
+		pixman_image_unref(encoder->snapshot);
+	if (encoder->rfx_context)
+		rfx_context_free(encoder->rfx_context);
+	if (encoder->nsc_context)
+		nsc_context_free(encoder->nsc_context);
+	if (encoder->rfx_stream)
+		Stream_Free(encoder->rfx_stream, TRUE);
+	if (encoder->nsc_stream)
+		Stream_Free(encoder->nsc_stream, TRUE);
+	free(encoder->rfx_rects);
+	free(encoder->raw_data);
+
+	pixman_region32_fini(&encoder->damage);
+	pixman_region32_fini(&encoder->pending_damage);
+	pthread_cond_destroy(&encoder->cond);
+	pthread_mutex_destroy(&encoder->mutex);
+
+	memset(encoder, 0, sizeof *encoder);
+	encoder->done_fd = -1;
+}
+
+static int
+rdp_encoder_init(struct rdp_output *output, struct wl_event_loop *loop)
+{
+	struct rdp_encoder *encoder = &output->encoder;
+	int width = output->base.current_mode->width;
+	int height = output->base.current_mode->height;
+
+	memset(encoder, 0, sizeof *encoder);
+	pixman_region32_init(&encoder->damage);
+	pixman_region32_init(&encoder->pending_damage);
+	pthread_mutex_init(&encoder->mutex, NULL);
+	pthread_cond_init(&encoder->cond, NULL);
+
+	encoder->snapshot = pixman_image_create_bits(PIXMAN_x8r8g8b8,
+						     width, height, NULL,
+						     width * 4);
+
+#if FREERDP_VERSION_MAJOR == 1 && FREERDP_VERSION_MINOR == 1
+	encoder->rfx_context = rfx_context_new();
+#else
+	encoder->rfx_context = rfx_context_new(TRUE);
+#endif
+	encoder->nsc_context = nsc_context_new();
+	encoder->rfx_stream = Stream_New(NULL, 65536);
+	encoder->nsc_stream = Stream_New(NULL, 65536);
+	encoder->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (!encoder->snapshot || !encoder->rfx_context ||
+	    !encoder->nsc_context || !encoder->rfx_stream ||
+	    !encoder->nsc_stream || encoder->done_fd < 0)
+		goto err;
+
+	encoder->rfx_context->mode = RLGR3;
+	encoder->rfx_context->width = width;
+	encoder->rfx_context->height = height;
+	rfx_context_set_pixel_format(encoder->rfx_context, RDP_PIXEL_FORMAT_B8G8R8A8);
+	nsc_context_set_pixel_format(encoder->nsc_context, RDP_PIXEL_FORMAT_B8G8R8A8);
+	RFX_RESET(encoder->rfx_context, width, height);
+	NSC_RESET(encoder->nsc_context, width, height);
+
+	encoder->done_source = wl_event_loop_add_fd(loop, encoder->done_fd,
+						    WL_EVENT_READABLE,
+						    rdp_encoder_done, output);
+	if (!encoder->done_source)
+		goto err;
+
+	if (pthread_create(&encoder->thread, NULL,
+			   rdp_encoder_thread, encoder) != 0)
+		goto err;
+
+	return 0;
+
+err:
+	weston_log("Failed to create the RDP encoder.\n");
+	rdp_encoder_release(encoder);
+	return -1;
+}
+
+static void
+rdp_encoder_destroy(struct rdp_encoder *encoder)
+{
+	pthread_mutex_lock(&encoder->mutex);
+	encoder->quit = true;
+	pthread_cond_broadcast(&encoder->cond);
+	pthread_mutex_unlock(&encoder->mutex);
+	pthread_join(encoder->thread, NULL);
+
+	rdp_encoder_release(encoder);
+}
+
 static void
 rdp_output_start_repaint_loop(struct weston_output *output)
 {
@@ -350,19 +897,14 @@ rdp_output_repaint(struct weston_output *output_base, pixman_region32_t *damage)
 {
 	struct rdp_output *output = container_of(output_base, struct rdp_output, base);
 	struct weston_compositor *ec = output->base.compositor;
-	struct rdp_peers_item *outputPeer;
 
 	pixman_renderer_output_set_buffer(output_base, output->shadow_surface);
 	ec->renderer->repaint_output(&output->base, damage);
 
 	if (pixman_region32_not_empty(damage)) {
-		wl_list_for_each(outputPeer, &output->peers, link) {
-			if ((outputPeer->flags & RDP_PEER_ACTIVATED) &&
-					(outputPeer->flags & RDP_PEER_OUTPUT_ENABLED))
-			{
-				rdp_peer_refresh_region(damage, outputPeer->peer);
-			}
-		}
+		pixman_region32_union(&output->encoder.pending_damage,
+				      &output->encoder.pending_damage, damage);
+		rdp_encoder_start(output);
 	}
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
@@ -415,9 +957,10 @@ static int
 rdp_switch_mode(struct weston_output *output, struct weston_mode *target_mode)
 {
 	struct rdp_output *rdpOutput = container_of(output, struct rdp_output, base);
+	struct rdp_encoder *encoder = &rdpOutput->encoder;
 	struct rdp_peers_item *rdpPeer;
 	rdpSettings *settings;
-	pixman_image_t *new_shadow_buffer;
+	pixman_image_t *new_shadow_buffer, *new_snapshot;
 	struct weston_mode *local_mode;
 
 	local_mode = ensure_matching_mode(output, target_mode);
@@ -429,6 +972,16 @@ rdp_switch_mode(struct weston_output *output, struct weston_mode *target_mode)
 	if (local_mode == output->current_mode)
 		return 0;
 
+	/* Allocated before anything is switched, the mode is kept if this
+	 * fails. */
+	new_snapshot = pixman_image_create_bits(PIXMAN_x8r8g8b8,
+			target_mode->width, target_mode->height, 0,
+			target_mode->width * 4);
+	if (!new_snapshot) {
+		weston_log("Failed to create the RDP encoder snapshot.\n");
+		return -ENOMEM;
+	}
+
 	output->current_mode->flags &= ~WL_OUTPUT_MODE_CURRENT;
 
 	output->current_mode = local_mode;
@@ -444,7 +997,17 @@ rdp_switch_mode(struct weston_output *output, struct weston_mode *target_mode)
 	pixman_image_unref(rdpOutput->shadow_surface);
 	rdpOutput->shadow_surface = new_shadow_buffer;
 
+	/* The peers are resized and sent a full refresh, what was encoded
+	 * or missed for the old size is dropped. */
+	rdp_encoder_cancel(encoder);
+	pixman_image_unref(encoder->snapshot);
+	encoder->snapshot = new_snapshot;
+	RFX_RESET(encoder->rfx_context, target_mode->width, target_mode->height);
+	NSC_RESET(encoder->nsc_context, target_mode->width, target_mode->height);
+
 	wl_list_for_each(rdpPeer, &rdpOutput->peers, link) {
+		pixman_region32_clear(&rdpPeer->missed_damage);
+
 		settings = rdpPeer->peer->settings;
 		if (settings->DesktopWidth == (UINT32)target_mode->width &&
 				settings->DesktopHeight == (UINT32)target_mode->height)
@@ -526,6 +1089,12 @@ rdp_output_enable(struct weston_output *base)
 	}
 
 	loop = wl_display_get_event_loop(b->compositor->wl_display);
+	if (rdp_encoder_init(output, loop) < 0) {
+		pixman_renderer_output_destroy(&output->base);
+		pixman_image_unref(output->shadow_surface);
+		return -1;
+	}
+
 	output->finish_frame_timer = wl_event_loop_add_timer(loop, finish_frame_handler, output);
 
 	b->output = output;
@@ -542,6 +1111,7 @@ rdp_output_disable(struct weston_output *base)
 	if (!output->base.enabled)
 		return 0;
 
+	rdp_encoder_destroy(&output->encoder);
 	pixman_image_unref(output->shadow_surface);
 	pixman_renderer_output_destroy(&output->base);
 
@@ -651,6 +1221,7 @@ rdp_peer_context_new(freerdp_peer* client, RdpPeerContext* context)
 {
 	context->item.peer = client;
 	context->item.flags = RDP_PEER_OUTPUT_ENABLED;
+	pixman_region32_init(&context->item.missed_damage);
 
 #if FREERDP_VERSION_MAJOR == 1 && FREERDP_VERSION_MINOR == 1
 	context->rfx_context = rfx_context_new();
@@ -710,6 +1281,7 @@ rdp_peer_context_free(freerdp_peer* client, RdpPeerContext* context)
 	nsc_context_free(context->nsc_context);
 	rfx_context_free(context->rfx_context);
 	free(context->rfx_rects);
+	pixman_region32_fini(&context->item.missed_damage);
 }
 
 
@@ -722,6 +1294,11 @@ rdp_client_activity(int fd, uint32_t mask, void *data)
 		weston_log("unable to checkDescriptor for %p\n", client);
 		goto out_clean;
 	}
+
+#if FREERDP_VERSION_MAJOR >= 2
+	if (mask & WL_EVENT_WRITABLE)
+		rdp_peer_flush_missed(client);
+#endif
 	return 0;
 
 out_clean:
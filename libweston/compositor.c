@@ -74,6 +74,9 @@ weston_output_transform_scale_init(struct weston_output *output,
 static void
 weston_compositor_build_view_list(struct weston_compositor *compositor);
 
+static void
+weston_compositor_pick_grid_dirty(struct weston_compositor *compositor);
+
 static void weston_mode_switch_finish(struct weston_output *output,
 				      int mode_changed,
 				      int scale_changed)
@@ -257,6 +260,16 @@ region_init_infinite(pixman_region32_t *region)
 				  UINT32_MAX, UINT32_MAX);
 }
 
+/* Exchange the contents of two regions, without copying rectangles */
+static void
+region_swap(pixman_region32_t *a, pixman_region32_t *b)
+{
+	pixman_region32_t tmp = *a;
+
+	*a = *b;
+	*b = tmp;
+}
+
 static struct weston_subsurface *
 weston_surface_to_subsurface(struct weston_surface *surface);
 
@@ -400,7 +413,9 @@ weston_surface_state_init(struct weston_surface_state *state)
 	pixman_region32_init(&state->damage_surface);
 	pixman_region32_init(&state->damage_buffer);
 	pixman_region32_init(&state->opaque);
+	state->opaque_changed = false;
 	region_init_infinite(&state->input);
+	state->input_changed = false;
 
 	wl_list_init(&state->frame_callback_list);
 	wl_list_init(&state->feedback_list);
@@ -470,15 +485,22 @@ weston_surface_create(struct weston_compositor *compositor)
 	surface->buffer_viewport.surface.width = -1;
 
 	weston_surface_state_init(&surface->pending);
+	/* The first commit clips the default regions to the surface. */
+	surface->pending.opaque_changed = true;
+	surface->pending.input_changed = true;
 
 	pixman_region32_init(&surface->damage);
 	pixman_region32_init(&surface->opaque);
 	region_init_infinite(&surface->input);
+	pixman_region32_init(&surface->committed_opaque);
+	region_init_infinite(&surface->committed_input);
 
 	wl_list_init(&surface->views);
 
 	wl_list_init(&surface->frame_callback_list);
 	wl_list_init(&surface->feedback_list);
+	wl_list_init(&surface->frame_request_link);
+	wl_list_init(&surface->output_link);
 
 	wl_list_init(&surface->subsurface_list);
 	wl_list_init(&surface->subsurface_list_pending);
@@ -958,6 +980,57 @@ weston_surface_update_output_mask(struct weston_surface *es, uint32_t mask)
 	}
 }
 
+/* Queue the surface on the frame request list of its output, which the
+ * repaint of that output dispatches, or take it off if it has no frame
+ * callbacks or feedback left.
+ */
+static void
+weston_surface_update_frame_request(struct weston_surface *surface)
+{
+	struct wl_list *list;
+
+	wl_list_remove(&surface->frame_request_link);
+	wl_list_init(&surface->frame_request_link);
+
+	if (wl_list_empty(&surface->frame_callback_list) &&
+	    wl_list_empty(&surface->feedback_list))
+		return;
+
+	if (surface->output)
+		list = &surface->output->frame_request_list;
+	else
+		list = &surface->compositor->frame_request_list;
+
+	wl_list_insert(list->prev, &surface->frame_request_link);
+}
+
+/** Set the primary output of a surface
+ *
+ * \param surface The surface.
+ * \param output The output used for vsync and frame callbacks, or NULL.
+ *
+ * Shells overriding the output picked by weston_surface_assign_output()
+ * must use this rather than writing weston_surface::output, so that the
+ * surface is found again when the output goes away.
+ */
+WL_EXPORT void
+weston_surface_set_output(struct weston_surface *surface,
+			  struct weston_output *output)
+{
+	if (surface->output == output)
+		return;
+
+	surface->output = output;
+
+	wl_list_remove(&surface->output_link);
+	if (output)
+		wl_list_insert(&output->surface_list, &surface->output_link);
+	else
+		wl_list_init(&surface->output_link);
+
+	weston_surface_update_frame_request(surface);
+}
+
 /** Recalculate which output(s) the surface has views displayed on
  *
  * \param es  The surface to remap to outputs
@@ -1001,7 +1074,7 @@ weston_surface_assign_output(struct weston_surface *es)
 	}
 	pixman_region32_fini(&region);
 
-	es->output = new_output;
+	weston_surface_set_output(es, new_output);
 	weston_surface_update_output_mask(es, mask);
 }
 
@@ -1049,6 +1122,9 @@ weston_view_assign_output(struct weston_view *ev)
 	}
 	pixman_region32_fini(&region);
 
+	if (ev->output_mask != mask)
+		ec->view_output_serial++;
+
 	ev->output = new_output;
 	ev->output_mask = mask;
 
@@ -1087,16 +1163,8 @@ static void
 view_compute_bbox(struct weston_view *view, const pixman_box32_t *inbox,
 		  pixman_region32_t *bbox)
 {
-	float min_x = HUGE_VALF,  min_y = HUGE_VALF;
-	float max_x = -HUGE_VALF, max_y = -HUGE_VALF;
-	int32_t s[4][2] = {
-		{ inbox->x1, inbox->y1 },
-		{ inbox->x1, inbox->y2 },
-		{ inbox->x2, inbox->y1 },
-		{ inbox->x2, inbox->y2 },
-	};
+	float box[4] = { inbox->x1, inbox->y1, inbox->x2, inbox->y2 };
 	float int_x, int_y;
-	int i;
 
 	if (inbox->x1 == inbox->x2 || inbox->y1 == inbox->y2) {
 		/* avoid rounding empty bbox to 1x1 */
@@ -1104,23 +1172,14 @@ view_compute_bbox(struct weston_view *view, const pixman_box32_t *inbox,
 		return;
 	}
 
-	for (i = 0; i < 4; ++i) {
-		float x, y;
-		weston_view_to_global_float(view, s[i][0], s[i][1], &x, &y);
-		if (x < min_x)
-			min_x = x;
-		if (x > max_x)
-			max_x = x;
-		if (y < min_y)
-			min_y = y;
-		if (y > max_y)
-			max_y = y;
-	}
+	if (weston_matrix_transform_bbox(&view->transform.matrix, box) < 0)
+		weston_log("warning: numerical instability in %s()\n",
+			   __func__);
 
-	int_x = floorf(min_x);
-	int_y = floorf(min_y);
+	int_x = floorf(box[0]);
+	int_y = floorf(box[1]);
 	pixman_region32_init_rect(bbox, int_x, int_y,
-				  ceilf(max_x) - int_x, ceilf(max_y) - int_y);
+				  ceilf(box[2]) - int_x, ceilf(box[3]) - int_y);
 }
 
 static void
@@ -1225,15 +1284,17 @@ get_view_layer(struct weston_view *view)
 	return view->layer_link.layer;
 }
 
-WL_EXPORT void
-weston_view_update_transform(struct weston_view *view)
+/* weston_view_update_transform() without the transform signal, which
+ * is left to the caller. Returns false if the transform was up to date. */
+static bool
+view_update_transform(struct weston_view *view)
 {
 	struct weston_view *parent = view->geometry.parent;
 	struct weston_layer *layer;
 	pixman_region32_t mask;
 
 	if (!view->transform.dirty)
-		return;
+		return false;
 
 	if (parent)
 		weston_view_update_transform(parent);
@@ -1286,8 +1347,17 @@ weston_view_update_transform(struct weston_view *view)
 
 	weston_view_assign_output(view);
 
-	wl_signal_emit(&view->surface->compositor->transform_signal,
-		       view->surface);
+	weston_compositor_pick_grid_dirty(view->surface->compositor);
+
+	return true;
+}
+
+WL_EXPORT void
+weston_view_update_transform(struct weston_view *view)
+{
+	if (view_update_transform(view))
+		wl_signal_emit(&view->surface->compositor->transform_signal,
+			       view->surface);
 }
 
 WL_EXPORT void
@@ -1306,6 +1376,7 @@ weston_view_geometry_dirty(struct weston_view *view)
 		return;
 
 	view->transform.dirty = 1;
+	view->surface->compositor->view_transforms_dirty = true;
 
 	wl_list_for_each(child, &view->geometry.child_list,
 			 geometry.parent_link)
@@ -1411,6 +1482,32 @@ weston_view_schedule_repaint(struct weston_view *view)
 			weston_output_schedule_repaint(output);
 }
 
+/** Schedule a cursor-only update after moving a view
+ *
+ * \param view The view that moved, usually a pointer sprite.
+ *
+ * Like weston_view_schedule_repaint(), except that outputs showing the
+ * view on a cursor plane only reposition that plane, as long as nothing
+ * else needs repainting. Other outputs get a full repaint.
+ */
+WL_EXPORT void
+weston_view_schedule_cursor_update(struct weston_view *view)
+{
+	struct weston_compositor *compositor = view->surface->compositor;
+	struct weston_output *output;
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		if (!(view->output_mask & (1u << output->id)))
+			continue;
+
+		if (output->move_cursor && view->plane &&
+		    view->plane != &compositor->primary_plane)
+			weston_output_schedule_cursor_update(output);
+		else
+			weston_output_schedule_repaint(output);
+	}
+}
+
 /**
  * XXX: This function does it the wrong way.
  * surface->damage is the damage from the client, and causes
@@ -1739,38 +1836,241 @@ weston_compositor_get_time(void)
        return tv.tv_sec * 1000 + tv.tv_usec / 1000;
 }
 
-WL_EXPORT struct weston_view *
-weston_compositor_pick_view(struct weston_compositor *compositor,
-			    wl_fixed_t x, wl_fixed_t y,
-			    wl_fixed_t *vx, wl_fixed_t *vy)
+/* Uniform grid over the bounding boxes of the views in the view list,
+ * used to find the pick candidates for a point without walking the whole
+ * list. Each cell lists the views overlapping it in stacking order, stored
+ * as ranges of a single array.
+ */
+#define PICK_GRID_MAX_CELLS 32	/* per dimension */
+#define PICK_GRID_MIN_CELL_SIZE 64
+
+struct weston_pick_grid {
+	bool dirty;
+	pixman_box32_t extents;
+	int32_t cell_width, cell_height;
+	int columns, rows;
+	uint32_t *cells;	/* columns * rows + 1 offsets into views */
+	int cells_alloc;
+	struct weston_view **views;
+	uint32_t views_alloc;
+};
+
+static void
+weston_compositor_pick_grid_dirty(struct weston_compositor *compositor)
+{
+	if (compositor->pick_grid)
+		compositor->pick_grid->dirty = true;
+}
+
+static void
+pick_grid_view_cells(struct weston_pick_grid *grid, struct weston_view *view,
+		     int *c1, int *r1, int *c2, int *r2)
+{
+	pixman_box32_t *box = pixman_region32_extents(&view->transform.boundingbox);
+
+	*c1 = (box->x1 - grid->extents.x1) / grid->cell_width;
+	*r1 = (box->y1 - grid->extents.y1) / grid->cell_height;
+	*c2 = (box->x2 - 1 - grid->extents.x1) / grid->cell_width;
+	*r2 = (box->y2 - 1 - grid->extents.y1) / grid->cell_height;
+}
+
+static int
+pick_grid_rebuild(struct weston_pick_grid *grid, struct wl_list *view_list)
 {
 	struct weston_view *view;
-	wl_fixed_t view_x, view_y;
-	int view_ix, view_iy;
-	int ix = wl_fixed_to_int(x);
-	int iy = wl_fixed_to_int(y);
+	pixman_box32_t *box;
+	uint32_t *cells;
+	struct weston_view **views;
+	uint32_t n_refs, sum, count;
+	int n_cells, c1, r1, c2, r2, c, r, i;
+	bool empty = true;
+
+	wl_list_for_each(view, view_list, link) {
+		if (!pixman_region32_not_empty(&view->transform.boundingbox))
+			continue;
 
-	wl_list_for_each(view, &compositor->view_list, link) {
-		if (!pixman_region32_contains_point(
-				&view->transform.boundingbox, ix, iy, NULL))
+		box = pixman_region32_extents(&view->transform.boundingbox);
+		if (empty) {
+			grid->extents = *box;
+			empty = false;
 			continue;
+		}
 
-		weston_view_from_global_fixed(view, x, y, &view_x, &view_y);
-		view_ix = wl_fixed_to_int(view_x);
-		view_iy = wl_fixed_to_int(view_y);
+		grid->extents.x1 = MIN(grid->extents.x1, box->x1);
+		grid->extents.y1 = MIN(grid->extents.y1, box->y1);
+		grid->extents.x2 = MAX(grid->extents.x2, box->x2);
+		grid->extents.y2 = MAX(grid->extents.y2, box->y2);
+	}
+
+	if (empty) {
+		grid->extents.x1 = grid->extents.x2 = 0;
+		grid->extents.y1 = grid->extents.y2 = 0;
+		grid->columns = grid->rows = 0;
+		grid->dirty = false;
+		return 0;
+	}
 
-		if (!pixman_region32_contains_point(&view->surface->input,
-						    view_ix, view_iy, NULL))
+	grid->cell_width = MAX(PICK_GRID_MIN_CELL_SIZE,
+			       ((int64_t) grid->extents.x2 - grid->extents.x1 +
+				PICK_GRID_MAX_CELLS - 1) / PICK_GRID_MAX_CELLS);
+	grid->cell_height = MAX(PICK_GRID_MIN_CELL_SIZE,
+				((int64_t) grid->extents.y2 - grid->extents.y1 +
+				 PICK_GRID_MAX_CELLS - 1) / PICK_GRID_MAX_CELLS);
+	grid->columns = ((int64_t) grid->extents.x2 - grid->extents.x1 +
+			 grid->cell_width - 1) / grid->cell_width;
+	grid->rows = ((int64_t) grid->extents.y2 - grid->extents.y1 +
+		      grid->cell_height - 1) / grid->cell_height;
+
+	n_cells = grid->columns * grid->rows;
+	if (n_cells + 1 > grid->cells_alloc) {
+		cells = realloc(grid->cells, (n_cells + 1) * sizeof *cells);
+		if (!cells)
+			return -1;
+		grid->cells = cells;
+		grid->cells_alloc = n_cells + 1;
+	}
+	memset(grid->cells, 0, (n_cells + 1) * sizeof *grid->cells);
+
+	/* Count the views in each cell, then turn the counts into
+	 * offsets and fill the cells in stacking order. */
+	n_refs = 0;
+	wl_list_for_each(view, view_list, link) {
+		if (!pixman_region32_not_empty(&view->transform.boundingbox))
 			continue;
 
-		if (view->geometry.scissor_enabled &&
-		    !pixman_region32_contains_point(&view->geometry.scissor,
-						    view_ix, view_iy, NULL))
+		pick_grid_view_cells(grid, view, &c1, &r1, &c2, &r2);
+		for (r = r1; r <= r2; r++)
+			for (c = c1; c <= c2; c++)
+				grid->cells[r * grid->columns + c]++;
+		n_refs += (c2 - c1 + 1) * (r2 - r1 + 1);
+	}
+
+	if (n_refs > grid->views_alloc) {
+		views = realloc(grid->views, n_refs * sizeof *views);
+		if (!views)
+			return -1;
+		grid->views = views;
+		grid->views_alloc = n_refs;
+	}
+
+	sum = 0;
+	for (i = 0; i <= n_cells; i++) {
+		count = grid->cells[i];
+		grid->cells[i] = sum;
+		sum += count;
+	}
+
+	wl_list_for_each(view, view_list, link) {
+		if (!pixman_region32_not_empty(&view->transform.boundingbox))
 			continue;
 
-		*vx = view_x;
-		*vy = view_y;
-		return view;
+		pick_grid_view_cells(grid, view, &c1, &r1, &c2, &r2);
+		for (r = r1; r <= r2; r++)
+			for (c = c1; c <= c2; c++)
+				grid->views[grid->cells[r * grid->columns + c]++] = view;
+	}
+
+	/* The fill pass moved every cell start to the start of the next
+	 * cell, shift them back. */
+	memmove(&grid->cells[1], &grid->cells[0], n_cells * sizeof *grid->cells);
+	grid->cells[0] = 0;
+
+	grid->dirty = false;
+
+	return 0;
+}
+
+static struct weston_pick_grid *
+weston_compositor_get_pick_grid(struct weston_compositor *compositor)
+{
+	struct weston_pick_grid *grid = compositor->pick_grid;
+
+	if (!grid) {
+		grid = zalloc(sizeof *grid);
+		if (!grid)
+			return NULL;
+		grid->dirty = true;
+		compositor->pick_grid = grid;
+	}
+
+	if (grid->dirty &&
+	    pick_grid_rebuild(grid, &compositor->view_list) < 0)
+		return NULL;
+
+	return grid;
+}
+
+static void
+weston_compositor_destroy_pick_grid(struct weston_compositor *compositor)
+{
+	struct weston_pick_grid *grid = compositor->pick_grid;
+
+	if (!grid)
+		return;
+
+	free(grid->cells);
+	free(grid->views);
+	free(grid);
+	compositor->pick_grid = NULL;
+}
+
+static bool
+view_accepts_point(struct weston_view *view, wl_fixed_t x, wl_fixed_t y,
+		   wl_fixed_t *vx, wl_fixed_t *vy)
+{
+	wl_fixed_t view_x, view_y;
+	int view_ix, view_iy;
+
+	if (!pixman_region32_contains_point(&view->transform.boundingbox,
+					    wl_fixed_to_int(x),
+					    wl_fixed_to_int(y), NULL))
+		return false;
+
+	weston_view_from_global_fixed(view, x, y, &view_x, &view_y);
+	view_ix = wl_fixed_to_int(view_x);
+	view_iy = wl_fixed_to_int(view_y);
+
+	if (!pixman_region32_contains_point(&view->surface->input,
+					    view_ix, view_iy, NULL))
+		return false;
+
+	if (view->geometry.scissor_enabled &&
+	    !pixman_region32_contains_point(&view->geometry.scissor,
+					    view_ix, view_iy, NULL))
+		return false;
+
+	*vx = view_x;
+	*vy = view_y;
+	return true;
+}
+
+WL_EXPORT struct weston_view *
+weston_compositor_pick_view(struct weston_compositor *compositor,
+			    wl_fixed_t x, wl_fixed_t y,
+			    wl_fixed_t *vx, wl_fixed_t *vy)
+{
+	struct weston_pick_grid *grid;
+	struct weston_view *view;
+	int ix = wl_fixed_to_int(x);
+	int iy = wl_fixed_to_int(y);
+	uint32_t i, cell;
+
+	grid = weston_compositor_get_pick_grid(compositor);
+	if (!grid) {
+		wl_list_for_each(view, &compositor->view_list, link)
+			if (view_accepts_point(view, x, y, vx, vy))
+				return view;
+	} else if (ix >= grid->extents.x1 && ix < grid->extents.x2 &&
+		   iy >= grid->extents.y1 && iy < grid->extents.y2) {
+		cell = (iy - grid->extents.y1) / grid->cell_height *
+		       grid->columns +
+		       (ix - grid->extents.x1) / grid->cell_width;
+
+		for (i = grid->cells[cell]; i < grid->cells[cell + 1]; i++) {
+			view = grid->views[i];
+			if (view_accepts_point(view, x, y, vx, vy))
+				return view;
+		}
 	}
 
 	*vx = wl_fixed_from_int(-1000000);
@@ -1805,7 +2105,9 @@ weston_view_unmap(struct weston_view *view)
 	weston_layer_entry_remove(&view->layer_link);
 	wl_list_remove(&view->link);
 	wl_list_init(&view->link);
+	weston_compositor_pick_grid_dirty(view->surface->compositor);
 	view->output_mask = 0;
+	view->surface->compositor->view_output_serial++;
 	weston_surface_assign_output(view->surface);
 
 	if (weston_surface_is_mapped(view->surface))
@@ -1834,7 +2136,7 @@ weston_surface_unmap(struct weston_surface *surface)
 	surface->is_mapped = false;
 	wl_list_for_each(view, &surface->views, surface_link)
 		weston_view_unmap(view);
-	surface->output = NULL;
+	weston_surface_set_output(surface, NULL);
 }
 
 static void
@@ -1861,6 +2163,8 @@ weston_view_destroy(struct weston_view *view)
 
 	wl_list_remove(&view->link);
 	weston_layer_entry_remove(&view->layer_link);
+	weston_compositor_pick_grid_dirty(view->surface->compositor);
+	view->surface->compositor->view_output_serial++;
 
 	pixman_region32_fini(&view->clip);
 	pixman_region32_fini(&view->geometry.scissor);
@@ -1901,11 +2205,15 @@ weston_surface_destroy(struct weston_surface *surface)
 	pixman_region32_fini(&surface->damage);
 	pixman_region32_fini(&surface->opaque);
 	pixman_region32_fini(&surface->input);
+	pixman_region32_fini(&surface->committed_opaque);
+	pixman_region32_fini(&surface->committed_input);
 
 	wl_list_for_each_safe(cb, next, &surface->frame_callback_list, link)
 		wl_resource_destroy(cb->resource);
 
 	weston_presentation_feedback_discard_list(&surface->feedback_list);
+	wl_list_remove(&surface->frame_request_link);
+	wl_list_remove(&surface->output_link);
 
 	wl_list_for_each_safe(constraint, next_constraint,
 			      &surface->pointer_constraints,
@@ -2066,59 +2374,188 @@ static void
 view_accumulate_damage(struct weston_view *view,
 		       pixman_region32_t *opaque)
 {
-	pixman_region32_t damage;
+	struct weston_region_arena *arena =
+		&view->surface->compositor->region_arena;
+	struct weston_frame_region damage, visible;
+	pixman_region32_t bbox;
 
-	pixman_region32_init(&damage);
+	/* The operations write to the other temporary, so that pixman
+	 * can reuse the storage of the arena. */
+	weston_frame_region_init(arena, &damage);
+	weston_frame_region_init(arena, &visible);
 	if (view->transform.enabled) {
 		pixman_box32_t *extents;
 
 		extents = pixman_region32_extents(&view->surface->damage);
-		view_compute_bbox(view, extents, &damage);
+		view_compute_bbox(view, extents, &bbox);
+		pixman_region32_intersect(&visible.region, &bbox,
+					  &view->transform.boundingbox);
+		pixman_region32_fini(&bbox);
 	} else {
-		pixman_region32_copy(&damage, &view->surface->damage);
-		pixman_region32_translate(&damage,
+		pixman_region32_copy(&damage.region, &view->surface->damage);
+		pixman_region32_translate(&damage.region,
 					  view->geometry.x, view->geometry.y);
+		pixman_region32_intersect(&visible.region, &damage.region,
+					  &view->transform.boundingbox);
 	}
 
-	pixman_region32_intersect(&damage, &damage,
-				  &view->transform.boundingbox);
-	pixman_region32_subtract(&damage, &damage, opaque);
+	pixman_region32_subtract(&damage.region, &visible.region, opaque);
 	pixman_region32_union(&view->plane->damage,
-			      &view->plane->damage, &damage);
-	pixman_region32_fini(&damage);
+			      &view->plane->damage, &damage.region);
+	weston_frame_region_fini(arena, &visible);
+	weston_frame_region_fini(arena, &damage);
 	pixman_region32_copy(&view->clip, opaque);
 	pixman_region32_union(opaque, opaque, &view->transform.opaque);
 }
 
-static void
-compositor_accumulate_damage(struct weston_compositor *ec)
+/* Filter the compositor view list down to the views on the output, once
+ * per change of the view list or of the output mask of a view. */
+static int
+weston_output_update_view_list(struct weston_output *output)
 {
+	struct weston_compositor *compositor = output->compositor;
+	uint32_t output_bit = 1u << output->id;
+	struct weston_view *view, **view_ptr;
+
+	if (output->view_list_serial == compositor->view_output_serial)
+		return 0;
+
+	output->view_list.size = 0;
+	wl_list_for_each(view, &compositor->view_list, link) {
+		if (!(view->output_mask & output_bit))
+			continue;
+
+		view_ptr = wl_array_add(&output->view_list, sizeof *view_ptr);
+		if (!view_ptr) {
+			output->view_list.size = 0;
+			return -1;
+		}
+		*view_ptr = view;
+	}
+
+	output->view_list_serial = compositor->view_output_serial;
+
+	return 0;
+}
+
+struct plane_opaque {
 	struct weston_plane *plane;
-	struct weston_view *ev;
-	pixman_region32_t opaque, clip;
+	pixman_region32_t opaque;
+};
 
-	pixman_region32_init(&clip);
+/* The opaque regions of the planes, while accumulating the damage of a
+ * view list top to bottom */
+struct damage_accumulator {
+	struct plane_opaque planes_stack[8];
+	struct plane_opaque *planes;
+	struct plane_opaque *current;
+	int n_planes;
+};
 
-	wl_list_for_each(plane, &ec->plane_list, link) {
-		pixman_region32_copy(&plane->clip, &clip);
+static struct plane_opaque *
+plane_opaque_find(struct plane_opaque *planes, int n_planes,
+		  struct weston_plane *plane)
+{
+	int i;
 
-		pixman_region32_init(&opaque);
+	for (i = 0; i < n_planes; i++)
+		if (planes[i].plane == plane)
+			return &planes[i];
 
-		wl_list_for_each(ev, &ec->view_list, link) {
-			if (ev->plane != plane)
-				continue;
+	return NULL;
+}
 
-			view_accumulate_damage(ev, &opaque);
+static int
+damage_accumulator_init(struct damage_accumulator *acc,
+			struct weston_compositor *ec)
+{
+	struct weston_plane *plane;
+	int i;
+
+	acc->planes = acc->planes_stack;
+	acc->current = NULL;
+	acc->n_planes = wl_list_length(&ec->plane_list);
+	if (acc->n_planes > (int) ARRAY_LENGTH(acc->planes_stack)) {
+		acc->planes = calloc(acc->n_planes, sizeof *acc->planes);
+		if (!acc->planes) {
+			weston_log("failed to allocate damage planes\n");
+			return -1;
 		}
+	}
 
-		pixman_region32_union(&clip, &clip, &opaque);
-		pixman_region32_fini(&opaque);
+	i = 0;
+	wl_list_for_each(plane, &ec->plane_list, link) {
+		acc->planes[i].plane = plane;
+		pixman_region32_init(&acc->planes[i].opaque);
+		i++;
+	}
+
+	return 0;
+}
+
+static void
+damage_accumulator_add(struct damage_accumulator *acc,
+		       struct weston_view *ev)
+{
+	ev->surface->touched = false;
+
+	/* Views tend to come in runs on the same plane, so the last plane
+	 * found is tried first. */
+	if (!acc->current || acc->current->plane != ev->plane)
+		acc->current = plane_opaque_find(acc->planes, acc->n_planes,
+						 ev->plane);
+	if (!acc->current)
+		return;
+
+	view_accumulate_damage(ev, &acc->current->opaque);
+}
+
+/* The clip of every plane is the union of the opaque regions of the
+ * planes stacked above it. */
+static void
+damage_accumulator_fini(struct damage_accumulator *acc)
+{
+	pixman_region32_t clip;
+	int i;
+
+	pixman_region32_init(&clip);
+
+	for (i = 0; i < acc->n_planes; i++) {
+		pixman_region32_copy(&acc->planes[i].plane->clip, &clip);
+		pixman_region32_union(&clip, &clip, &acc->planes[i].opaque);
+		pixman_region32_fini(&acc->planes[i].opaque);
 	}
 
 	pixman_region32_fini(&clip);
 
+	if (acc->planes != acc->planes_stack)
+		free(acc->planes);
+}
+
+/** Accumulate the damage of all views into their planes
+ *
+ * \param ec The compositor.
+ *
+ * The view list is walked once, accumulating the opaque region of each
+ * plane as its views are met top to bottom. The clip of every plane is
+ * then the union of the opaque regions of the planes stacked above it.
+ * Views on planes not in the plane list are ignored.
+ *
+ * Exported for the damage accumulation benchmark test.
+ */
+WL_EXPORT void
+weston_compositor_accumulate_damage(struct weston_compositor *ec)
+{
+	struct damage_accumulator acc;
+	struct weston_view *ev;
+
+	if (damage_accumulator_init(&acc, ec) < 0)
+		return;
+
 	wl_list_for_each(ev, &ec->view_list, link)
-		ev->surface->touched = false;
+		damage_accumulator_add(&acc, ev);
+
+	damage_accumulator_fini(&acc);
 
 	wl_list_for_each(ev, &ec->view_list, link) {
 		if (ev->surface->touched)
@@ -2140,6 +2577,76 @@ compositor_accumulate_damage(struct weston_compositor *ec)
 	}
 }
 
+/* The surface damage is about to be flushed: views of the surface on
+ * other outputs only, not walked for this one, get it on their planes
+ * now, without occlusion culling. */
+static void
+surface_damage_other_outputs(struct weston_surface *surface,
+			     struct weston_output *output)
+{
+	uint32_t serial = surface->compositor->view_list_serial;
+	uint32_t output_bit = 1u << output->id;
+	struct weston_view *view;
+	pixman_region32_t opaque;
+
+	if (!(surface->output_mask & ~output_bit))
+		return;
+
+	pixman_region32_init(&opaque);
+	wl_list_for_each(view, &surface->views, surface_link) {
+		if (view->output_mask & output_bit || !view->output_mask ||
+		    view->view_list_serial != serial || !view->plane)
+			continue;
+
+		pixman_region32_clear(&opaque);
+		view_accumulate_damage(view, &opaque);
+	}
+	pixman_region32_fini(&opaque);
+}
+
+/** Accumulate the damage of the views on an output into their planes
+ *
+ * \param output The output.
+ *
+ * Like weston_compositor_accumulate_damage(), over the view list of the
+ * output only. The plane clips are only valid inside the output region.
+ * The damage of views not on any output stays on their surfaces.
+ */
+WL_EXPORT void
+weston_output_accumulate_damage(struct weston_output *output)
+{
+	struct weston_compositor *ec = output->compositor;
+	struct damage_accumulator acc;
+	struct weston_view **ev;
+
+	if (weston_output_update_view_list(output) < 0) {
+		weston_compositor_accumulate_damage(ec);
+		return;
+	}
+
+	if (damage_accumulator_init(&acc, ec) < 0)
+		return;
+
+	wl_array_for_each(ev, &output->view_list)
+		damage_accumulator_add(&acc, *ev);
+
+	damage_accumulator_fini(&acc);
+
+	wl_array_for_each(ev, &output->view_list) {
+		if ((*ev)->surface->touched)
+			continue;
+		(*ev)->surface->touched = true;
+
+		surface_damage_other_outputs((*ev)->surface, output);
+		surface_flush_damage((*ev)->surface);
+
+		/* Early buffer release, see
+		 * weston_compositor_accumulate_damage(). */
+		if (!(*ev)->surface->keep_buffer)
+			weston_buffer_reference(&(*ev)->surface->buffer_ref, NULL);
+	}
+}
+
 static void
 surface_stash_subsurface_views(struct weston_surface *surface)
 {
@@ -2208,6 +2715,7 @@ view_list_add_subsurface_view(struct weston_compositor *compositor,
 	view->parent_view = parent;
 	weston_view_update_transform(view);
 	view->is_mapped = true;
+	view->view_list_serial = compositor->view_list_serial;
 
 	if (wl_list_empty(&sub->surface->subsurface_list)) {
 		wl_list_insert(compositor->view_list.prev, &view->link);
@@ -2235,6 +2743,7 @@ view_list_add(struct weston_compositor *compositor,
 	struct weston_subsurface *sub;
 
 	weston_view_update_transform(view);
+	view->view_list_serial = compositor->view_list_serial;
 
 	if (wl_list_empty(&view->surface->subsurface_list)) {
 		wl_list_insert(compositor->view_list.prev, &view->link);
@@ -2254,6 +2763,23 @@ weston_compositor_build_view_list(struct weston_compositor *compositor)
 {
 	struct weston_view *view;
 	struct weston_layer *layer;
+	struct weston_layer **layer_ptr;
+
+	compositor->view_list_needs_rebuild = false;
+	compositor->view_list_serial++;
+	compositor->view_output_serial++;
+	compositor->view_transforms_dirty = false;
+	weston_compositor_pick_grid_dirty(compositor);
+
+	compositor->view_list_layers.size = 0;
+	wl_list_for_each(layer, &compositor->layer_list, link) {
+		layer_ptr = wl_array_add(&compositor->view_list_layers,
+					 sizeof *layer_ptr);
+		if (layer_ptr)
+			*layer_ptr = layer;
+		else
+			compositor->view_list_needs_rebuild = true;
+	}
 
 	wl_list_for_each(layer, &compositor->layer_list, link)
 		wl_list_for_each(view, &layer->view_list.link, layer_link.link)
@@ -2271,6 +2797,70 @@ weston_compositor_build_view_list(struct weston_compositor *compositor)
 			surface_free_unused_subsurface_views(view->surface);
 }
 
+/* Shells may restack layers by manipulating layer_list directly, so the
+ * layer order is compared against the one the view list was built from.
+ */
+static bool
+weston_compositor_layers_changed(struct weston_compositor *compositor)
+{
+	struct weston_layer *layer;
+	struct weston_layer **layer_ptr;
+	struct weston_layer **end;
+
+	layer_ptr = compositor->view_list_layers.data;
+	end = (struct weston_layer **) ((char *) layer_ptr +
+					compositor->view_list_layers.size);
+
+	wl_list_for_each(layer, &compositor->layer_list, link) {
+		if (layer_ptr == end || *layer_ptr != layer)
+			return true;
+		layer_ptr++;
+	}
+
+	return layer_ptr != end;
+}
+
+/** Bring the view list up to date
+ *
+ * The view list is only rebuilt when the stacking changed since the last
+ * build: a view entered or left a layer, layers were restacked, or a
+ * sub-surface was added, removed, mapped or restacked. Otherwise only the
+ * dirty view transforms are updated, and the list is not walked at all
+ * when no view geometry changed since, e.g. when several outputs repaint
+ * in the same loop iteration.
+ */
+static void
+weston_compositor_update_view_list(struct weston_compositor *compositor)
+{
+	struct weston_view *view;
+
+	if (compositor->view_list_needs_rebuild ||
+	    weston_compositor_layers_changed(compositor)) {
+		weston_compositor_build_view_list(compositor);
+		return;
+	}
+
+	if (!compositor->view_transforms_dirty)
+		return;
+
+	compositor->view_transforms_dirty = false;
+	wl_list_for_each(view, &compositor->view_list, link)
+		weston_view_update_transform(view);
+}
+
+/** Request a rebuild of the view list on the next repaint
+ *
+ * \param compositor The compositor.
+ *
+ * Layer entry and sub-surface changes done through libweston already take
+ * care of this; it is only needed when changing the stacking by other means.
+ */
+WL_EXPORT void
+weston_compositor_view_list_dirty(struct weston_compositor *compositor)
+{
+	compositor->view_list_needs_rebuild = true;
+}
+
 static void
 weston_output_take_feedback_list(struct weston_output *output,
 				 struct weston_surface *surface)
@@ -2296,15 +2886,45 @@ weston_output_take_feedback_list(struct weston_output *output,
 	wl_list_init(&surface->feedback_list);
 }
 
+/* Whether a view of the surface is in the current view list */
+static bool
+weston_surface_in_view_list(struct weston_surface *surface)
+{
+	uint32_t serial = surface->compositor->view_list_serial;
+	struct weston_view *view;
+
+	wl_list_for_each(view, &surface->views, surface_link)
+		if (view->view_list_serial == serial)
+			return true;
+
+	return false;
+}
+
+static void
+weston_output_end_repaint_stage(struct weston_output *output,
+				enum weston_repaint_stage stage,
+				struct timespec *stage_begin)
+{
+	struct timespec now, duration;
+
+	weston_compositor_read_presentation_clock(output->compositor, &now);
+	timespec_sub(&duration, &now, stage_begin);
+
+	output->repaint_stage_nsec[stage] = timespec_to_nsec(&duration);
+	*stage_begin = now;
+}
+
 static int
 weston_output_repaint(struct weston_output *output)
 {
 	struct weston_compositor *ec = output->compositor;
 	struct weston_view *ev;
+	struct weston_surface *surface, *snext;
 	struct weston_animation *animation, *next;
 	struct weston_frame_callback *cb, *cnext;
 	struct wl_list frame_callback_list;
-	pixman_region32_t output_damage;
+	struct weston_frame_region visible_damage, output_damage;
+	struct timespec stage_begin;
 	int r;
 
 	if (output->destroying)
@@ -2312,8 +2932,17 @@ weston_output_repaint(struct weston_output *output)
 
 	TL_POINT("core_repaint_begin", TLP_OUTPUT(output), TLP_END);
 
-	/* Rebuild the surface list and update surface transforms up front. */
-	weston_compositor_build_view_list(ec);
+	/* The renderer adds the temporaries of its own arenas. */
+	memset(&output->repaint_region_stats, 0,
+	       sizeof output->repaint_region_stats);
+
+	weston_compositor_read_presentation_clock(ec, &stage_begin);
+
+	/* Rebuild the surface list if needed and update surface transforms
+	 * up front. */
+	weston_compositor_update_view_list(ec);
+	weston_output_end_repaint_stage(output, WESTON_REPAINT_STAGE_VIEW_LIST,
+					&stage_begin);
 
 	if (output->assign_planes && !output->disable_planes) {
 		output->assign_planes(output);
@@ -2324,34 +2953,49 @@ weston_output_repaint(struct weston_output *output)
 		}
 	}
 
+	/* Only the surfaces that asked for a frame are visited; the ones
+	 * not in the view list keep their requests until they are. */
 	wl_list_init(&frame_callback_list);
-	wl_list_for_each(ev, &ec->view_list, link) {
-		/* Note: This operation is safe to do multiple times on the
-		 * same surface.
-		 */
-		if (ev->surface->output == output) {
-			wl_list_insert_list(&frame_callback_list,
-					    &ev->surface->frame_callback_list);
-			wl_list_init(&ev->surface->frame_callback_list);
+	wl_list_for_each_safe(surface, snext, &output->frame_request_list,
+			      frame_request_link) {
+		if (!weston_surface_in_view_list(surface))
+			continue;
 
-			weston_output_take_feedback_list(output, ev->surface);
-		}
+		wl_list_insert_list(&frame_callback_list,
+				    &surface->frame_callback_list);
+		wl_list_init(&surface->frame_callback_list);
+
+		weston_output_take_feedback_list(output, surface);
+
+		wl_list_remove(&surface->frame_request_link);
+		wl_list_init(&surface->frame_request_link);
 	}
+	weston_output_end_repaint_stage(output,
+					WESTON_REPAINT_STAGE_ASSIGN_PLANES,
+					&stage_begin);
 
-	compositor_accumulate_damage(ec);
+	weston_output_accumulate_damage(output);
+	weston_output_end_repaint_stage(output,
+					WESTON_REPAINT_STAGE_ACCUMULATE_DAMAGE,
+					&stage_begin);
 
-	pixman_region32_init(&output_damage);
-	pixman_region32_intersect(&output_damage,
-				  &ec->primary_plane.damage, &output->region);
-	pixman_region32_subtract(&output_damage,
-				 &output_damage, &ec->primary_plane.clip);
+	weston_frame_region_init(&ec->region_arena, &visible_damage);
+	weston_frame_region_init(&ec->region_arena, &output_damage);
+	pixman_region32_subtract(&visible_damage.region,
+				 &ec->primary_plane.damage,
+				 &ec->primary_plane.clip);
+	pixman_region32_intersect(&output_damage.region,
+				  &visible_damage.region, &output->region);
 
 	if (output->dirty)
 		weston_output_update_matrix(output);
 
-	r = output->repaint(output, &output_damage);
+	r = output->repaint(output, &output_damage.region);
 
-	pixman_region32_fini(&output_damage);
+	weston_frame_region_fini(&ec->region_arena, &output_damage);
+	weston_frame_region_fini(&ec->region_arena, &visible_damage);
+	weston_output_end_repaint_stage(output, WESTON_REPAINT_STAGE_RENDER,
+					&stage_begin);
 
 	output->repaint_needed = 0;
 
@@ -2366,6 +3010,16 @@ weston_output_repaint(struct weston_output *output)
 		animation->frame_counter++;
 		animation->frame(animation, output, output->frame_time);
 	}
+	weston_output_end_repaint_stage(output,
+					WESTON_REPAINT_STAGE_FRAME_CALLBACKS,
+					&stage_begin);
+
+	/* Damage accumulated outside of a repaint is counted in the next
+	 * one. */
+	weston_region_arena_reset(&ec->region_arena,
+				  &output->repaint_region_stats);
+
+	wl_signal_emit(&ec->output_repainted_signal, output);
 
 	TL_POINT("core_repaint_posted", TLP_OUTPUT(output), TLP_END);
 
@@ -2379,17 +3033,184 @@ weston_output_schedule_repaint_reset(struct weston_output *output)
 	TL_POINT("core_repaint_exit_loop", TLP_OUTPUT(output), TLP_END);
 }
 
+/* Safety margin added to the measured repaint time */
+#define ADAPTIVE_REPAINT_MARGIN_USEC 1000
+/* Samples needed before the measured repaint time is trusted */
+#define ADAPTIVE_REPAINT_MIN_SAMPLES 8
+/* Percentile of the recent repaint times the window must cover */
+#define ADAPTIVE_REPAINT_PERCENTILE 90
+
+static void
+weston_output_add_repaint_time(struct weston_output *output,
+			       const struct timespec *begin,
+			       const struct timespec *end)
+{
+	struct timespec duration;
+
+	timespec_sub(&duration, end, begin);
+
+	output->repaint_time_usec[output->repaint_time_next] =
+		timespec_to_nsec(&duration) / 1000;
+	output->repaint_time_next =
+		(output->repaint_time_next + 1) % WESTON_REPAINT_TIME_SAMPLES;
+	if (output->repaint_time_count < WESTON_REPAINT_TIME_SAMPLES)
+		output->repaint_time_count++;
+}
+
+static uint32_t
+weston_output_repaint_time_percentile(struct weston_output *output,
+				      unsigned int percentile)
+{
+	uint32_t sorted[WESTON_REPAINT_TIME_SAMPLES];
+	unsigned int n = output->repaint_time_count;
+	unsigned int i, j;
+	uint32_t t;
+
+	if (n == 0)
+		return 0;
+
+	/* Insertion sort, there are only a few samples. */
+	for (i = 0; i < n; i++) {
+		t = output->repaint_time_usec[i];
+		for (j = i; j > 0 && sorted[j - 1] > t; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = t;
+	}
+
+	return sorted[(n - 1) * percentile / 100];
+}
+
+/** Compute the repaint window of an output, in microseconds
+ *
+ * With the adaptive repaint window, the repaint starts just early enough
+ * for a recent high percentile of the measured repaint times, including
+ * the backend submission, to fit before the next refresh. Until enough
+ * repaints have been measured, the configured repaint window is used.
+ */
+static int32_t
+weston_output_get_repaint_window(struct weston_output *output,
+				 int32_t refresh_nsec)
+{
+	struct weston_compositor *compositor = output->compositor;
+	int32_t window;
+
+	if (!compositor->adaptive_repaint_window ||
+	    output->repaint_time_count < ADAPTIVE_REPAINT_MIN_SAMPLES)
+		return compositor->repaint_msec * 1000;
+
+	window = weston_output_repaint_time_percentile(output,
+						ADAPTIVE_REPAINT_PERCENTILE);
+	window += ADAPTIVE_REPAINT_MARGIN_USEC;
+
+	return MIN(window, refresh_nsec / 1000);
+}
+
+/** Move the cursor views of an output to their new position
+ *
+ * \param output The output.
+ * \return 0 if the cursor planes are up to date, -1 if the output needs
+ * a full repaint instead.
+ *
+ * Only the views of the cursor layer are updated. Sprites with
+ * sub-surfaces, whose views are not in that layer, and other views moved
+ * meanwhile need the full repaint.
+ *
+ * Exported for the cursor update test.
+ */
+WL_EXPORT int
+weston_output_update_cursors(struct weston_output *output)
+{
+	struct weston_compositor *compositor = output->compositor;
+	struct weston_layer *cursor_layer = &compositor->cursor_layer;
+	uint32_t output_bit = 1u << output->id;
+	struct weston_view *view;
+	int repaint_needed;
+
+	if (!output->move_cursor)
+		return -1;
+
+	wl_list_for_each(view, &cursor_layer->view_list.link, layer_link.link) {
+		if (!wl_list_empty(&view->surface->subsurface_list))
+			return -1;
+	}
+
+	wl_list_for_each(view, &compositor->view_list, link) {
+		if (view->transform.dirty &&
+		    view->layer_link.layer != cursor_layer)
+			return -1;
+	}
+
+	wl_list_for_each(view, &cursor_layer->view_list.link, layer_link.link) {
+		if (!view->transform.dirty)
+			continue;
+
+		/* Crossing into another output changes what it shows. */
+		if (view->output_mask != output_bit)
+			return -1;
+
+		repaint_needed = output->repaint_needed;
+		view_update_transform(view);
+
+		/* The view only damaged its cursor plane, which is brought
+		 * up to date below, and asked for the repaint of this output
+		 * alone. Drop that request, not the ones of the transform
+		 * listeners. */
+		output->repaint_needed = repaint_needed;
+		wl_signal_emit(&compositor->transform_signal, view->surface);
+
+		if (view->output_mask != output_bit ||
+		    output->move_cursor(output, view) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void
+weston_compositor_flush_pointer_motion(struct weston_compositor *compositor)
+{
+	struct weston_seat *seat;
+	struct weston_pointer *pointer;
+
+	if (!compositor->coalesce_pointer_motion)
+		return;
+
+	wl_list_for_each(seat, &compositor->seat_list, link) {
+		pointer = weston_seat_get_pointer(seat);
+		if (pointer)
+			weston_pointer_flush_motion(pointer);
+	}
+}
+
 static int
 output_repaint_timer_handler(void *data)
 {
 	struct weston_output *output = data;
 	struct weston_compositor *compositor = output->compositor;
+	struct timespec begin, end;
 
-	if (output->repaint_needed &&
+	weston_compositor_flush_pointer_motion(compositor);
+
+	if (output->cursor_update_needed && !output->repaint_needed &&
 	    compositor->state != WESTON_COMPOSITOR_SLEEPING &&
 	    compositor->state != WESTON_COMPOSITOR_OFFSCREEN &&
-	    weston_output_repaint(output) == 0)
-		return 0;
+	    weston_output_update_cursors(output) < 0)
+		output->repaint_needed = 1;
+
+	output->cursor_update_needed = 0;
+
+	if (output->repaint_needed &&
+	    compositor->state != WESTON_COMPOSITOR_SLEEPING &&
+	    compositor->state != WESTON_COMPOSITOR_OFFSCREEN) {
+		weston_compositor_read_presentation_clock(compositor, &begin);
+
+		if (weston_output_repaint(output) == 0) {
+			weston_compositor_read_presentation_clock(compositor,
+								  &end);
+			weston_output_add_repaint_time(output, &begin, &end);
+			return 0;
+		}
+	}
 
 	weston_output_schedule_repaint_reset(output);
 
@@ -2405,12 +3226,17 @@ weston_output_finish_frame(struct weston_output *output,
 	int32_t refresh_nsec;
 	struct timespec now;
 	struct timespec gone;
+	int32_t window_msec;
 	int msec;
 
 	TL_POINT("core_repaint_finished", TLP_OUTPUT(output),
 		 TLP_VBLANK(stamp), TLP_END);
 
-	refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
+	/* A refresh rate of 0 means the output does not pace frames. */
+	refresh_nsec = 0;
+	if (output->current_mode->refresh > 0)
+		refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
+
 	weston_presentation_feedback_present_list(&output->feedback_list,
 						  output, refresh_nsec, stamp,
 						  output->msc,
@@ -2418,10 +3244,24 @@ weston_output_finish_frame(struct weston_output *output,
 
 	output->frame_time = stamp->tv_sec * 1000 + stamp->tv_nsec / 1000000;
 
+	if (refresh_nsec == 0) {
+		output->repaint_window_usec = 0;
+		output_repaint_timer_handler(output);
+		return;
+	}
+
+	output->repaint_window_usec =
+		weston_output_get_repaint_window(output, refresh_nsec);
+
+	/* round the window up to whole milliseconds */
+	window_msec = output->repaint_window_usec / 1000;
+	if (output->repaint_window_usec % 1000 > 0)
+		window_msec++;
+
 	weston_compositor_read_presentation_clock(compositor, &now);
 	timespec_sub(&gone, &now, stamp);
 	msec = (refresh_nsec - timespec_to_nsec(&gone)) / 1000000; /* floor */
-	msec -= compositor->repaint_msec;
+	msec -= window_msec;
 
 	if (msec < -1000 || msec > 1000) {
 		static bool warned;
@@ -2455,17 +3295,28 @@ idle_repaint(void *data)
 	output->start_repaint_loop(output);
 }
 
+static void
+layer_entry_view_list_dirty(struct weston_layer_entry *entry)
+{
+	struct weston_view *view =
+		container_of(entry, struct weston_view, layer_link);
+
+	weston_compositor_view_list_dirty(view->surface->compositor);
+}
+
 WL_EXPORT void
 weston_layer_entry_insert(struct weston_layer_entry *list,
 			  struct weston_layer_entry *entry)
 {
 	wl_list_insert(&list->link, &entry->link);
 	entry->layer = list->layer;
+	layer_entry_view_list_dirty(entry);
 }
 
 WL_EXPORT void
 weston_layer_entry_remove(struct weston_layer_entry *entry)
 {
+	layer_entry_view_list_dirty(entry);
 	wl_list_remove(&entry->link);
 	wl_list_init(&entry->link);
 	entry->layer = NULL;
@@ -2504,11 +3355,24 @@ weston_layer_set_mask_infinite(struct weston_layer *layer)
 				     UINT32_MAX, UINT32_MAX);
 }
 
+static void
+weston_output_enter_repaint_loop(struct weston_output *output)
+{
+	struct wl_event_loop *loop;
+
+	if (output->repaint_scheduled)
+		return;
+
+	loop = wl_display_get_event_loop(output->compositor->wl_display);
+	wl_event_loop_add_idle(loop, idle_repaint, output);
+	output->repaint_scheduled = 1;
+	TL_POINT("core_repaint_enter_loop", TLP_OUTPUT(output), TLP_END);
+}
+
 WL_EXPORT void
 weston_output_schedule_repaint(struct weston_output *output)
 {
 	struct weston_compositor *compositor = output->compositor;
-	struct wl_event_loop *loop;
 
 	if (compositor->state == WESTON_COMPOSITOR_SLEEPING ||
 	    compositor->state == WESTON_COMPOSITOR_OFFSCREEN)
@@ -2517,14 +3381,29 @@ weston_output_schedule_repaint(struct weston_output *output)
 	if (!output->repaint_needed)
 		TL_POINT("core_repaint_req", TLP_OUTPUT(output), TLP_END);
 
-	loop = wl_display_get_event_loop(compositor->wl_display);
 	output->repaint_needed = 1;
-	if (output->repaint_scheduled)
+	weston_output_enter_repaint_loop(output);
+}
+
+/** Schedule a cursor-only update of an output
+ *
+ * \param output The output.
+ *
+ * Runs the repaint loop of the output for one frame, which delivers the
+ * coalesced pointer motion and moves the cursor planes. The output is
+ * only repainted if something else asks for it.
+ */
+WL_EXPORT void
+weston_output_schedule_cursor_update(struct weston_output *output)
+{
+	struct weston_compositor *compositor = output->compositor;
+
+	if (compositor->state == WESTON_COMPOSITOR_SLEEPING ||
+	    compositor->state == WESTON_COMPOSITOR_OFFSCREEN)
 		return;
 
-	wl_event_loop_add_idle(loop, idle_repaint, output);
-	output->repaint_scheduled = 1;
-	TL_POINT("core_repaint_enter_loop", TLP_OUTPUT(output), TLP_END);
+	output->cursor_update_needed = 1;
+	weston_output_enter_repaint_loop(output);
 }
 
 WL_EXPORT void
@@ -2648,6 +3527,7 @@ surface_set_opaque_region(struct wl_client *client,
 	} else {
 		pixman_region32_clear(&surface->pending.opaque);
 	}
+	surface->pending.opaque_changed = true;
 }
 
 static void
@@ -2666,6 +3546,7 @@ surface_set_input_region(struct wl_client *client,
 		pixman_region32_fini(&surface->pending.input);
 		region_init_infinite(&surface->pending.input);
 	}
+	surface->pending.input_changed = true;
 }
 
 /* Cause damage to this sub-surface and all its children.
@@ -2686,11 +3567,30 @@ weston_surface_damage_subsurfaces(struct weston_subsurface *sub)
 			weston_surface_damage_subsurfaces(child);
 }
 
+static bool
+weston_surface_subsurface_order_changed(struct weston_surface *surface)
+{
+	struct weston_subsurface *sub;
+	struct wl_list *link = surface->subsurface_list.next;
+
+	wl_list_for_each(sub, &surface->subsurface_list_pending,
+			 parent_link_pending) {
+		if (link != &sub->parent_link)
+			return true;
+		link = link->next;
+	}
+
+	return false;
+}
+
 static void
 weston_surface_commit_subsurface_order(struct weston_surface *surface)
 {
 	struct weston_subsurface *sub;
 
+	if (weston_surface_subsurface_order_changed(surface))
+		weston_compositor_view_list_dirty(surface->compositor);
+
 	wl_list_for_each_reverse(sub, &surface->subsurface_list_pending,
 				 parent_link_pending) {
 		wl_list_remove(&sub->parent_link);
@@ -2777,6 +3677,26 @@ weston_surface_build_buffer_matrix(const struct weston_surface *surface,
 	weston_matrix_scale(matrix, vp->buffer.scale, vp->buffer.scale, 1);
 }
 
+/* The buffer matrices only depend on the buffer viewport and the buffer
+ * size, so they are rebuilt only when one of those changed. */
+static void
+weston_surface_update_buffer_matrix(struct weston_surface *surface,
+				    bool viewport_changed)
+{
+	if (!viewport_changed &&
+	    surface->buffer_matrix_width == surface->width_from_buffer &&
+	    surface->buffer_matrix_height == surface->height_from_buffer)
+		return;
+
+	weston_surface_build_buffer_matrix(surface,
+					   &surface->surface_to_buffer_matrix);
+	weston_matrix_invert(&surface->buffer_to_surface_matrix,
+			     &surface->surface_to_buffer_matrix);
+
+	surface->buffer_matrix_width = surface->width_from_buffer;
+	surface->buffer_matrix_height = surface->height_from_buffer;
+}
+
 /**
  * Compute a + b > c while being safe to overflows.
  */
@@ -2904,6 +3824,9 @@ weston_surface_commit_state(struct weston_surface *surface,
 {
 	struct weston_view *view;
 	pixman_region32_t opaque;
+	int32_t old_width = surface->width;
+	int32_t old_height = surface->height;
+	bool resized;
 
 	/* wl_surface.set_buffer_transform */
 	/* wl_surface.set_buffer_scale */
@@ -2918,10 +3841,8 @@ weston_surface_commit_state(struct weston_surface *surface,
 
 	weston_surface_set_alpha(surface, state->alpha);
 
-	weston_surface_build_buffer_matrix(surface,
-					   &surface->surface_to_buffer_matrix);
-	weston_matrix_invert(&surface->buffer_to_surface_matrix,
-			     &surface->surface_to_buffer_matrix);
+	weston_surface_update_buffer_matrix(surface,
+					    state->buffer_viewport.changed);
 
 	if (state->newly_attached || state->buffer_viewport.changed) {
 		weston_surface_update_size(surface);
@@ -2949,22 +3870,42 @@ weston_surface_commit_state(struct weston_surface *surface,
 				       0, 0, surface->width, surface->height);
 	pixman_region32_clear(&state->damage_surface);
 
+	/* The clipped regions only need updating when they or the surface
+	 * size changed. */
+	resized = surface->width != old_width || surface->height != old_height;
+
 	/* wl_surface.set_opaque_region */
-	pixman_region32_init(&opaque);
-	pixman_region32_intersect_rect(&opaque, &state->opaque,
-				       0, 0, surface->width, surface->height);
+	if (state->opaque_changed || resized) {
+		if (state->opaque_changed) {
+			region_swap(&surface->committed_opaque, &state->opaque);
+			state->opaque_changed = false;
+		}
 
-	if (!pixman_region32_equal(&opaque, &surface->opaque)) {
-		pixman_region32_copy(&surface->opaque, &opaque);
-		wl_list_for_each(view, &surface->views, surface_link)
-			weston_view_geometry_dirty(view);
-	}
+		pixman_region32_init(&opaque);
+		pixman_region32_intersect_rect(&opaque,
+					       &surface->committed_opaque, 0, 0,
+					       surface->width, surface->height);
+
+		if (!pixman_region32_equal(&opaque, &surface->opaque)) {
+			region_swap(&surface->opaque, &opaque);
+			wl_list_for_each(view, &surface->views, surface_link)
+				weston_view_geometry_dirty(view);
+		}
 
-	pixman_region32_fini(&opaque);
+		pixman_region32_fini(&opaque);
+	}
 
 	/* wl_surface.set_input_region */
-	pixman_region32_intersect_rect(&surface->input, &state->input,
-				       0, 0, surface->width, surface->height);
+	if (state->input_changed || resized) {
+		if (state->input_changed) {
+			region_swap(&surface->committed_input, &state->input);
+			state->input_changed = false;
+		}
+
+		pixman_region32_intersect_rect(&surface->input,
+					       &surface->committed_input, 0, 0,
+					       surface->width, surface->height);
+	}
 
 	/* wl_surface.frame */
 	wl_list_insert_list(&surface->frame_callback_list,
@@ -2981,6 +3922,8 @@ weston_surface_commit_state(struct weston_surface *surface,
 			    &state->feedback_list);
 	wl_list_init(&state->feedback_list);
 
+	weston_surface_update_frame_request(surface);
+
 	wl_signal_emit(&surface->commit_signal, surface);
 }
 
@@ -3237,12 +4180,19 @@ weston_subsurface_commit_to_cache(struct weston_subsurface *sub)
 	 * translated to correspond to the new surface coordinate system
 	 * origin.
 	 */
-	pixman_region32_translate(&sub->cached.damage_surface,
-				  -surface->pending.sx, -surface->pending.sy);
-	pixman_region32_union(&sub->cached.damage_surface,
-			      &sub->cached.damage_surface,
-			      &surface->pending.damage_surface);
-	pixman_region32_clear(&surface->pending.damage_surface);
+	if (pixman_region32_not_empty(&sub->cached.damage_surface)) {
+		pixman_region32_translate(&sub->cached.damage_surface,
+					  -surface->pending.sx,
+					  -surface->pending.sy);
+		pixman_region32_union(&sub->cached.damage_surface,
+				      &sub->cached.damage_surface,
+				      &surface->pending.damage_surface);
+		pixman_region32_clear(&surface->pending.damage_surface);
+	} else {
+		/* Nothing cached yet, take the pending damage over. */
+		region_swap(&sub->cached.damage_surface,
+			    &surface->pending.damage_surface);
+	}
 
 	if (surface->pending.newly_attached) {
 		sub->cached.newly_attached = 1;
@@ -3267,9 +4217,19 @@ weston_subsurface_commit_to_cache(struct weston_subsurface *sub)
 
 	weston_surface_reset_pending_buffer(surface);
 
-	pixman_region32_copy(&sub->cached.opaque, &surface->pending.opaque);
+	/* Regions set since the last commit replace the cached ones.
+	 * Otherwise the cache keeps what it has, if anything. */
+	if (surface->pending.opaque_changed) {
+		region_swap(&sub->cached.opaque, &surface->pending.opaque);
+		sub->cached.opaque_changed = true;
+		surface->pending.opaque_changed = false;
+	}
 
-	pixman_region32_copy(&sub->cached.input, &surface->pending.input);
+	if (surface->pending.input_changed) {
+		region_swap(&sub->cached.input, &surface->pending.input);
+		sub->cached.input_changed = true;
+		surface->pending.input_changed = false;
+	}
 
 	wl_list_insert_list(&sub->cached.frame_callback_list,
 			    &surface->pending.frame_callback_list);
@@ -3388,6 +4348,7 @@ subsurface_committed(struct weston_surface *surface, int32_t dx, int32_t dy)
 
 	if (!weston_surface_is_mapped(surface)) {
 		surface->is_mapped = true;
+		weston_compositor_view_list_dirty(surface->compositor);
 
 		/* Cannot call weston_view_update_transform(),
 		 * because that would call it also for the parent surface,
@@ -3733,6 +4694,7 @@ subsurface_set_desync(struct wl_client *client, struct wl_resource *resource)
 static void
 weston_subsurface_unlink_parent(struct weston_subsurface *sub)
 {
+	weston_compositor_view_list_dirty(sub->surface->compositor);
 	wl_list_remove(&sub->parent_link);
 	wl_list_remove(&sub->parent_link_pending);
 	wl_list_remove(&sub->parent_destroy_listener.link);
@@ -3799,6 +4761,8 @@ weston_subsurface_link_parent(struct weston_subsurface *sub,
 	wl_list_insert(&parent->subsurface_list, &sub->parent_link);
 	wl_list_insert(&parent->subsurface_list_pending,
 		       &sub->parent_link_pending);
+
+	weston_compositor_view_list_dirty(parent->compositor);
 }
 
 static void
@@ -4425,6 +5389,7 @@ weston_output_enable_undo(struct weston_output *output)
 
 	pixman_region32_fini(&output->region);
 	pixman_region32_fini(&output->previous_damage);
+	wl_array_release(&output->view_list);
 	output->compositor->output_id_pool &= ~(1u << output->id);
 
 	output->enabled = false;
@@ -4448,6 +5413,7 @@ static void
 weston_compositor_remove_output(struct weston_output *output)
 {
 	struct wl_resource *resource;
+	struct weston_surface *surface, *snext;
 	struct weston_view *view;
 
 	assert(output->destroying);
@@ -4457,8 +5423,26 @@ weston_compositor_remove_output(struct weston_output *output)
 			weston_view_assign_output(view);
 	}
 
+	/* Surfaces with views off the view list, in hidden layers or
+	 * unmapped, still point to the output: reassign those views too. */
+	wl_list_for_each_safe(surface, snext, &output->surface_list,
+			      output_link) {
+		wl_list_for_each(view, &surface->views, surface_link) {
+			if (view->output == output)
+				weston_view_assign_output(view);
+		}
+
+		if (surface->output == output)
+			weston_surface_set_output(surface, NULL);
+	}
+
 	weston_presentation_feedback_discard_list(&output->feedback_list);
 
+	/* Requests of surfaces not reassigned above wait for an output. */
+	wl_list_insert_list(&output->compositor->frame_request_list,
+			    &output->frame_request_list);
+	wl_list_init(&output->frame_request_list);
+
 	weston_compositor_reflow_outputs(output->compositor, output, output->width);
 	wl_list_remove(&output->link);
 
@@ -4641,11 +5625,17 @@ weston_output_enable(struct weston_output *output)
 	wl_list_init(&output->animation_list);
 	wl_list_init(&output->resource_list);
 	wl_list_init(&output->feedback_list);
+	wl_list_init(&output->frame_request_list);
+	wl_list_init(&output->surface_list);
 	wl_list_init(&output->link);
+	wl_array_init(&output->view_list);
+	output->view_list_serial = c->view_output_serial - 1;
 
 	loop = wl_display_get_event_loop(c->wl_display);
 	output->repaint_timer = wl_event_loop_add_timer(loop,
 					output_repaint_timer_handler, output);
+	output->repaint_time_count = 0;
+	output->repaint_time_next = 0;
 
 	/* Invert the output id pool and look for the lowest numbered
 	 * switch (the least significant bit).  Take that bit's position
@@ -5060,6 +6050,26 @@ timeline_key_binding_handler(struct weston_keyboard *keyboard, uint32_t time,
 		weston_timeline_open(compositor);
 }
 
+static void
+repaint_window_key_binding_handler(struct weston_keyboard *keyboard,
+				   uint32_t time, uint32_t key, void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct weston_output *output;
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		weston_log("output %s: repaint window %d us (%s), "
+			   "repaint time p50 %u us, p%d %u us\n",
+			   output->name, output->repaint_window_usec,
+			   compositor->adaptive_repaint_window ?
+				"adaptive" : "fixed",
+			   weston_output_repaint_time_percentile(output, 50),
+			   ADAPTIVE_REPAINT_PERCENTILE,
+			   weston_output_repaint_time_percentile(output,
+						ADAPTIVE_REPAINT_PERCENTILE));
+	}
+}
+
 /** Create the compositor.
  *
  * This functions creates and initializes a compositor instance.
@@ -5097,6 +6107,7 @@ weston_compositor_create(struct wl_display *display, void *user_data)
 	wl_signal_init(&ec->output_destroyed_signal);
 	wl_signal_init(&ec->output_moved_signal);
 	wl_signal_init(&ec->output_resized_signal);
+	wl_signal_init(&ec->output_repainted_signal);
 	wl_signal_init(&ec->session_signal);
 	ec->session_active = 1;
 
@@ -5125,6 +6136,10 @@ weston_compositor_create(struct wl_display *display, void *user_data)
 		goto fail;
 
 	wl_list_init(&ec->view_list);
+	wl_list_init(&ec->frame_request_list);
+	wl_array_init(&ec->view_list_layers);
+	weston_region_arena_init(&ec->region_arena);
+	ec->view_list_needs_rebuild = true;
 	wl_list_init(&ec->plane_list);
 	wl_list_init(&ec->layer_list);
 	wl_list_init(&ec->seat_list);
@@ -5154,6 +6169,9 @@ weston_compositor_create(struct wl_display *display, void *user_data)
 
 	weston_compositor_add_debug_binding(ec, KEY_T,
 					    timeline_key_binding_handler, ec);
+	weston_compositor_add_debug_binding(ec, KEY_L,
+					    repaint_window_key_binding_handler,
+					    ec);
 
 	return ec;
 
@@ -5415,6 +6433,9 @@ weston_compositor_destroy(struct weston_compositor *compositor)
 
 	weston_plugin_api_destroy_list(compositor);
 
+	wl_array_release(&compositor->view_list_layers);
+	weston_region_arena_release(&compositor->region_arena);
+	weston_compositor_destroy_pick_grid(compositor);
 	free(compositor);
 }
 
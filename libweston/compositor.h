@@ -154,6 +154,49 @@ enum dpms_enum {
 	WESTON_DPMS_OFF
 };
 
+#define WESTON_REPAINT_TIME_SAMPLES 32
+
+/** Stages of weston_output_repaint(), for profiling */
+enum weston_repaint_stage {
+	WESTON_REPAINT_STAGE_VIEW_LIST,
+	WESTON_REPAINT_STAGE_ASSIGN_PLANES,
+	WESTON_REPAINT_STAGE_ACCUMULATE_DAMAGE,
+	WESTON_REPAINT_STAGE_RENDER,
+	WESTON_REPAINT_STAGE_FRAME_CALLBACKS,	/* with repick and animations */
+	WESTON_REPAINT_STAGE_COUNT
+};
+
+/** Region temporaries used by a repaint, for profiling */
+struct weston_region_arena_stats {
+	/** Temporaries taken from the arenas */
+	uint32_t regions;
+	/** Temporaries that held rectangle storage, each of which would
+	 * have been allocated without the arenas */
+	uint32_t heap_regions;
+	/** Temporaries whose storage still had to be allocated */
+	uint32_t allocs;
+};
+
+/** Pool of pixman rectangle storage for short-lived regions
+ *
+ * Pixman allocates the rectangles of a region as soon as it has more
+ * than one. Regions taken from an arena start out with storage left
+ * over from earlier temporaries, which pixman reuses as long as it is
+ * large enough, and give it back to the pool when they are released.
+ *
+ * An arena must only be used by one thread at a time.
+ */
+struct weston_region_arena {
+	struct wl_array storage; /* pixman_region32_data_t *, unused */
+	struct weston_region_arena_stats stats;
+};
+
+/** A region taken from a weston_region_arena */
+struct weston_frame_region {
+	pixman_region32_t region;
+	pixman_region32_data_t *storage; /* as lent by the arena */
+};
+
 struct weston_output {
 	uint32_t id;
 	char *name;
@@ -180,6 +223,8 @@ struct weston_output {
 	pixman_region32_t previous_damage;
 	int repaint_needed;
 	int repaint_scheduled;
+	/** Only cursor views moved since the last frame */
+	int cursor_update_needed;
 	struct wl_event_source *repaint_timer;
 	struct weston_output_zoom zoom;
 	int dirty;
@@ -191,6 +236,26 @@ struct weston_output {
 	int disable_planes;
 	int destroying;
 	struct wl_list feedback_list;
+	/* Surfaces shown on this output with frame callbacks or feedback
+	 * to dispatch, weston_surface::frame_request_link */
+	struct wl_list frame_request_list;
+	/* Surfaces whose primary output this is, weston_surface::output_link */
+	struct wl_list surface_list;
+	/* The views of the compositor view list shown on this output, in
+	 * the same order; rebuilt when view_output_serial changes. */
+	struct wl_array view_list;	/* struct weston_view * */
+	uint32_t view_list_serial;
+
+	/* Durations of the last repaints, for the adaptive repaint window */
+	uint32_t repaint_time_usec[WESTON_REPAINT_TIME_SAMPLES];
+	unsigned int repaint_time_count;
+	unsigned int repaint_time_next;
+	/** Repaint window used for the last frame, in microseconds */
+	int32_t repaint_window_usec;
+	/** Time spent in each stage of the last repaint, in nanoseconds */
+	uint32_t repaint_stage_nsec[WESTON_REPAINT_STAGE_COUNT];
+	/** Region temporaries used by the last repaint */
+	struct weston_region_arena_stats repaint_region_stats;
 
 	char *make, *model, *serial_number;
 	uint32_t subpixel;
@@ -209,6 +274,11 @@ struct weston_output {
 			pixman_region32_t *damage);
 	void (*destroy)(struct weston_output *output);
 	void (*assign_planes)(struct weston_output *output);
+	/* Reposition the cursor plane showing view, without a repaint.
+	 * Returns -1 if view is not on a cursor plane of the output or
+	 * cannot be moved there. Optional. */
+	int (*move_cursor)(struct weston_output *output,
+			   struct weston_view *view);
 	int (*switch_mode)(struct weston_output *output, struct weston_mode *mode);
 
 	/* backlight values are on 0-255 range, where higher is brighter */
@@ -382,6 +452,13 @@ struct weston_pointer {
 	uint32_t button_count;
 
 	struct wl_listener output_destroy_listener;
+
+	/* Motion held back until the next output frame, see
+	 * weston_compositor::coalesce_pointer_motion */
+	bool motion_pending;
+	bool frame_pending;
+	uint32_t pending_motion_time;
+	struct weston_pointer_motion_event pending_motion;
 };
 
 
@@ -451,6 +528,8 @@ void
 weston_pointer_move(struct weston_pointer *pointer,
 		    struct weston_pointer_motion_event *event);
 void
+weston_pointer_flush_motion(struct weston_pointer *pointer);
+void
 weston_pointer_set_default_grab(struct weston_pointer *pointer,
 		const struct weston_pointer_grab_interface *interface);
 
@@ -659,6 +738,31 @@ struct weston_plane {
 	struct wl_list link;
 };
 
+/** A view to be assigned a plane */
+struct weston_plane_candidate {
+	struct weston_view *view;
+	/** Part of the view not hidden by opaque views above it, in
+	 * global coordinates */
+	pixman_region32_t visible;
+	/** Nothing of the view is visible */
+	bool occluded;
+};
+
+/** Occlusion pass shared by the plane assignment of backends
+ *
+ * weston_plane_planner_update() lists the views in the order backends
+ * assign planes, bottom-most first, along with the part of each which
+ * is not hidden by the opaque views above it. Fully occluded views
+ * need no plane: backends move them to occluded_plane, which is not
+ * stacked, so that neither the renderer nor the hardware shows them.
+ */
+struct weston_plane_planner {
+	struct weston_plane occluded_plane;
+	struct wl_array candidates; /* struct weston_plane_candidate */
+	int n_candidates;
+	int n_occluded;
+};
+
 struct weston_renderer {
 	int (*read_pixels)(struct weston_output *output,
 			       pixman_format_code_t format, void *pixels,
@@ -750,6 +854,8 @@ struct weston_backend {
 struct weston_desktop_xwayland;
 struct weston_desktop_xwayland_interface;
 
+struct weston_pick_grid;
+
 struct weston_compositor {
 	struct wl_signal destroy_signal;
 
@@ -776,6 +882,7 @@ struct weston_compositor {
 	struct wl_signal output_destroyed_signal;
 	struct wl_signal output_moved_signal;
 	struct wl_signal output_resized_signal; /* callback argument: resized output */
+	struct wl_signal output_repainted_signal; /* callback argument: repainted output */
 
 	struct wl_signal session_signal;
 	int session_active;
@@ -788,6 +895,16 @@ struct weston_compositor {
 	struct wl_list seat_list;
 	struct wl_list layer_list;
 	struct wl_list view_list;	/* struct weston_view::link */
+	bool view_list_needs_rebuild;
+	uint32_t view_list_serial; /* bumped on each view list rebuild */
+	/* bumped when the view list or the output mask of a view changes */
+	uint32_t view_output_serial;
+	bool view_transforms_dirty;
+	/* Surfaces with frame requests but no output yet */
+	struct wl_list frame_request_list;
+	struct wl_array view_list_layers; /* layer_list when view_list built */
+	struct weston_pick_grid *pick_grid; /* spatial index of view_list */
+	struct weston_region_arena region_arena; /* repaint temporaries */
 	struct wl_list plane_list;
 	struct wl_list key_binding_list;
 	struct wl_list modifier_binding_list;
@@ -833,6 +950,12 @@ struct weston_compositor {
 
 	clockid_t presentation_clock;
 	int32_t repaint_msec;
+	/* Derive each output's repaint window from its repaint times,
+	 * instead of using repaint_msec */
+	bool adaptive_repaint_window;
+	/* Deliver pointer motion once per output frame, or before the
+	 * next button, axis or key event */
+	bool coalesce_pointer_motion;
 
 	unsigned int activate_serial;
 
@@ -932,6 +1055,7 @@ struct weston_view {
 	struct wl_signal destroy_signal;
 
 	struct wl_list link;             /* weston_compositor::view_list */
+	uint32_t view_list_serial;       /* of the last view list it was in */
 	struct weston_layer_entry layer_link; /* part of geometry */
 	struct weston_plane *plane;
 
@@ -1028,11 +1152,16 @@ struct weston_surface_state {
 	/* Internal damage, e.g. when restacking subsurfaces */
 	bool damage_pending;
 
-	/* wl_surface.set_opaque_region */
+	/* wl_surface.set_opaque_region and wl_surface.set_input_region
+	 *
+	 * Only meaningful while the matching changed flag is set, which
+	 * whoever writes the region must set. Committing or caching the
+	 * state moves the region out and clears the flag.
+	 */
 	pixman_region32_t opaque;
-
-	/* wl_surface.set_input_region */
+	bool opaque_changed;
 	pixman_region32_t input;
+	bool input_changed;
 
 	/* wl_surface.frame */
 	struct wl_list frame_callback_list;
@@ -1089,6 +1218,10 @@ struct weston_surface {
 
 	pixman_region32_t opaque;        /* part of geometry, see below */
 	pixman_region32_t input;
+	/* opaque and input as last committed, before clipping to the
+	 * surface size */
+	pixman_region32_t committed_opaque;
+	pixman_region32_t committed_input;
 	int32_t width, height;
 	int32_t ref_count;
 
@@ -1105,9 +1238,10 @@ struct weston_surface {
 	 * Which output to vsync this surface to.
 	 * Used to determine whether to send or queue frame events, and for
 	 * other client-visible syncing/throttling tied to the output
-	 * repaint cycle.
+	 * repaint cycle. Set with weston_surface_set_output().
 	 */
 	struct weston_output *output;
+	struct wl_list output_link; /* weston_output::surface_list */
 
 	/*
 	 * A more complete representation of all outputs this surface is
@@ -1117,6 +1251,9 @@ struct weston_surface {
 
 	struct wl_list frame_callback_list;
 	struct wl_list feedback_list;
+	/* weston_output::frame_request_list of the output, or the one of
+	 * the compositor, while either list above is not empty */
+	struct wl_list frame_request_link;
 
 	struct weston_buffer_reference buffer_ref;
 	struct weston_buffer_viewport buffer_viewport;
@@ -1132,9 +1269,12 @@ struct weston_surface {
 
 	/* Matrices representating of the full transformation between
 	 * buffer and surface coordinates.  These matrices are updated
-	 * using the weston_surface_build_buffer_matrix function. */
+	 * using the weston_surface_build_buffer_matrix function, on
+	 * commit, when the buffer viewport or the buffer size changed. */
 	struct weston_matrix buffer_to_surface_matrix;
 	struct weston_matrix surface_to_buffer_matrix;
+	int32_t buffer_matrix_width; /* width_from_buffer they were built for */
+	int32_t buffer_matrix_height;
 
 	/*
 	 * If non-NULL, this function will be called on
@@ -1336,6 +1476,21 @@ weston_compositor_stack_plane(struct weston_compositor *ec,
 			      struct weston_plane *plane,
 			      struct weston_plane *above);
 
+void
+weston_plane_planner_init(struct weston_plane_planner *planner,
+			  struct weston_compositor *ec);
+void
+weston_plane_planner_release(struct weston_plane_planner *planner);
+void
+weston_plane_planner_update(struct weston_plane_planner *planner);
+
+#define weston_plane_planner_for_each(candidate, planner)		\
+	for (candidate = (planner)->candidates.data;			\
+	     (const char *) candidate <					\
+		(const char *) (planner)->candidates.data +		\
+		(planner)->n_candidates * sizeof *candidate;		\
+	     candidate++)
+
 /* An invalid flag in presented_flags to catch logic errors. */
 #define WP_PRESENTATION_FEEDBACK_INVALID (1U << 31)
 
@@ -1346,10 +1501,20 @@ weston_output_finish_frame(struct weston_output *output,
 void
 weston_output_schedule_repaint(struct weston_output *output);
 void
+weston_output_schedule_cursor_update(struct weston_output *output);
+int
+weston_output_update_cursors(struct weston_output *output);
+void
 weston_output_damage(struct weston_output *output);
 void
 weston_compositor_schedule_repaint(struct weston_compositor *compositor);
 void
+weston_compositor_view_list_dirty(struct weston_compositor *compositor);
+void
+weston_compositor_accumulate_damage(struct weston_compositor *ec);
+void
+weston_output_accumulate_damage(struct weston_output *output);
+void
 weston_compositor_fade(struct weston_compositor *compositor, float tint);
 void
 weston_compositor_damage_all(struct weston_compositor *compositor);
@@ -1512,6 +1677,9 @@ weston_view_set_alpha(struct weston_view *view, float alpha);
 void
 weston_view_schedule_repaint(struct weston_view *view);
 
+void
+weston_view_schedule_cursor_update(struct weston_view *view);
+
 bool
 weston_surface_is_mapped(struct weston_surface *surface);
 
@@ -1522,6 +1690,10 @@ weston_surface_set_size(struct weston_surface *surface,
 void
 weston_surface_set_alpha(struct weston_surface *surface, float alpha);
 
+void
+weston_surface_set_output(struct weston_surface *surface,
+			  struct weston_output *output);
+
 void
 weston_surface_schedule_repaint(struct weston_surface *surface);
 
@@ -1719,8 +1891,17 @@ typedef void (*weston_screenshooter_done_func_t)(void *data,
 int
 weston_screenshooter_shoot(struct weston_output *output, struct weston_buffer *buffer,
 			   weston_screenshooter_done_func_t done, void *data);
+enum weston_recorder_compression {
+	WESTON_RECORDER_COMPRESSION_NONE,
+	WESTON_RECORDER_COMPRESSION_ZLIB,
+};
+
 struct weston_recorder *
 weston_recorder_start(struct weston_output *output, const char *filename);
+struct weston_recorder *
+weston_recorder_start_compressed(struct weston_output *output,
+				 const char *filename,
+				 enum weston_recorder_compression compression);
 void
 weston_recorder_stop(struct weston_recorder *recorder);
 
@@ -1818,6 +1999,20 @@ weston_transformed_region(int width, int height,
 			  int32_t scale,
 			  pixman_region32_t *src, pixman_region32_t *dest);
 
+void
+weston_region_arena_init(struct weston_region_arena *arena);
+void
+weston_region_arena_release(struct weston_region_arena *arena);
+void
+weston_region_arena_reset(struct weston_region_arena *arena,
+			  struct weston_region_arena_stats *stats);
+void
+weston_frame_region_init(struct weston_region_arena *arena,
+			 struct weston_frame_region *frame_region);
+void
+weston_frame_region_fini(struct weston_region_arena *arena,
+			 struct weston_frame_region *frame_region);
+
 void *
 weston_load_module(const char *name, const char *entrypoint);
 
@@ -1,21 +1,77 @@
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
 #include <errno.h>
 #include <assert.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
 
 #include <wayland-server.h>
 #include <ela/ela.h>
 #include <ela/backend.h>
 
 #include "ela-wayland.h"
+#include "shared/helpers.h"
 
 #define ELA_EVENT_DELAY_FREE  0x20000000
 #define ELA_EVENT_NEED_FREE   0x40000000
 #define ELA_EVENT_ENABLE      0x80000000
 
+/* Sources watched by the input thread, at most */
+#define ELW_MAX_WATCHED 64
+/* Must be a power of two. Each watched source has at most one entry in
+ * the ring, but entries of removed sources may linger. */
+#define ELW_RING_SIZE 256
+/* Epoll key of the eventfd that stops the input thread */
+#define ELW_QUIT_KEY UINT64_MAX
+
+/*
+ * With the input thread, the readable-only fd sources are watched by a
+ * thread instead of the wayland event loop. The thread timestamps the
+ * readiness of each fd and queues it in a ring, which the main loop
+ * drains when the eventfd fires, dispatching the source callbacks with
+ * the arrival time available through ela_wayland_get_event_time().
+ *
+ * The fds are registered with EPOLLONESHOT and rearmed once dispatched,
+ * so the thread does not spin on data the main loop has not read yet.
+ * The time is that of the readiness: all the reports the callback reads
+ * in one dispatch share it, including those that arrived meanwhile.
+ * The input thread only advances head and the main loop only advances
+ * tail. Ring entries name a source by slot and generation, entries of
+ * sources removed since are dropped.
+ */
+struct elw_ready {
+	uint64_t key;
+	struct timeval time;
+};
+
+struct elw_slot {
+	struct ela_event_source *source;
+	uint32_t generation;
+};
+
 struct ela_wayland {
 	struct ela_el base;
 	struct wl_event_loop *loop;
 	int run;
+
+	int epoll_fd;
+	int ready_fd;
+	int quit_fd;
+	int stopping;		/* set by the main loop, read atomically */
+	pthread_t thread;
+	struct wl_event_source *ready_source;
+	struct elw_slot slots[ELW_MAX_WATCHED];
+	struct elw_ready ring[ELW_RING_SIZE];
+	uint32_t head;
+	uint32_t tail;
+
+	int has_event_time;
+	struct timeval event_time;
 };
 
 struct ela_event_source {
@@ -24,6 +80,7 @@ struct ela_event_source {
 	struct wl_event_source *fd_source;
 	uint32_t flags;
 	int fd;
+	int slot;
 	int timeout;
 	ela_handler_func *callback;
 	void *user_data;
@@ -91,15 +148,203 @@ handle_timer_event(void *data)
 	return dispatch_event(source, -1, flags);
 }
 
+static uint64_t
+elw_slot_key(struct ela_wayland *elw, int slot)
+{
+	return (uint64_t) elw->slots[slot].generation << 32 | slot;
+}
+
+static int
+elw_watch(struct ela_wayland *elw, struct ela_event_source *source)
+{
+	struct epoll_event ev;
+	int i;
+
+	if (elw->epoll_fd < 0)
+		return -1;
+
+	for (i = 0; i < ELW_MAX_WATCHED; i++)
+		if (!elw->slots[i].source)
+			break;
+
+	if (i == ELW_MAX_WATCHED)
+		return -1;
+
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.u64 = elw_slot_key(elw, i);
+	if (epoll_ctl(elw->epoll_fd, EPOLL_CTL_ADD, source->fd, &ev) < 0)
+		return -1;
+
+	elw->slots[i].source = source;
+	source->slot = i;
+
+	return 0;
+}
+
+static void
+elw_unwatch(struct ela_wayland *elw, struct ela_event_source *source)
+{
+	struct elw_slot *slot = &elw->slots[source->slot];
+
+	/* fails harmlessly if the fd is already closed */
+	epoll_ctl(elw->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+
+	slot->source = NULL;
+	slot->generation++;
+	source->slot = -1;
+}
+
+static void
+elw_rearm(struct ela_wayland *elw, struct ela_event_source *source)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.u64 = elw_slot_key(elw, source->slot);
+	epoll_ctl(elw->epoll_fd, EPOLL_CTL_MOD, source->fd, &ev);
+}
+
+/* Increments an eventfd. EAGAIN means the counter is full, the reader
+ * has a wakeup pending then. */
+static int
+elw_signal(int fd)
+{
+	uint64_t one = 1;
+	ssize_t len;
+
+	do {
+		len = write(fd, &one, sizeof one);
+	} while (len < 0 && errno == EINTR);
+
+	return len < 0 && errno != EAGAIN ? -1 : 0;
+}
+
+/* Returns -1 if the thread is stopped while the ring is full, the main
+ * loop draining it no more then. */
+static int
+elw_push_ready(struct ela_wayland *elw, uint64_t key,
+	       const struct timeval *time)
+{
+	struct timespec backoff = { 0, 1000000 };
+	struct elw_ready *ready;
+
+	/* Only stale entries can fill the ring, which the main loop is
+	 * bound to drain. */
+	while (elw->head - __atomic_load_n(&elw->tail, __ATOMIC_ACQUIRE) ==
+	       ELW_RING_SIZE) {
+		if (__atomic_load_n(&elw->stopping, __ATOMIC_ACQUIRE))
+			return -1;
+		elw_signal(elw->ready_fd);
+		nanosleep(&backoff, NULL);
+	}
+
+	ready = &elw->ring[elw->head & (ELW_RING_SIZE - 1)];
+	ready->key = key;
+	ready->time = *time;
+	__atomic_store_n(&elw->head, elw->head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static void *
+elw_input_thread(void *data)
+{
+	struct ela_wayland *elw = data;
+	struct epoll_event events[16];
+	struct timeval now;
+	int i, n;
+
+	for (;;) {
+		n = epoll_wait(elw->epoll_fd, events, ARRAY_LENGTH(events), -1);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			break;
+
+		/* same clock as weston_compositor_get_time() */
+		gettimeofday(&now, NULL);
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.u64 == ELW_QUIT_KEY)
+				return NULL;
+
+			if (elw_push_ready(elw, events[i].data.u64, &now) < 0)
+				return NULL;
+		}
+
+		/* The main loop would never see the entries, and the fds
+		 * are not rearmed without it: nothing left to watch. */
+		if (elw_signal(elw->ready_fd) < 0)
+			break;
+	}
+
+	return NULL;
+}
+
+static int
+elw_handle_ready(int fd, uint32_t mask, void *data)
+{
+	struct ela_wayland *elw = data;
+	struct ela_event_source *source;
+	struct elw_ready ready;
+	uint32_t head, slot, generation, flags;
+	uint64_t count;
+
+	if (read(fd, &count, sizeof count) != sizeof count)
+		return 0;
+
+	head = __atomic_load_n(&elw->head, __ATOMIC_ACQUIRE);
+	while (elw->tail != head) {
+		ready = elw->ring[elw->tail & (ELW_RING_SIZE - 1)];
+		__atomic_store_n(&elw->tail, elw->tail + 1, __ATOMIC_RELEASE);
+
+		slot = ready.key & 0xffffffff;
+		generation = ready.key >> 32;
+		source = elw->slots[slot].source;
+		if (!source || elw->slots[slot].generation != generation)
+			continue;
+
+		flags = ELA_EVENT_READABLE;
+		if (source->flags & ELA_EVENT_ONCE)
+			flags |= ELA_EVENT_ONCE;
+
+		elw->has_event_time = 1;
+		elw->event_time = ready.time;
+		dispatch_event(source, source->fd, flags);
+		elw->has_event_time = 0;
+
+		/* unless the callback removed or freed the source */
+		if (elw->slots[slot].generation == generation)
+			elw_rearm(elw, source);
+	}
+
+	return 1;
+}
+
 static ela_error_t
 elw_source_update_fd(struct ela_wayland *elw,
 		     struct ela_event_source *source)
 {
+	/* watched by the input thread */
+	if (source->slot >= 0) {
+		if ((source->flags & ELA_EVENT_ENABLE) &&
+		    (source->flags & ELA_EVENT_READABLE) &&
+		    !(source->flags & ELA_EVENT_WRITABLE))
+			return 0;
+
+		elw_unwatch(elw, source);
+	}
+
 	/* check fd source */
 	if ((source->flags & ELA_EVENT_ENABLE) &&
 	    (source->flags & (ELA_EVENT_READABLE | ELA_EVENT_WRITABLE))) {
 		uint32_t mask;
 
+		if (!source->fd_source &&
+		    !(source->flags & ELA_EVENT_WRITABLE) &&
+		    elw_watch(elw, source) == 0)
+			return 0;
+
 		mask = 0;
 		if (source->flags & ELA_EVENT_WRITABLE)
 			mask |= WL_EVENT_WRITABLE;
@@ -176,6 +421,9 @@ elw_source_set_fd(struct ela_el *el, struct ela_event_source *source,
 		source->fd_source = NULL;
 	}
 
+	if (source->slot >= 0)
+		elw_unwatch(elw, source);
+
 	if (flags & ELA_EVENT_ONCE)
 		source->flags |= ELA_EVENT_ONCE;
 	else
@@ -238,6 +486,7 @@ elw_source_remove(struct ela_el *el, struct ela_event_source *source)
 	ret = elw_source_update(elw, source);
 
 	assert(source->fd_source == NULL);
+	assert(source->slot < 0);
 	assert(source->timer_source == NULL);
 
 	return ret;
@@ -259,6 +508,7 @@ elw_source_alloc(struct ela_el *el, ela_handler_func *callback,
 	source->fd_source = NULL;
 	source->flags = 0;
 	source->fd = -1;
+	source->slot = -1;
 	source->timeout = 0;
 	source->user_data = user_data;
 	source->callback = callback;
@@ -297,10 +547,36 @@ static void elw_run(struct ela_el *el)
 		wl_event_loop_dispatch(elw->loop, -1);
 }
 
+static void
+elw_stop_input_thread(struct ela_wayland *elw)
+{
+	if (elw->ready_source) {
+		/* epoll_wait() is a cancellation point */
+		__atomic_store_n(&elw->stopping, 1, __ATOMIC_RELEASE);
+		if (elw_signal(elw->quit_fd) < 0)
+			pthread_cancel(elw->thread);
+		pthread_join(elw->thread, NULL);
+		wl_event_source_remove(elw->ready_source);
+		elw->ready_source = NULL;
+	}
+
+	if (elw->epoll_fd >= 0)
+		close(elw->epoll_fd);
+	if (elw->ready_fd >= 0)
+		close(elw->ready_fd);
+	if (elw->quit_fd >= 0)
+		close(elw->quit_fd);
+
+	elw->epoll_fd = -1;
+	elw->ready_fd = -1;
+	elw->quit_fd = -1;
+}
+
 static void elw_close(struct ela_el *el)
 {
 	struct ela_wayland *elw = ela_wayland(el);
 
+	elw_stop_input_thread(elw);
 	free(elw);
 }
 
@@ -332,9 +608,79 @@ ela_wayland_create(struct wl_event_loop *loop)
 	elw->loop = loop;
 	elw->run = 1;
 
+	elw->epoll_fd = -1;
+	elw->ready_fd = -1;
+	elw->quit_fd = -1;
+	elw->stopping = 0;
+	elw->ready_source = NULL;
+	elw->head = 0;
+	elw->tail = 0;
+	elw->has_event_time = 0;
+	memset(elw->slots, 0, sizeof elw->slots);
+
 	return &elw->base;
 }
 
+/*
+ * Watch the readable fd sources added from now on with a dedicated
+ * thread, see struct elw_ready. Returns 0 on success.
+ */
+int
+ela_wayland_start_input_thread(struct ela_el *el)
+{
+	struct ela_wayland *elw = ela_wayland(el);
+	struct epoll_event ev;
+
+	elw->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	elw->ready_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	elw->quit_fd = eventfd(0, EFD_CLOEXEC);
+	if (elw->epoll_fd < 0 || elw->ready_fd < 0 || elw->quit_fd < 0)
+		goto err;
+
+	ev.events = EPOLLIN;
+	ev.data.u64 = ELW_QUIT_KEY;
+	if (epoll_ctl(elw->epoll_fd, EPOLL_CTL_ADD, elw->quit_fd, &ev) < 0)
+		goto err;
+
+	elw->ready_source = wl_event_loop_add_fd(elw->loop, elw->ready_fd,
+						 WL_EVENT_READABLE,
+						 elw_handle_ready, elw);
+	if (!elw->ready_source)
+		goto err;
+
+	if (pthread_create(&elw->thread, NULL, elw_input_thread, elw) != 0) {
+		wl_event_source_remove(elw->ready_source);
+		elw->ready_source = NULL;
+		goto err;
+	}
+
+	return 0;
+
+err:
+	elw_stop_input_thread(elw);
+	return -1;
+}
+
+/*
+ * Get the time at which the fd of the source being dispatched became
+ * readable, in milliseconds. Data read from the fd during the dispatch
+ * may have arrived later. Returns 0 on success, or -1 outside of the
+ * dispatch of a source watched by the input thread.
+ */
+int
+ela_wayland_get_event_time(struct ela_el *el, uint32_t *msec)
+{
+	struct ela_wayland *elw = ela_wayland(el);
+
+	if (!elw->has_event_time)
+		return -1;
+
+	*msec = elw->event_time.tv_sec * 1000 +
+		elw->event_time.tv_usec / 1000;
+
+	return 0;
+}
+
 static struct ela_el *
 elw_create(void)
 {
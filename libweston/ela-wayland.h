@@ -1,8 +1,11 @@
 #ifndef ELA_WAYLAND_H_
 #define ELA_WAYLAND_H_
 
+#include <stdint.h>
 #include <wayland-server.h>
 
 struct ela_el *ela_wayland_create(struct wl_event_loop *loop);
+int ela_wayland_start_input_thread(struct ela_el *el);
+int ela_wayland_get_event_time(struct ela_el *el, uint32_t *msec);
 
 #endif
@@ -1494,7 +1494,7 @@ weston_pointer_move_to(struct weston_pointer *pointer,
 		weston_view_set_position(pointer->sprite,
 					 ix - pointer->hotspot_x,
 					 iy - pointer->hotspot_y);
-		weston_view_schedule_repaint(pointer->sprite);
+		weston_view_schedule_cursor_update(pointer->sprite);
 	}
 
 	pointer->grab->interface->focus(pointer->grab);
@@ -1555,6 +1555,92 @@ weston_pointer_handle_output_destroy(struct wl_listener *listener, void *data)
 	weston_pointer_move_to(pointer, fx, fy);
 }
 
+/** Deliver the motion coalesced by notify_motion()
+ *
+ * \param pointer The pointer.
+ *
+ * Sends the motion accumulated since the last delivery through the
+ * pointer grab, followed by the frame events it held back. Called from
+ * the repaint loop, and before events that must see the pointer at its
+ * current position.
+ */
+WL_EXPORT void
+weston_pointer_flush_motion(struct weston_pointer *pointer)
+{
+	struct weston_pointer_motion_event event;
+
+	if (!pointer->motion_pending)
+		return;
+
+	event = pointer->pending_motion;
+	pointer->motion_pending = false;
+	pointer->grab->interface->motion(pointer->grab,
+					 pointer->pending_motion_time, &event);
+
+	if (pointer->frame_pending) {
+		pointer->frame_pending = false;
+		pointer->grab->interface->frame(pointer->grab);
+	}
+}
+
+static void
+pointer_schedule_motion_flush(struct weston_pointer *pointer)
+{
+	struct weston_compositor *ec = pointer->seat->compositor;
+	struct weston_output *output;
+	int x = wl_fixed_to_int(pointer->x);
+	int y = wl_fixed_to_int(pointer->y);
+
+	wl_list_for_each(output, &ec->output_list, link) {
+		if (pixman_region32_contains_point(&output->region,
+						   x, y, NULL)) {
+			weston_output_schedule_cursor_update(output);
+			return;
+		}
+	}
+
+	/* No output paces the pointer. */
+	weston_pointer_flush_motion(pointer);
+}
+
+/* Accumulate motion until the next output frame. Relative deltas add up
+ * exactly, so relative pointer clients see the same total motion. */
+static void
+pointer_coalesce_motion(struct weston_pointer *pointer, uint32_t time,
+			struct weston_pointer_motion_event *event)
+{
+	struct weston_pointer_motion_event *pending = &pointer->pending_motion;
+
+	if (pointer->motion_pending && pending->mask != event->mask)
+		weston_pointer_flush_motion(pointer);
+
+	pointer->pending_motion_time = time;
+
+	if (!pointer->motion_pending) {
+		*pending = *event;
+		pointer->motion_pending = true;
+		pointer_schedule_motion_flush(pointer);
+		return;
+	}
+
+	if (event->mask & WESTON_POINTER_MOTION_ABS) {
+		pending->x = event->x;
+		pending->y = event->y;
+	}
+
+	if (event->mask & WESTON_POINTER_MOTION_REL) {
+		pending->dx += event->dx;
+		pending->dy += event->dy;
+	}
+
+	if (event->mask & WESTON_POINTER_MOTION_REL_UNACCEL) {
+		pending->dx_unaccel += event->dx_unaccel;
+		pending->dy_unaccel += event->dy_unaccel;
+	}
+
+	pending->time_usec = event->time_usec;
+}
+
 WL_EXPORT void
 notify_motion(struct weston_seat *seat,
 	      uint32_t time,
@@ -1564,7 +1650,11 @@ notify_motion(struct weston_seat *seat,
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
 	weston_compositor_wake(ec);
-	pointer->grab->interface->motion(pointer->grab, time, event);
+
+	if (ec->coalesce_pointer_motion)
+		pointer_coalesce_motion(pointer, time, event);
+	else
+		pointer->grab->interface->motion(pointer->grab, time, event);
 }
 
 static void
@@ -1619,7 +1709,10 @@ notify_motion_absolute(struct weston_seat *seat,
 		.y = y,
 	};
 
-	pointer->grab->interface->motion(pointer->grab, time, &event);
+	if (ec->coalesce_pointer_motion)
+		pointer_coalesce_motion(pointer, time, &event);
+	else
+		pointer->grab->interface->motion(pointer->grab, time, &event);
 }
 
 static unsigned int
@@ -1658,6 +1751,8 @@ notify_button(struct weston_seat *seat, uint32_t time, int32_t button,
 	struct weston_compositor *compositor = seat->compositor;
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
+	weston_pointer_flush_motion(pointer);
+
 	if (state == WL_POINTER_BUTTON_STATE_PRESSED) {
 		weston_compositor_idle_inhibit(compositor);
 		if (pointer->button_count == 0) {
@@ -1690,6 +1785,7 @@ notify_axis(struct weston_seat *seat, uint32_t time,
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
 	weston_compositor_wake(compositor);
+	weston_pointer_flush_motion(pointer);
 
 	if (weston_compositor_run_axis_binding(compositor, pointer,
 					       time, event))
@@ -1705,6 +1801,7 @@ notify_axis_source(struct weston_seat *seat, uint32_t source)
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
 	weston_compositor_wake(compositor);
+	weston_pointer_flush_motion(pointer);
 
 	pointer->grab->interface->axis_source(pointer->grab, source);
 }
@@ -1717,6 +1814,12 @@ notify_pointer_frame(struct weston_seat *seat)
 
 	weston_compositor_wake(compositor);
 
+	/* Hold the frame back with the motion it ends. */
+	if (pointer->motion_pending) {
+		pointer->frame_pending = true;
+		return;
+	}
+
 	pointer->grab->interface->frame(pointer->grab);
 }
 
@@ -1972,10 +2075,15 @@ notify_key(struct weston_seat *seat, uint32_t time, uint32_t key,
 {
 	struct weston_compositor *compositor = seat->compositor;
 	struct weston_keyboard *keyboard = weston_seat_get_keyboard(seat);
+	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 	struct weston_keyboard_grab *grab = keyboard->grab;
 	uint32_t *k, *end;
 	bool was_pressed = false;
 
+	/* Key bindings act on the current pointer position. */
+	if (pointer)
+		weston_pointer_flush_motion(pointer);
+
 	if (state == WL_KEYBOARD_KEY_STATE_PRESSED) {
 		weston_compositor_idle_inhibit(compositor);
 	} else {
@@ -2035,6 +2143,8 @@ notify_pointer_focus(struct weston_seat *seat, struct weston_output *output,
 {
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
+	weston_pointer_flush_motion(pointer);
+
 	if (output) {
 		weston_pointer_move_to(pointer,
 				       wl_fixed_from_double(x),
@@ -2289,6 +2399,7 @@ pointer_cursor_surface_committed(struct weston_surface *es,
 	weston_view_set_position(pointer->sprite, x, y);
 
 	empty_region(&es->pending.input);
+	es->pending.input_changed = true;
 	empty_region(&es->input);
 
 	if (!weston_surface_is_mapped(es)) {
@@ -344,7 +344,7 @@ feed_key(struct input_lh_seat *input_seat, uint32_t usage, uint32_t value)
 	}
 
 	if (code != 0) {
-		uint32_t time = weston_compositor_get_time();
+		uint32_t time = input_lh_get_time(input_seat->input);
 
 		notify_key(seat, time, code, state ?
 			   WL_KEYBOARD_KEY_STATE_PRESSED :
@@ -620,7 +620,7 @@ keyboard_handle_value(struct lhs_usage_extractor *ue,
 		container_of(ue, struct wlh_device, usage_extractor);
 	uint32_t time;
 
-	time = weston_compositor_get_time();
+	time = input_lh_get_time(device->input);
 
 	wlh_device_flush_pending_events(device, time);
 	feed_key(device->seat, usage, value);
@@ -810,7 +810,7 @@ pointer_item_input(struct lh_item_listener *listener,
 	seat = device->seat;
 	item = pi->item;
 
-	time = weston_compositor_get_time();
+	time = input_lh_get_time(device->input);
 
 	switch (item->usage) {
 	case LHID_UT(DESKTOP, X):
@@ -864,7 +864,7 @@ pointer_report_input(struct lh_report_listener *listener,
 		container_of(listener, struct wlh_pointer_report, listener);
 	uint32_t time;
 
-	time = weston_compositor_get_time();
+	time = input_lh_get_time(pr->device->input);
 
 	wlh_device_flush_pending_events(pr->device, time);
 }
@@ -1409,6 +1409,10 @@ input_lh_init(struct input_lh *input, struct weston_compositor *c)
 	loop = wl_display_get_event_loop(c->wl_display);
 	input->loop = ela_wayland_create(loop);
 
+	if (ela_wayland_start_input_thread(input->loop) < 0)
+		weston_log("failed to start input thread, "
+			   "reading devices on the main loop\n");
+
 	wl_signal_init(&input->destroy_signal);
 	wl_list_init(&input->device_list);
 
@@ -1466,6 +1470,23 @@ input_lh_shutdown(struct input_lh *input)
 	}
 }
 
+/** Get the time of the input event being processed
+ *
+ * This is the time its device became readable, taken by the input thread,
+ * or the current time when the device is read on the main loop. Reports
+ * read together from a device share the time of the first one.
+ */
+uint32_t
+input_lh_get_time(struct input_lh *input)
+{
+	uint32_t time;
+
+	if (ela_wayland_get_event_time(input->loop, &time) == 0)
+		return time;
+
+	return weston_compositor_get_time();
+}
+
 static int
 dispatch_fbxevent(int fd, uint32_t mask, void *data)
 {
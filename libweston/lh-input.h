@@ -57,6 +57,7 @@ struct input_lh_seat *input_lh_seat(struct weston_seat *seat);
 void input_lh_enable_pointer(struct input_lh *input, int enable);
 void input_lh_enable_gamepad(struct input_lh *input, int enable);
 void input_lh_shutdown(struct input_lh *input);
+uint32_t input_lh_get_time(struct input_lh *input);
 
 struct hid_device *hid_device_new(struct input_lh *input,
 				  struct input_lh_device *device);
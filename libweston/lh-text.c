@@ -50,7 +50,7 @@ void fbx_text_inject(struct fbx_text_context *ft, int code)
 		return;
 
 	fbx_text_send_unicode(ft->target->resource,
-			weston_compositor_get_time(), code);
+			input_lh_get_time(ft->input), code);
 }
 
 static void
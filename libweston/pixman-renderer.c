@@ -31,6 +31,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "pixman-renderer.h"
 #include "shared/helpers.h"
@@ -47,6 +48,7 @@ struct pixman_surface_state {
 	struct weston_surface *surface;
 
 	pixman_image_t *image;
+	pixman_color_t solid_color;
 	struct weston_buffer_reference buffer_ref;
 	struct wl_shm_pool *shm_buffer_pool;
 
@@ -54,6 +56,27 @@ struct pixman_surface_state {
 	struct wl_listener renderer_destroy_listener;
 };
 
+/* Edge length of the square tiles the output damage is split into when
+ * rendering with worker threads. */
+#define PIXMAN_TILE_SIZE 256
+
+struct pixman_tile_job {
+	struct weston_output *output;
+	pixman_region32_t *damage; /* in global coordinates */
+	pixman_box32_t *tiles;
+	int n_tiles;
+	int tiles_alloc;
+	int next_tile;
+	int busy;
+	uint32_t serial;
+};
+
+struct pixman_render_worker {
+	struct pixman_renderer *renderer;
+	pthread_t thread;
+	struct weston_region_arena region_arena;
+};
+
 struct pixman_renderer {
 	struct weston_renderer base;
 
@@ -62,6 +85,23 @@ struct pixman_renderer {
 	struct weston_binding *debug_binding;
 
 	struct wl_signal destroy_signal;
+
+	/* Region temporaries of the compositor thread, the workers have
+	 * their own */
+	struct weston_region_arena region_arena;
+
+	/* Tiled rendering worker pool, protected by mutex */
+	int n_threads;
+	struct pixman_render_worker *workers;
+	pthread_mutex_t mutex;
+	pthread_cond_t work_cond;
+	pthread_cond_t done_cond;
+	bool quit;
+	struct pixman_tile_job job;
+};
+
+static const pixman_color_t debug_red = {
+	0x3fff, 0x0000, 0x0000, 0x3fff
 };
 
 static inline struct pixman_output_state *
@@ -207,18 +247,23 @@ static void
 region_intersect_only_translation(pixman_region32_t *result_global,
 				  pixman_region32_t *global,
 				  pixman_region32_t *surf,
-				  struct weston_view *view)
+				  struct weston_view *view,
+				  struct weston_region_arena *arena)
 {
+	struct weston_frame_region surf_global;
 	float view_x, view_y;
 
 	assert(view_transformation_is_translation(view));
 
 	/* Convert from surface to global coordinates */
-	pixman_region32_copy(result_global, surf);
+	weston_frame_region_init(arena, &surf_global);
+	pixman_region32_copy(&surf_global.region, surf);
 	weston_view_to_global_float(view, 0, 0, &view_x, &view_y);
-	pixman_region32_translate(result_global, (int)view_x, (int)view_y);
+	pixman_region32_translate(&surf_global.region,
+				  (int)view_x, (int)view_y);
 
-	pixman_region32_intersect(result_global, result_global, global);
+	pixman_region32_intersect(result_global, &surf_global.region, global);
+	weston_frame_region_fini(arena, &surf_global);
 }
 
 static void
@@ -316,10 +361,36 @@ composite_clipped(pixman_image_t *src,
 	}
 }
 
+/** Create a private alias of an image sharing the same pixels
+ *
+ * Worker threads must not change the transform, filter or clip of images
+ * shared with other threads, so they composite through aliases instead.
+ */
+static pixman_image_t *
+image_create_alias(pixman_image_t *image)
+{
+	return pixman_image_create_bits_no_clear(pixman_image_get_format(image),
+						 pixman_image_get_width(image),
+						 pixman_image_get_height(image),
+						 pixman_image_get_data(image),
+						 pixman_image_get_stride(image));
+}
+
+static pixman_image_t *
+surface_state_create_source_alias(struct pixman_surface_state *ps)
+{
+	if (!pixman_image_get_data(ps->image))
+		return pixman_image_create_solid_fill(&ps->solid_color);
+
+	return image_create_alias(ps->image);
+}
+
 /** Paint an intersected region
  *
  * \param ev The view to be painted.
  * \param output The output being painted.
+ * \param target The image to paint into, either the output shadow image
+ *               or a worker thread private alias of it.
  * \param repaint_output The region to be painted in output coordinates.
  * \param source_clip The region of the source image to use, in source image
  *                    coordinates. If NULL, use the whole source image.
@@ -327,6 +398,7 @@ composite_clipped(pixman_image_t *src,
  */
 static void
 repaint_region(struct weston_view *ev, struct weston_output *output,
+	       pixman_image_t *target,
 	       pixman_region32_t *repaint_output,
 	       pixman_region32_t *source_clip,
 	       pixman_op_t pixman_op)
@@ -336,13 +408,15 @@ repaint_region(struct weston_view *ev, struct weston_output *output,
 	struct pixman_surface_state *ps = get_surface_state(ev->surface);
 	struct pixman_output_state *po = get_output_state(output);
 	struct weston_buffer_viewport *vp = &ev->surface->buffer_viewport;
+	bool in_worker = target != po->shadow_image;
 	pixman_transform_t transform;
 	pixman_filter_t filter;
+	pixman_image_t *src_image;
 	pixman_image_t *mask_image;
 	pixman_color_t mask = { 0, };
 
 	/* Clip rendering to the damaged output region */
-	pixman_image_set_clip_region32(po->shadow_image, repaint_output);
+	pixman_image_set_clip_region32(target, repaint_output);
 
 	pixman_renderer_compute_transform(&transform, ev, output);
 
@@ -361,12 +435,19 @@ repaint_region(struct weston_view *ev, struct weston_output *output,
 		mask_image = NULL;
 	}
 
+	if (in_worker)
+		src_image = surface_state_create_source_alias(ps);
+	else
+		src_image = pixman_image_ref(ps->image);
+
 	if (source_clip)
-		composite_clipped(ps->image, mask_image, po->shadow_image,
+		composite_clipped(src_image, mask_image, target,
 				  &transform, filter, source_clip);
 	else
-		composite_whole(pixman_op, ps->image, mask_image,
-				po->shadow_image, &transform, filter);
+		composite_whole(pixman_op, src_image, mask_image,
+				target, &transform, filter);
+
+	pixman_image_unref(src_image);
 
 	if (mask_image)
 		pixman_image_unref(mask_image);
@@ -374,77 +455,98 @@ repaint_region(struct weston_view *ev, struct weston_output *output,
 	if (ps->buffer_ref.buffer)
 		wl_shm_buffer_end_access(ps->buffer_ref.buffer->shm_buffer);
 
-	if (pr->repaint_debug)
+	if (pr->repaint_debug) {
+		pixman_image_t *debug_image;
+
+		if (in_worker)
+			debug_image = pixman_image_create_solid_fill(&debug_red);
+		else
+			debug_image = pixman_image_ref(pr->debug_color);
+
 		pixman_image_composite32(PIXMAN_OP_OVER,
-					 pr->debug_color, /* src */
+					 debug_image, /* src */
 					 NULL /* mask */,
-					 po->shadow_image, /* dest */
+					 target, /* dest */
 					 0, 0, /* src_x, src_y */
 					 0, 0, /* mask_x, mask_y */
 					 0, 0, /* dest_x, dest_y */
-					 pixman_image_get_width (po->shadow_image), /* width */
-					 pixman_image_get_height (po->shadow_image) /* height */);
+					 pixman_image_get_width (target), /* width */
+					 pixman_image_get_height (target) /* height */);
+
+		pixman_image_unref(debug_image);
+	}
 
-	pixman_image_set_clip_region32 (po->shadow_image, NULL);
+	pixman_image_set_clip_region32 (target, NULL);
 }
 
 static void
 draw_view_translated(struct weston_view *view, struct weston_output *output,
-		     pixman_region32_t *repaint_global)
+		     pixman_image_t *target,
+		     pixman_region32_t *repaint_global,
+		     struct weston_region_arena *arena)
 {
 	struct weston_surface *surface = view->surface;
+	pixman_region32_t surface_rect;
 	/* non-opaque region in surface coordinates: */
-	pixman_region32_t surface_blend;
+	struct weston_frame_region surface_blend;
 	/* region to be painted in output coordinates: */
-	pixman_region32_t repaint_output;
+	struct weston_frame_region repaint_output;
 
-	pixman_region32_init(&repaint_output);
+	weston_frame_region_init(arena, &repaint_output);
+	weston_frame_region_init(arena, &surface_blend);
 
 	/* Blended region is whole surface minus opaque region,
 	 * unless surface alpha forces us to blend all.
 	 */
-	pixman_region32_init_rect(&surface_blend, 0, 0,
+	pixman_region32_init_rect(&surface_rect, 0, 0,
 				  surface->width, surface->height);
 
 	if (!(view->alpha < 1.0)) {
-		pixman_region32_subtract(&surface_blend, &surface_blend,
+		pixman_region32_subtract(&surface_blend.region, &surface_rect,
 					 &surface->opaque);
 
 		if (pixman_region32_not_empty(&surface->opaque)) {
-			region_intersect_only_translation(&repaint_output,
+			region_intersect_only_translation(&repaint_output.region,
 							  repaint_global,
 							  &surface->opaque,
-							  view);
-			region_global_to_output(output, &repaint_output);
+							  view, arena);
+			region_global_to_output(output, &repaint_output.region);
 
-			repaint_region(view, output, &repaint_output, NULL,
-				       PIXMAN_OP_SRC);
+			repaint_region(view, output, target,
+				       &repaint_output.region,
+				       NULL, PIXMAN_OP_SRC);
 		}
+	} else {
+		pixman_region32_copy(&surface_blend.region, &surface_rect);
 	}
 
-	if (pixman_region32_not_empty(&surface_blend)) {
-		region_intersect_only_translation(&repaint_output,
+	if (pixman_region32_not_empty(&surface_blend.region)) {
+		region_intersect_only_translation(&repaint_output.region,
 						  repaint_global,
-						  &surface_blend, view);
-		region_global_to_output(output, &repaint_output);
+						  &surface_blend.region,
+						  view, arena);
+		region_global_to_output(output, &repaint_output.region);
 
-		repaint_region(view, output, &repaint_output, NULL,
-			       PIXMAN_OP_OVER);
+		repaint_region(view, output, target, &repaint_output.region,
+			       NULL, PIXMAN_OP_OVER);
 	}
 
-	pixman_region32_fini(&surface_blend);
-	pixman_region32_fini(&repaint_output);
+	pixman_region32_fini(&surface_rect);
+	weston_frame_region_fini(arena, &surface_blend);
+	weston_frame_region_fini(arena, &repaint_output);
 }
 
 static void
 draw_view_source_clipped(struct weston_view *view,
 			 struct weston_output *output,
-			 pixman_region32_t *repaint_global)
+			 pixman_image_t *target,
+			 pixman_region32_t *repaint_global,
+			 struct weston_region_arena *arena)
 {
 	struct weston_surface *surface = view->surface;
 	pixman_region32_t surf_region;
 	pixman_region32_t buffer_region;
-	pixman_region32_t repaint_output;
+	struct weston_frame_region repaint_output;
 
 	/* Do not bother separating the opaque region from non-opaque.
 	 * Source clipping requires PIXMAN_OP_OVER in all cases, so painting
@@ -460,36 +562,41 @@ draw_view_source_clipped(struct weston_view *view,
 	pixman_region32_init(&buffer_region);
 	weston_surface_to_buffer_region(surface, &surf_region, &buffer_region);
 
-	pixman_region32_init(&repaint_output);
-	pixman_region32_copy(&repaint_output, repaint_global);
-	region_global_to_output(output, &repaint_output);
+	weston_frame_region_init(arena, &repaint_output);
+	pixman_region32_copy(&repaint_output.region, repaint_global);
+	region_global_to_output(output, &repaint_output.region);
 
-	repaint_region(view, output, &repaint_output, &buffer_region,
-		       PIXMAN_OP_OVER);
+	repaint_region(view, output, target, &repaint_output.region,
+		       &buffer_region, PIXMAN_OP_OVER);
 
-	pixman_region32_fini(&repaint_output);
+	weston_frame_region_fini(arena, &repaint_output);
 	pixman_region32_fini(&buffer_region);
 	pixman_region32_fini(&surf_region);
 }
 
 static void
 draw_view(struct weston_view *ev, struct weston_output *output,
-	  pixman_region32_t *damage) /* in global coordinates */
+	  pixman_image_t *target,
+	  pixman_region32_t *damage, /* in global coordinates */
+	  struct weston_region_arena *arena)
 {
 	struct pixman_surface_state *ps = get_surface_state(ev->surface);
 	/* repaint bounding region in global coordinates: */
-	pixman_region32_t repaint;
+	struct weston_frame_region repaint;
+	struct weston_frame_region view_damage;
 
 	/* No buffer attached */
 	if (!ps->image)
 		return;
 
-	pixman_region32_init(&repaint);
-	pixman_region32_intersect(&repaint,
+	weston_frame_region_init(arena, &view_damage);
+	weston_frame_region_init(arena, &repaint);
+	pixman_region32_intersect(&view_damage.region,
 				  &ev->transform.boundingbox, damage);
-	pixman_region32_subtract(&repaint, &repaint, &ev->clip);
+	pixman_region32_subtract(&repaint.region, &view_damage.region,
+				 &ev->clip);
 
-	if (!pixman_region32_not_empty(&repaint))
+	if (!pixman_region32_not_empty(&repaint.region))
 		goto out;
 
 	if (view_transformation_is_translation(ev)) {
@@ -500,7 +607,8 @@ draw_view(struct weston_view *ev, struct weston_output *output,
 		 * Also the boundingbox is accurate rather than an
 		 * approximation.
 		 */
-		draw_view_translated(ev, output, &repaint);
+		draw_view_translated(ev, output, target, &repaint.region,
+				     arena);
 	} else {
 		/* The complex case: the view transformation does not allow
 		 * converting opaque etc. regions into global coordinate space.
@@ -509,48 +617,224 @@ draw_view(struct weston_view *ev, struct weston_output *output,
 		 * to be used whole. Source clipping does not work with
 		 * PIXMAN_OP_SRC.
 		 */
-		draw_view_source_clipped(ev, output, &repaint);
+		draw_view_source_clipped(ev, output, target, &repaint.region,
+					 arena);
 	}
 
 out:
-	pixman_region32_fini(&repaint);
+	weston_frame_region_fini(arena, &repaint);
+	weston_frame_region_fini(arena, &view_damage);
 }
 static void
-repaint_surfaces(struct weston_output *output, pixman_region32_t *damage)
+repaint_surfaces(struct weston_output *output, pixman_image_t *target,
+		 pixman_region32_t *damage, struct weston_region_arena *arena)
 {
 	struct weston_compositor *compositor = output->compositor;
 	struct weston_view *view;
 
 	wl_list_for_each_reverse(view, &compositor->view_list, link)
 		if (view->plane == &compositor->primary_plane)
-			draw_view(view, output, damage);
+			draw_view(view, output, target, damage, arena);
 }
 
 static void
-copy_to_hw_buffer(struct weston_output *output, pixman_region32_t *region)
+copy_to_hw_buffer(struct weston_output *output, pixman_image_t *src,
+		  pixman_image_t *dest, pixman_region32_t *region,
+		  struct weston_region_arena *arena)
 {
-	struct pixman_output_state *po = get_output_state(output);
-	pixman_region32_t output_region;
+	struct weston_frame_region output_region;
 
-	pixman_region32_init(&output_region);
-	pixman_region32_copy(&output_region, region);
+	weston_frame_region_init(arena, &output_region);
+	pixman_region32_copy(&output_region.region, region);
 
-	region_global_to_output(output, &output_region);
+	region_global_to_output(output, &output_region.region);
 
-	pixman_image_set_clip_region32 (po->hw_buffer, &output_region);
-	pixman_region32_fini(&output_region);
+	pixman_image_set_clip_region32 (dest, &output_region.region);
+	weston_frame_region_fini(arena, &output_region);
 
 	pixman_image_composite32(PIXMAN_OP_SRC,
-				 po->shadow_image, /* src */
+				 src, /* src */
 				 NULL /* mask */,
-				 po->hw_buffer, /* dest */
+				 dest, /* dest */
 				 0, 0, /* src_x, src_y */
 				 0, 0, /* mask_x, mask_y */
 				 0, 0, /* dest_x, dest_y */
-				 pixman_image_get_width (po->hw_buffer), /* width */
-				 pixman_image_get_height (po->hw_buffer) /* height */);
+				 pixman_image_get_width (dest), /* width */
+				 pixman_image_get_height (dest) /* height */);
+
+	pixman_image_set_clip_region32 (dest, NULL);
+}
+
+static void
+render_tile(struct weston_output *output, pixman_region32_t *damage,
+	    pixman_box32_t *tile, struct weston_region_arena *arena)
+{
+	struct pixman_output_state *po = get_output_state(output);
+	struct weston_frame_region tile_damage;
+	pixman_image_t *shadow;
+	pixman_image_t *hw;
+
+	weston_frame_region_init(arena, &tile_damage);
+	pixman_region32_intersect_rect(&tile_damage.region, damage,
+				       tile->x1, tile->y1,
+				       tile->x2 - tile->x1,
+				       tile->y2 - tile->y1);
+
+	if (pixman_region32_not_empty(&tile_damage.region)) {
+		shadow = image_create_alias(po->shadow_image);
+		hw = image_create_alias(po->hw_buffer);
+
+		repaint_surfaces(output, shadow, &tile_damage.region, arena);
+		copy_to_hw_buffer(output, shadow, hw, &tile_damage.region,
+				  arena);
+
+		pixman_image_unref(hw);
+		pixman_image_unref(shadow);
+	}
+
+	weston_frame_region_fini(arena, &tile_damage);
+}
+
+/* Render tiles of the current job until none is left. Called with the
+ * renderer mutex held, which is dropped while rendering a tile. */
+static void
+tile_job_run(struct pixman_renderer *pr, struct weston_region_arena *arena)
+{
+	struct pixman_tile_job *job = &pr->job;
+	pixman_box32_t tile;
+
+	while (job->next_tile < job->n_tiles) {
+		tile = job->tiles[job->next_tile++];
+		job->busy++;
+		pthread_mutex_unlock(&pr->mutex);
+
+		render_tile(job->output, job->damage, &tile, arena);
+
+		pthread_mutex_lock(&pr->mutex);
+		job->busy--;
+	}
+
+	if (job->busy == 0)
+		pthread_cond_signal(&pr->done_cond);
+}
+
+static void *
+tile_worker_thread(void *data)
+{
+	struct pixman_render_worker *worker = data;
+	struct pixman_renderer *pr = worker->renderer;
+	uint32_t serial = 0;
+
+	pthread_mutex_lock(&pr->mutex);
+
+	while (!pr->quit) {
+		if (pr->job.serial == serial) {
+			pthread_cond_wait(&pr->work_cond, &pr->mutex);
+			continue;
+		}
+
+		serial = pr->job.serial;
+		tile_job_run(pr, &worker->region_arena);
+	}
+
+	pthread_mutex_unlock(&pr->mutex);
+
+	return NULL;
+}
+
+static int
+tile_job_split(struct pixman_tile_job *job, pixman_region32_t *damage)
+{
+	pixman_box32_t *extents = pixman_region32_extents(damage);
+	pixman_box32_t *tiles;
+	int x, y, n;
+
+	n = ((extents->x2 - extents->x1 + PIXMAN_TILE_SIZE - 1) /
+	     PIXMAN_TILE_SIZE) *
+	    ((extents->y2 - extents->y1 + PIXMAN_TILE_SIZE - 1) /
+	     PIXMAN_TILE_SIZE);
+
+	if (n > job->tiles_alloc) {
+		tiles = realloc(job->tiles, n * sizeof *tiles);
+		if (!tiles)
+			return -1;
+
+		job->tiles = tiles;
+		job->tiles_alloc = n;
+	}
+
+	job->n_tiles = 0;
+	for (y = extents->y1; y < extents->y2; y += PIXMAN_TILE_SIZE) {
+		for (x = extents->x1; x < extents->x2; x += PIXMAN_TILE_SIZE) {
+			pixman_box32_t *tile = &job->tiles[job->n_tiles];
+
+			tile->x1 = x;
+			tile->y1 = y;
+			tile->x2 = MIN(x + PIXMAN_TILE_SIZE, extents->x2);
+			tile->y2 = MIN(y + PIXMAN_TILE_SIZE, extents->y2);
 
-	pixman_image_set_clip_region32 (po->hw_buffer, NULL);
+			if (pixman_region32_contains_rectangle(damage, tile) !=
+			    PIXMAN_REGION_OUT)
+				job->n_tiles++;
+		}
+	}
+
+	return 0;
+}
+
+static bool
+repaint_output_tiled(struct weston_output *output,
+		     pixman_region32_t *output_damage)
+{
+	struct weston_compositor *compositor = output->compositor;
+	struct pixman_renderer *pr = get_renderer(compositor);
+	struct pixman_tile_job *job = &pr->job;
+	struct weston_view *view;
+	int i;
+
+	/* With zoom, tiles are not mapped exactly to output pixels, so
+	 * neighbouring tiles could blend over the same pixels. */
+	if (pr->n_threads == 0 || output->zoom.active)
+		return false;
+
+	if (!pixman_region32_not_empty(output_damage))
+		return true;
+
+	/* Surface state is lazily created, do it before the workers look
+	 * at it. */
+	wl_list_for_each(view, &compositor->view_list, link)
+		if (view->plane == &compositor->primary_plane)
+			get_surface_state(view->surface);
+
+	pthread_mutex_lock(&pr->mutex);
+
+	if (tile_job_split(job, output_damage) < 0) {
+		pthread_mutex_unlock(&pr->mutex);
+		return false;
+	}
+
+	job->output = output;
+	job->damage = output_damage;
+	job->next_tile = 0;
+	job->serial++;
+	pthread_cond_broadcast(&pr->work_cond);
+
+	/* The compositor thread renders tiles too, then waits for the
+	 * workers to finish theirs. */
+	tile_job_run(pr, &pr->region_arena);
+	while (job->busy > 0)
+		pthread_cond_wait(&pr->done_cond, &pr->mutex);
+
+	job->output = NULL;
+	job->damage = NULL;
+
+	for (i = 0; i < pr->n_threads; i++)
+		weston_region_arena_reset(&pr->workers[i].region_arena,
+					  &output->repaint_region_stats);
+
+	pthread_mutex_unlock(&pr->mutex);
+
+	return true;
 }
 
 static void
@@ -558,12 +842,20 @@ pixman_renderer_repaint_output(struct weston_output *output,
 			     pixman_region32_t *output_damage)
 {
 	struct pixman_output_state *po = get_output_state(output);
+	struct pixman_renderer *pr = get_renderer(output->compositor);
 
 	if (!po->hw_buffer)
 		return;
 
-	repaint_surfaces(output, output_damage);
-	copy_to_hw_buffer(output, output_damage);
+	if (!repaint_output_tiled(output, output_damage)) {
+		repaint_surfaces(output, po->shadow_image, output_damage,
+				 &pr->region_arena);
+		copy_to_hw_buffer(output, po->shadow_image, po->hw_buffer,
+				  output_damage, &pr->region_arena);
+	}
+
+	weston_region_arena_reset(&pr->region_arena,
+				  &output->repaint_region_stats);
 
 	pixman_region32_copy(&output->previous_damage, output_damage);
 	wl_signal_emit(&output->frame_signal, output);
@@ -717,6 +1009,7 @@ pixman_renderer_surface_set_color(struct weston_surface *es,
 	color.green = green * 0xffff;
 	color.blue = blue * 0xffff;
 	color.alpha = alpha * 0xffff;
+	ps->solid_color = color;
 
 	if (ps->image) {
 		pixman_image_unref(ps->image);
@@ -726,11 +1019,39 @@ pixman_renderer_surface_set_color(struct weston_surface *es,
 	ps->image = pixman_image_create_solid_fill(&color);
 }
 
+static void
+pixman_renderer_stop_threads(struct pixman_renderer *pr)
+{
+	int i;
+
+	pthread_mutex_lock(&pr->mutex);
+	pr->quit = true;
+	pthread_cond_broadcast(&pr->work_cond);
+	pthread_mutex_unlock(&pr->mutex);
+
+	for (i = 0; i < pr->n_threads; i++) {
+		pthread_join(pr->workers[i].thread, NULL);
+		weston_region_arena_release(&pr->workers[i].region_arena);
+	}
+
+	free(pr->workers);
+	pr->workers = NULL;
+	pr->n_threads = 0;
+	pr->quit = false;
+}
+
 static void
 pixman_renderer_destroy(struct weston_compositor *ec)
 {
 	struct pixman_renderer *pr = get_renderer(ec);
 
+	pixman_renderer_stop_threads(pr);
+	pthread_mutex_destroy(&pr->mutex);
+	pthread_cond_destroy(&pr->work_cond);
+	pthread_cond_destroy(&pr->done_cond);
+	free(pr->job.tiles);
+	weston_region_arena_release(&pr->region_arena);
+
 	wl_signal_emit(&pr->destroy_signal, pr);
 	weston_binding_destroy(pr->debug_binding);
 	free(pr);
@@ -795,11 +1116,7 @@ debug_binding(struct weston_keyboard *keyboard, uint32_t time, uint32_t key,
 	pr->repaint_debug ^= 1;
 
 	if (pr->repaint_debug) {
-		pixman_color_t red = {
-			0x3fff, 0x0000, 0x0000, 0x3fff
-		};
-
-		pr->debug_color = pixman_image_create_solid_fill(&red);
+		pr->debug_color = pixman_image_create_solid_fill(&debug_red);
 	} else {
 		pixman_image_unref(pr->debug_color);
 		weston_compositor_damage_all(ec);
@@ -840,6 +1157,62 @@ pixman_renderer_init(struct weston_compositor *ec)
 
 	wl_signal_init(&renderer->destroy_signal);
 
+	pthread_mutex_init(&renderer->mutex, NULL);
+	pthread_cond_init(&renderer->work_cond, NULL);
+	pthread_cond_init(&renderer->done_cond, NULL);
+
+	weston_region_arena_init(&renderer->region_arena);
+
+	return 0;
+}
+
+/** Set the number of worker threads used for tiled rendering
+ *
+ * \param ec The compositor, using the pixman renderer.
+ * \param count Number of threads rendering alongside the compositor
+ *              thread, 0 to render everything on the compositor thread.
+ * \return 0 on success, -1 if the threads could not be started.
+ *
+ * When enabled, the damage of each output repaint is split into
+ * tiles which are composited in parallel by the workers and the
+ * compositor thread.
+ */
+WL_EXPORT int
+pixman_renderer_set_threads(struct weston_compositor *ec, int count)
+{
+	struct pixman_renderer *pr = get_renderer(ec);
+	int i;
+
+	pixman_renderer_stop_threads(pr);
+
+	if (count <= 0)
+		return 0;
+
+	pr->workers = calloc(count, sizeof *pr->workers);
+	if (!pr->workers)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		pr->workers[i].renderer = pr;
+		weston_region_arena_init(&pr->workers[i].region_arena);
+
+		if (pthread_create(&pr->workers[i].thread, NULL,
+				   tile_worker_thread, &pr->workers[i]) != 0) {
+			weston_region_arena_release(
+				&pr->workers[i].region_arena);
+			weston_log("Failed to start pixman render thread\n");
+			break;
+		}
+		pr->n_threads++;
+	}
+
+	if (pr->n_threads < count) {
+		pixman_renderer_stop_threads(pr);
+		return -1;
+	}
+
+	weston_log("Pixman renderer using %d render threads\n", count);
+
 	return 0;
 }
 
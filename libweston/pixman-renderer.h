@@ -38,3 +38,6 @@ pixman_renderer_output_set_buffer(struct weston_output *output, pixman_image_t *
 
 void
 pixman_renderer_output_destroy(struct weston_output *output);
+
+int
+pixman_renderer_set_threads(struct weston_compositor *ec, int count);
@@ -0,0 +1,120 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include "compositor.h"
+
+WL_EXPORT void
+weston_plane_planner_init(struct weston_plane_planner *planner,
+			  struct weston_compositor *ec)
+{
+	weston_plane_init(&planner->occluded_plane, ec, 0, 0);
+	wl_array_init(&planner->candidates);
+	planner->n_candidates = 0;
+	planner->n_occluded = 0;
+}
+
+static void
+planner_clear(struct weston_plane_planner *planner)
+{
+	struct weston_plane_candidate *candidate;
+
+	weston_plane_planner_for_each(candidate, planner)
+		pixman_region32_fini(&candidate->visible);
+
+	planner->candidates.size = 0;
+	planner->n_candidates = 0;
+	planner->n_occluded = 0;
+}
+
+/** Release a planner
+ *
+ * Views still on the occluded plane are left without a plane, until
+ * the next plane assignment.
+ */
+WL_EXPORT void
+weston_plane_planner_release(struct weston_plane_planner *planner)
+{
+	planner_clear(planner);
+	wl_array_release(&planner->candidates);
+	weston_plane_release(&planner->occluded_plane);
+}
+
+/** List the views of the compositor, with their visible regions
+ *
+ * \param planner The planner.
+ *
+ * The view list is walked top to bottom, accumulating the opaque
+ * regions of the views met. Views are listed bottom-most first, in
+ * planner->candidates, which is valid until the next update.
+ */
+WL_EXPORT void
+weston_plane_planner_update(struct weston_plane_planner *planner)
+{
+	struct weston_compositor *ec = planner->occluded_plane.compositor;
+	struct weston_plane_candidate *candidates;
+	struct weston_view *view;
+	pixman_region32_t opaque;
+	int n, i;
+
+	planner_clear(planner);
+
+	n = wl_list_length(&ec->view_list);
+	if (n == 0)
+		return;
+
+	if (!wl_array_add(&planner->candidates, n * sizeof *candidates)) {
+		weston_log("failed to allocate plane candidates\n");
+		planner->candidates.size = 0;
+		return;
+	}
+	candidates = planner->candidates.data;
+
+	pixman_region32_init(&opaque);
+
+	/* Filled from the end, so that the bottom-most view comes first */
+	i = n;
+	wl_list_for_each(view, &ec->view_list, link) {
+		struct weston_plane_candidate *candidate = &candidates[--i];
+
+		candidate->view = view;
+		pixman_region32_init(&candidate->visible);
+		pixman_region32_subtract(&candidate->visible,
+					 &view->transform.boundingbox, &opaque);
+		candidate->occluded =
+			!pixman_region32_not_empty(&candidate->visible);
+
+		if (candidate->occluded)
+			planner->n_occluded++;
+		else
+			pixman_region32_union(&opaque, &opaque,
+					      &view->transform.opaque);
+	}
+
+	pixman_region32_fini(&opaque);
+
+	planner->n_candidates = n;
+}
@@ -0,0 +1,134 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "compositor.h"
+
+/* Storage kept by an arena across repaints, enough for the temporaries
+ * of a few nested calls on every view. */
+#define REGION_ARENA_MAX_STORAGE 64
+
+WL_EXPORT void
+weston_region_arena_init(struct weston_region_arena *arena)
+{
+	wl_array_init(&arena->storage);
+	memset(&arena->stats, 0, sizeof arena->stats);
+}
+
+WL_EXPORT void
+weston_region_arena_release(struct weston_region_arena *arena)
+{
+	pixman_region32_data_t **data;
+
+	wl_array_for_each(data, &arena->storage)
+		free(*data);
+	wl_array_release(&arena->storage);
+}
+
+/** Trim the storage of an arena and collect its statistics
+ *
+ * \param arena The arena, with no region taken from it.
+ * \param stats Where the statistics gathered since the last reset are
+ *              added to, or NULL.
+ */
+WL_EXPORT void
+weston_region_arena_reset(struct weston_region_arena *arena,
+			  struct weston_region_arena_stats *stats)
+{
+	pixman_region32_data_t **data = arena->storage.data;
+	size_t n = arena->storage.size / sizeof *data;
+
+	while (n > REGION_ARENA_MAX_STORAGE)
+		free(data[--n]);
+	arena->storage.size = n * sizeof *data;
+
+	if (stats) {
+		stats->regions += arena->stats.regions;
+		stats->heap_regions += arena->stats.heap_regions;
+		stats->allocs += arena->stats.allocs;
+	}
+	memset(&arena->stats, 0, sizeof arena->stats);
+}
+
+/** Initialize an empty region with storage from an arena
+ *
+ * \param arena The arena lending the storage.
+ * \param frame_region The region, to be released with
+ *                     weston_frame_region_fini() on the same arena.
+ *
+ * frame_region->region is used like any other pixman region, and is
+ * empty. Pixman reuses its storage for the results of operations
+ * writing into it, except when the region is also one of the operands.
+ */
+WL_EXPORT void
+weston_frame_region_init(struct weston_region_arena *arena,
+			 struct weston_frame_region *frame_region)
+{
+	pixman_region32_data_t **data;
+
+	pixman_region32_init(&frame_region->region);
+	frame_region->storage = NULL;
+	arena->stats.regions++;
+
+	if (arena->storage.size == 0)
+		return;
+
+	arena->storage.size -= sizeof *data;
+	data = (pixman_region32_data_t **)
+		((char *) arena->storage.data + arena->storage.size);
+
+	/* An empty region may keep its storage. */
+	(*data)->numRects = 0;
+	frame_region->region.data = *data;
+	frame_region->storage = *data;
+}
+
+WL_EXPORT void
+weston_frame_region_fini(struct weston_region_arena *arena,
+			 struct weston_frame_region *frame_region)
+{
+	pixman_region32_data_t *data = frame_region->region.data;
+	pixman_region32_data_t **slot;
+
+	/* No storage, or the static empty data of pixman */
+	if (!data || data->size == 0)
+		return;
+
+	arena->stats.heap_regions++;
+	if (data != frame_region->storage)
+		arena->stats.allocs++;
+
+	slot = wl_array_add(&arena->storage, sizeof *slot);
+	if (!slot) {
+		pixman_region32_fini(&frame_region->region);
+		return;
+	}
+
+	*slot = data;
+	frame_region->region.data = NULL;
+}
@@ -32,10 +32,17 @@
 #include <linux/input.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
 #include <sys/uio.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "compositor.h"
 #include "shared/helpers.h"
+#include "shared/pixel-convert.h"
 
 #include "wcap/wcap-decode.h"
 
@@ -66,31 +73,15 @@ copy_bgra(uint8_t *dst, uint8_t *src, int height, int stride)
 	memcpy(dst, src, height * stride);
 }
 
-static void
-copy_row_swap_RB(void *vdst, void *vsrc, int bytes)
-{
-	uint32_t *dst = vdst;
-	uint32_t *src = vsrc;
-	uint32_t *end = dst + bytes / 4;
-
-	while (dst < end) {
-		uint32_t v = *src++;
-		/*                    A R G B */
-		uint32_t tmp = v & 0xff00ff00;
-		tmp |= (v >> 16) & 0x000000ff;
-		tmp |= (v << 16) & 0x00ff0000;
-		*dst++ = tmp;
-	}
-}
-
 static void
 copy_rgba_yflip(uint8_t *dst, uint8_t *src, int height, int stride)
 {
+	const struct pixel_convert_funcs *convert = pixel_convert_get();
 	uint8_t *end;
 
 	end = dst + height * stride;
 	while (dst < end) {
-		copy_row_swap_RB(dst, src, stride);
+		convert->swap_rb((uint32_t *) dst, (uint32_t *) src, stride / 4);
 		dst += stride;
 		src -= stride;
 	}
@@ -99,14 +90,10 @@ copy_rgba_yflip(uint8_t *dst, uint8_t *src, int height, int stride)
 static void
 copy_rgba(uint8_t *dst, uint8_t *src, int height, int stride)
 {
-	uint8_t *end;
+	const struct pixel_convert_funcs *convert = pixel_convert_get();
 
-	end = dst + height * stride;
-	while (dst < end) {
-		copy_row_swap_RB(dst, src, stride);
-		dst += stride;
-		src += stride;
-	}
+	convert->swap_rb((uint32_t *) dst, (uint32_t *) src,
+			 height * stride / 4);
 }
 
 static void
@@ -208,14 +195,44 @@ weston_screenshooter_shoot(struct weston_output *output,
 	return 0;
 }
 
+/* Frames queued for the encoder at most. When the encoder falls behind,
+ * frames are skipped and their damage is recorded with the next one. */
+#define RECORDER_MAX_FRAMES 3
+
+struct recorder_frame {
+	struct wl_list link;
+	uint32_t msecs;
+	pixman_box32_t *rects;
+	int nrects, rects_alloc;
+	uint32_t *pixels;	/* the pixels of all rects, one after the other */
+};
+
 struct weston_recorder {
 	struct weston_output *output;
-	uint32_t *frame, *rect;
-	uint32_t *tmpbuf;
-	uint32_t total;
+	enum weston_recorder_compression compression;
+	int width, height;
+	int do_yflip;
 	int fd;
 	struct wl_listener frame_listener;
-	int count, destroying;
+	pixman_region32_t skipped_damage;
+	int destroying;
+
+	/* Owned by the encoder thread until it has been joined */
+	uint32_t *frame;
+	uint32_t *outbuf;
+	void *zbuf;
+	size_t zbuf_size;
+	uint32_t total;
+	int count, skipped;
+	int write_failed;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct wl_list queue;		/* frames to encode */
+	struct wl_list free_list;	/* frames ready to be filled */
+	int n_frames;
+	int quit;
 };
 
 static uint32_t *
@@ -249,6 +266,214 @@ component_delta(uint32_t next, uint32_t prev)
 	return (dr << 16) | (dg << 8) | (db << 0);
 }
 
+static void
+recorder_write(struct weston_recorder *recorder, struct iovec *v, int n)
+{
+	ssize_t len, written;
+	int i;
+
+	if (recorder->write_failed)
+		return;
+
+	for (i = 0, len = 0; i < n; i++)
+		len += v[i].iov_len;
+
+	do {
+		written = writev(recorder->fd, v, n);
+	} while (written < 0 && errno == EINTR);
+
+	if (written != len)
+		recorder->write_failed = 1;
+	else
+		recorder->total += written;
+}
+
+/* Run-length encode the deltas of one frame against the previous one,
+ * updating the previous frame. Returns the end of the encoded data. */
+static uint32_t *
+recorder_encode_frame(struct weston_recorder *recorder,
+		      struct recorder_frame *f)
+{
+	pixman_box32_t *r;
+	int i, j, k, width, height, run, y;
+	uint32_t delta, prev, *d, *s, *p, *rect, next;
+
+	p = recorder->outbuf;
+	rect = f->pixels;
+
+	for (i = 0; i < f->nrects; i++) {
+		r = &f->rects[i];
+		width = r->x2 - r->x1;
+		height = r->y2 - r->y1;
+
+		run = prev = 0; /* quiet gcc */
+		for (j = 0; j < height; j++) {
+			if (recorder->do_yflip)
+				s = rect + width * j;
+			else
+				s = rect + width * (height - j - 1);
+			y = r->y2 - j - 1;
+			d = recorder->frame + recorder->width * y + r->x1;
+
+			for (k = 0; k < width; k++) {
+				next = *s++;
+				delta = component_delta(next, *d);
+				*d++ = next;
+				if (run == 0 || delta == prev) {
+					run++;
+				} else {
+					p = output_run(p, prev, run);
+					run = 1;
+				}
+				prev = delta;
+			}
+		}
+
+		p = output_run(p, prev, run);
+		rect += width * height;
+	}
+
+	return p;
+}
+
+#ifdef HAVE_ZLIB
+/* Compressed frames carry the size of the encoded data before and after
+ * compression, then the zlib stream padded to 32 bits. */
+static void
+recorder_write_zlib(struct weston_recorder *recorder, struct iovec *v,
+		    size_t len)
+{
+	static const uint8_t padding[3];
+	uLongf zlen = recorder->zbuf_size;
+	uint32_t sizes[2];
+
+	if (compress2(recorder->zbuf, &zlen,
+		      (const Bytef *) recorder->outbuf, len,
+		      Z_DEFAULT_COMPRESSION) != Z_OK) {
+		recorder->write_failed = 1;
+		return;
+	}
+
+	sizes[0] = len;
+	sizes[1] = zlen;
+	v[2].iov_base = sizes;
+	v[2].iov_len = sizeof sizes;
+	v[3].iov_base = recorder->zbuf;
+	v[3].iov_len = zlen;
+	v[4].iov_base = (void *) padding;
+	v[4].iov_len = -zlen & 3;
+	recorder_write(recorder, v, 5);
+}
+#endif
+
+static void
+recorder_write_frame(struct weston_recorder *recorder,
+		     struct recorder_frame *f)
+{
+	struct wcap_frame_header header;
+	struct iovec v[5];
+	uint32_t *end;
+	size_t len;
+
+	end = recorder_encode_frame(recorder, f);
+	len = (end - recorder->outbuf) * sizeof *end;
+
+	header.msecs = f->msecs;
+	header.nrects = f->nrects;
+	v[0].iov_base = &header;
+	v[0].iov_len = sizeof header;
+	v[1].iov_base = f->rects;
+	v[1].iov_len = f->nrects * sizeof *f->rects;
+
+	switch (recorder->compression) {
+	case WESTON_RECORDER_COMPRESSION_NONE:
+		v[2].iov_base = recorder->outbuf;
+		v[2].iov_len = len;
+		recorder_write(recorder, v, 3);
+		break;
+#ifdef HAVE_ZLIB
+	case WESTON_RECORDER_COMPRESSION_ZLIB:
+		recorder_write_zlib(recorder, v, len);
+		break;
+#endif
+	default:
+		recorder->write_failed = 1;
+		break;
+	}
+
+	recorder->count++;
+}
+
+static void *
+recorder_thread(void *data)
+{
+	struct weston_recorder *recorder = data;
+	struct recorder_frame *f;
+
+	pthread_mutex_lock(&recorder->mutex);
+	while (1) {
+		while (wl_list_empty(&recorder->queue) && !recorder->quit)
+			pthread_cond_wait(&recorder->cond, &recorder->mutex);
+
+		/* Everything queued is written before quitting. */
+		if (wl_list_empty(&recorder->queue))
+			break;
+
+		f = container_of(recorder->queue.next,
+				 struct recorder_frame, link);
+		wl_list_remove(&f->link);
+		pthread_mutex_unlock(&recorder->mutex);
+
+		recorder_write_frame(recorder, f);
+
+		pthread_mutex_lock(&recorder->mutex);
+		wl_list_insert(&recorder->free_list, &f->link);
+	}
+	pthread_mutex_unlock(&recorder->mutex);
+
+	return NULL;
+}
+
+static void
+recorder_frame_destroy(struct recorder_frame *f)
+{
+	free(f->rects);
+	free(f->pixels);
+	free(f);
+}
+
+/* Return a frame to fill, or NULL if the encoder is too far behind. */
+static struct recorder_frame *
+recorder_get_frame(struct weston_recorder *recorder)
+{
+	struct recorder_frame *f = NULL;
+
+	pthread_mutex_lock(&recorder->mutex);
+	if (!wl_list_empty(&recorder->free_list)) {
+		f = container_of(recorder->free_list.next,
+				 struct recorder_frame, link);
+		wl_list_remove(&f->link);
+	}
+	pthread_mutex_unlock(&recorder->mutex);
+
+	if (f || recorder->n_frames == RECORDER_MAX_FRAMES)
+		return f;
+
+	f = zalloc(sizeof *f);
+	if (!f)
+		return NULL;
+
+	f->pixels = malloc(recorder->width * recorder->height * 4);
+	if (!f->pixels) {
+		free(f);
+		return NULL;
+	}
+
+	recorder->n_frames++;
+
+	return f;
+}
+
 static void
 weston_recorder_destroy(struct weston_recorder *recorder);
 
@@ -259,105 +484,82 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 		container_of(listener, struct weston_recorder, frame_listener);
 	struct weston_output *output = data;
 	struct weston_compositor *compositor = output->compositor;
-	uint32_t msecs = output->frame_time;
-	pixman_box32_t *r;
+	struct recorder_frame *f;
+	pixman_box32_t *r, *rects;
 	pixman_region32_t damage, transformed_damage;
-	int i, j, k, n, width, height, run, stride;
-	uint32_t delta, prev, *d, *s, *p, next;
-	struct {
-		uint32_t msecs;
-		uint32_t nrects;
-	} header;
-	struct iovec v[2];
-	int do_yflip;
+	int i, n, width, height;
 	int y_orig;
-	uint32_t *outbuf;
-
-	do_yflip = !!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
-	if (do_yflip)
-		outbuf = recorder->rect;
-	else
-		outbuf = recorder->tmpbuf;
+	uint32_t *pixels;
 
 	pixman_region32_init(&damage);
 	pixman_region32_init(&transformed_damage);
 	pixman_region32_intersect(&damage, &output->region,
 				  &output->previous_damage);
+	pixman_region32_union(&damage, &damage, &recorder->skipped_damage);
 	pixman_region32_translate(&damage, -output->x, -output->y);
 	weston_transformed_region(output->width, output->height,
 				 output->transform, output->current_scale,
 				 &damage, &transformed_damage);
-	pixman_region32_fini(&damage);
 
 	r = pixman_region32_rectangles(&transformed_damage, &n);
-	if (n == 0) {
-		pixman_region32_fini(&transformed_damage);
-		return;
+	if (n == 0)
+		goto out;
+
+	f = recorder_get_frame(recorder);
+	if (!f) {
+		/* Record the damage with the next frame instead. */
+		pixman_region32_translate(&damage, output->x, output->y);
+		pixman_region32_copy(&recorder->skipped_damage, &damage);
+		recorder->skipped++;
+		goto out;
 	}
 
-	header.msecs = msecs;
-	header.nrects = n;
-	v[0].iov_base = &header;
-	v[0].iov_len = sizeof header;
-	v[1].iov_base = r;
-	v[1].iov_len = n * sizeof *r;
-	recorder->total += writev(recorder->fd, v, 2);
-	stride = output->current_mode->width;
+	if (f->rects_alloc < n) {
+		rects = realloc(f->rects, n * sizeof *rects);
+		if (!rects) {
+			weston_log("%s: out of memory\n", __func__);
+			pixman_region32_translate(&damage, output->x, output->y);
+			pixman_region32_copy(&recorder->skipped_damage,
+					     &damage);
+			pthread_mutex_lock(&recorder->mutex);
+			wl_list_insert(&recorder->free_list, &f->link);
+			pthread_mutex_unlock(&recorder->mutex);
+			goto out;
+		}
+		f->rects = rects;
+		f->rects_alloc = n;
+	}
+
+	pixman_region32_clear(&recorder->skipped_damage);
 
+	f->msecs = output->frame_time;
+	f->nrects = n;
+	memcpy(f->rects, r, n * sizeof *r);
+
+	pixels = f->pixels;
 	for (i = 0; i < n; i++) {
 		width = r[i].x2 - r[i].x1;
 		height = r[i].y2 - r[i].y1;
 
-		if (do_yflip)
+		if (recorder->do_yflip)
 			y_orig = output->current_mode->height - r[i].y2;
 		else
 			y_orig = r[i].y1;
 
 		compositor->renderer->read_pixels(output,
-				compositor->read_format, recorder->rect,
+				compositor->read_format, pixels,
 				r[i].x1, y_orig, width, height);
-
-		p = outbuf;
-		run = prev = 0; /* quiet gcc */
-		for (j = 0; j < height; j++) {
-			if (do_yflip)
-				s = recorder->rect + width * j;
-			else
-				s = recorder->rect + width * (height - j - 1);
-			y_orig = r[i].y2 - j - 1;
-			d = recorder->frame + stride * y_orig + r[i].x1;
-
-			for (k = 0; k < width; k++) {
-				next = *s++;
-				delta = component_delta(next, *d);
-				*d++ = next;
-				if (run == 0 || delta == prev) {
-					run++;
-				} else {
-					p = output_run(p, prev, run);
-					run = 1;
-				}
-				prev = delta;
-			}
-		}
-
-		p = output_run(p, prev, run);
-
-		recorder->total += write(recorder->fd,
-					 outbuf, (p - outbuf) * 4);
-
-#if 0
-		fprintf(stderr,
-			"%dx%d at %d,%d rle from %d to %d bytes (%f) total %dM\n",
-			width, height, r[i].x1, r[i].y1,
-			width * height * 4, (int) (p - outbuf) * 4,
-			(float) (p - outbuf) / (width * height),
-			recorder->total / 1024 / 1024);
-#endif
+		pixels += width * height;
 	}
 
+	pthread_mutex_lock(&recorder->mutex);
+	wl_list_insert(recorder->queue.prev, &f->link);
+	pthread_cond_signal(&recorder->cond);
+	pthread_mutex_unlock(&recorder->mutex);
+
+out:
+	pixman_region32_fini(&damage);
 	pixman_region32_fini(&transformed_damage);
-	recorder->count++;
 
 	if (recorder->destroying)
 		weston_recorder_destroy(recorder);
@@ -366,25 +568,35 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 static void
 weston_recorder_free(struct weston_recorder *recorder)
 {
+	struct recorder_frame *f, *next;
+
 	if (recorder == NULL)
 		return;
 
-	free(recorder->tmpbuf);
-	free(recorder->rect);
+	wl_list_for_each_safe(f, next, &recorder->queue, link)
+		recorder_frame_destroy(f);
+	wl_list_for_each_safe(f, next, &recorder->free_list, link)
+		recorder_frame_destroy(f);
+
+	pthread_cond_destroy(&recorder->cond);
+	pthread_mutex_destroy(&recorder->mutex);
+	pixman_region32_fini(&recorder->skipped_damage);
+	free(recorder->zbuf);
+	free(recorder->outbuf);
 	free(recorder->frame);
 	free(recorder);
 }
 
 static struct weston_recorder *
-weston_recorder_create(struct weston_output *output, const char *filename)
+weston_recorder_create(struct weston_output *output, const char *filename,
+		       enum weston_recorder_compression compression)
 {
 	struct weston_compositor *compositor = output->compositor;
 	struct weston_recorder *recorder;
-	int stride, size;
-	struct { uint32_t magic, format, width, height; } header;
-	int do_yflip;
-
-	do_yflip = !!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
+	int size;
+	struct wcap_header_v2 header;
+	size_t header_size = sizeof(struct wcap_header);
+	struct iovec v;
 
 	recorder = zalloc(sizeof *recorder);
 	if (recorder == NULL) {
@@ -392,26 +604,56 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 		return NULL;
 	}
 
-	stride = output->current_mode->width;
-	size = stride * 4 * output->current_mode->height;
-	recorder->frame = zalloc(size);
-	recorder->rect = malloc(size);
+	pthread_mutex_init(&recorder->mutex, NULL);
+	pthread_cond_init(&recorder->cond, NULL);
+	wl_list_init(&recorder->queue);
+	wl_list_init(&recorder->free_list);
+	pixman_region32_init(&recorder->skipped_damage);
+
+	recorder->do_yflip =
+		!!(compositor->capabilities & WESTON_CAP_CAPTURE_YFLIP);
+	recorder->width = output->current_mode->width;
+	recorder->height = output->current_mode->height;
 	recorder->output = output;
+	recorder->fd = -1;
+
+#ifndef HAVE_ZLIB
+	if (compression == WESTON_RECORDER_COMPRESSION_ZLIB) {
+		weston_log("recorder: built without zlib, "
+			   "recording uncompressed\n");
+		compression = WESTON_RECORDER_COMPRESSION_NONE;
+	}
+#endif
+	recorder->compression = compression;
+
+	size = recorder->width * recorder->height * 4;
+	recorder->frame = zalloc(size);
+	recorder->outbuf = malloc(size);
 
-	if ((recorder->frame == NULL) || (recorder->rect == NULL)) {
+	if ((recorder->frame == NULL) || (recorder->outbuf == NULL)) {
 		weston_log("%s: out of memory\n", __func__);
 		goto err_recorder;
 	}
 
-	if (!do_yflip) {
-		recorder->tmpbuf = malloc(size);
-		if (recorder->tmpbuf == NULL) {
+#ifdef HAVE_ZLIB
+	if (compression == WESTON_RECORDER_COMPRESSION_ZLIB) {
+		recorder->zbuf_size = compressBound(size);
+		recorder->zbuf = malloc(recorder->zbuf_size);
+		if (recorder->zbuf == NULL) {
 			weston_log("%s: out of memory\n", __func__);
 			goto err_recorder;
 		}
 	}
+#endif
 
+	/* Uncompressed recordings keep the original format, readable by
+	 * older decoders. */
 	header.magic = WCAP_HEADER_MAGIC;
+	if (compression != WESTON_RECORDER_COMPRESSION_NONE) {
+		header.magic = WCAP_HEADER_MAGIC_V2;
+		header.compression = WCAP_COMPRESSION_ZLIB;
+		header_size = sizeof header;
+	}
 
 	switch (compositor->read_format) {
 	case PIXMAN_x8r8g8b8:
@@ -434,9 +676,17 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 		goto err_recorder;
 	}
 
-	header.width = output->current_mode->width;
-	header.height = output->current_mode->height;
-	recorder->total += write(recorder->fd, &header, sizeof header);
+	header.width = recorder->width;
+	header.height = recorder->height;
+	v.iov_base = &header;
+	v.iov_len = header_size;
+	recorder_write(recorder, &v, 1);
+
+	if (pthread_create(&recorder->thread, NULL,
+			   recorder_thread, recorder) != 0) {
+		weston_log("%s: cannot start the encoder thread\n", __func__);
+		goto err_fd;
+	}
 
 	recorder->frame_listener.notify = weston_recorder_frame_notify;
 	wl_signal_add(&output->frame_signal, &recorder->frame_listener);
@@ -445,6 +695,8 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 
 	return recorder;
 
+err_fd:
+	close(recorder->fd);
 err_recorder:
 	weston_recorder_free(recorder);
 	return NULL;
@@ -454,13 +706,39 @@ static void
 weston_recorder_destroy(struct weston_recorder *recorder)
 {
 	wl_list_remove(&recorder->frame_listener.link);
-	close(recorder->fd);
 	recorder->output->disable_planes--;
+
+	pthread_mutex_lock(&recorder->mutex);
+	recorder->quit = 1;
+	pthread_cond_signal(&recorder->cond);
+	pthread_mutex_unlock(&recorder->mutex);
+	pthread_join(recorder->thread, NULL);
+
+	weston_log("recorder stopped, total file size %dM, %d frames, "
+		   "%d skipped\n", recorder->total / (1024 * 1024),
+		   recorder->count, recorder->skipped);
+	if (recorder->write_failed)
+		weston_log("recorder: writing the capture failed, "
+			   "it is incomplete\n");
+
+	close(recorder->fd);
 	weston_recorder_free(recorder);
 }
 
+/** Start recording an output to a wcap file
+ *
+ * \param output The output to record.
+ * \param filename The file to write the capture to.
+ * \param compression How to compress the frames. Compressed captures use
+ * version 2 of the wcap format.
+ * \return The recorder, or NULL on failure.
+ *
+ * The frames are encoded and written by a separate thread.
+ */
 WL_EXPORT struct weston_recorder *
-weston_recorder_start(struct weston_output *output, const char *filename)
+weston_recorder_start_compressed(struct weston_output *output,
+				 const char *filename,
+				 enum weston_recorder_compression compression)
 {
 	struct wl_listener *listener;
 
@@ -474,14 +752,20 @@ weston_recorder_start(struct weston_output *output, const char *filename)
 
 	weston_log("starting recorder for output %s, file %s\n",
 		   output->name, filename);
-	return weston_recorder_create(output, filename);
+	return weston_recorder_create(output, filename, compression);
+}
+
+WL_EXPORT struct weston_recorder *
+weston_recorder_start(struct weston_output *output, const char *filename)
+{
+	return weston_recorder_start_compressed(output, filename,
+					WESTON_RECORDER_COMPRESSION_NONE);
 }
 
 WL_EXPORT void
 weston_recorder_stop(struct weston_recorder *recorder)
 {
-	weston_log("stopping recorder, total file size %dM, %d frames\n",
-		   recorder->total / (1024 * 1024), recorder->count);
+	weston_log("stopping recorder\n");
 
 	recorder->destroying = 1;
 	weston_output_schedule_repaint(recorder->output);
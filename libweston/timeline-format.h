@@ -0,0 +1,93 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_TIMELINE_FORMAT_H
+#define WESTON_TIMELINE_FORMAT_H
+
+#include <stdint.h>
+
+/*
+ * Binary timeline log format.
+ *
+ * The file starts with a struct weston_timeline_header, followed by
+ * fixed-size records in host byte order. weston-timeline-decode turns
+ * them back into the JSON timeline format.
+ *
+ * Strings (timeline point names and object descriptions) are split over
+ * as many consecutive records as needed, every record but the last one
+ * of a string having WESTON_TIMELINE_RECORD_CONTINUED set. A record
+ * describing an object or a point name always precedes the first point
+ * referring to it.
+ */
+
+#define WESTON_TIMELINE_MAGIC "WTL\0"
+#define WESTON_TIMELINE_VERSION 1
+
+struct weston_timeline_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t clock_id;
+};
+
+enum weston_timeline_record_type {
+	/* id: point name id, aux: number of arguments */
+	WESTON_TIMELINE_RECORD_POINT = 1,
+	/* id: point name id, text: the name */
+	WESTON_TIMELINE_RECORD_NAME,
+	/* id: object id, text: the output name */
+	WESTON_TIMELINE_RECORD_OUTPUT,
+	/* id: object id, aux: main surface id or 0, text: the label */
+	WESTON_TIMELINE_RECORD_SURFACE,
+	/* aux: number of points lost because the ring buffer was full */
+	WESTON_TIMELINE_RECORD_DROPPED,
+};
+
+/* More records follow with the rest of the string */
+#define WESTON_TIMELINE_RECORD_CONTINUED	(1 << 0)
+/* The string is NULL */
+#define WESTON_TIMELINE_RECORD_NULL		(1 << 1)
+
+#define WESTON_TIMELINE_MAX_ARGS 4
+
+struct weston_timeline_record {
+	uint16_t type;
+	uint16_t flags;
+	uint32_t id;
+	int64_t tv_sec;
+	uint32_t tv_nsec;
+	uint32_t aux;
+	union {
+		struct {
+			/* enum timeline_type of each argument, in order */
+			uint8_t arg_type[WESTON_TIMELINE_MAX_ARGS];
+			uint32_t output;
+			uint32_t surface;
+			uint32_t vblank_nsec;
+			int64_t vblank_sec;
+		} point;
+		char text[40];	/* not NUL-terminated when full */
+	} u;
+};
+
+#endif /* WESTON_TIMELINE_FORMAT_H */
@@ -27,31 +27,108 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
 #include <errno.h>
 #include <string.h>
 #include <time.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "timeline.h"
+#include "timeline-format.h"
 #include "compositor.h"
 #include "file-util.h"
+#include "shared/helpers.h"
 
+/* Must be a power of two. 4 MiB of 64 byte records. */
+#define TIMELINE_RING_SIZE 65536
+/* How often the writer thread drains the ring, in milliseconds */
+#define TIMELINE_DRAIN_INTERVAL 10
+/* Objects described by one timeline point, at most */
+#define TIMELINE_MAX_DESCRIBED 8
+
+/*
+ * Timeline points are stored as binary records in a ring buffer, which
+ * a writer thread drains to the log file. The compositor thread is the
+ * only producer and only advances head, the writer thread only advances
+ * tail, so no lock is needed. When the ring is full, points are dropped
+ * and counted.
+ */
 struct timeline_log {
 	clock_t clk_id;
 	FILE *file;
 	unsigned series;
 	struct wl_listener compositor_destroy_listener;
+
+	struct weston_timeline_record *ring;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t dropped;	/* not reported in the log yet */
+	uint32_t dropped_total;
+	struct wl_array names;	/* const char *, index is name id - 1 */
+
+	pthread_t writer;
+	int quit;
+	int write_failed;
 };
 
 WL_EXPORT int weston_timeline_enabled_;
 static struct timeline_log timeline_ = { CLOCK_MONOTONIC, NULL, 0 };
 
+static void
+timeline_write_records(uint32_t from, uint32_t to)
+{
+	uint32_t begin, n;
+
+	while (from != to) {
+		begin = from & (TIMELINE_RING_SIZE - 1);
+		n = MIN(to - from, TIMELINE_RING_SIZE - begin);
+
+		if (!timeline_.write_failed &&
+		    fwrite(&timeline_.ring[begin], sizeof(*timeline_.ring),
+			   n, timeline_.file) != n)
+			__atomic_store_n(&timeline_.write_failed, 1,
+					 __ATOMIC_RELAXED);
+
+		from += n;
+		__atomic_store_n(&timeline_.tail, from, __ATOMIC_RELEASE);
+	}
+}
+
+static void *
+timeline_writer_thread(void *data)
+{
+	struct timespec interval = {
+		0, TIMELINE_DRAIN_INTERVAL * 1000000
+	};
+	uint32_t head;
+	int quit;
+
+	do {
+		quit = __atomic_load_n(&timeline_.quit, __ATOMIC_ACQUIRE);
+		head = __atomic_load_n(&timeline_.head, __ATOMIC_ACQUIRE);
+
+		timeline_write_records(timeline_.tail, head);
+
+		if (!quit)
+			nanosleep(&interval, NULL);
+	} while (!quit);
+
+	return NULL;
+}
+
 static int
 weston_timeline_do_open(void)
 {
 	const char *prefix = "weston-timeline-";
-	const char *suffix = ".log";
+	const char *suffix = ".bin";
 	char fname[1000];
+	struct weston_timeline_header header = {
+		.magic = WESTON_TIMELINE_MAGIC,
+		.version = WESTON_TIMELINE_VERSION,
+		.record_size = sizeof(struct weston_timeline_record),
+	};
 
 	timeline_.file = file_create_dated(prefix, suffix,
 					   fname, sizeof(fname));
@@ -71,15 +148,55 @@ weston_timeline_do_open(void)
 		return -1;
 	}
 
+	header.clock_id = timeline_.clk_id;
+	if (fwrite(&header, sizeof header, 1, timeline_.file) != 1) {
+		weston_log("Cannot write timeline file '%s': %m\n", fname);
+		goto err_file;
+	}
+
+	if (!timeline_.ring) {
+		timeline_.ring = calloc(TIMELINE_RING_SIZE,
+					sizeof(*timeline_.ring));
+		if (!timeline_.ring) {
+			weston_log("Cannot allocate the timeline buffer\n");
+			goto err_file;
+		}
+	}
+
+	timeline_.head = 0;
+	timeline_.tail = 0;
+	timeline_.dropped = 0;
+	timeline_.dropped_total = 0;
+	timeline_.quit = 0;
+	timeline_.write_failed = 0;
+	wl_array_release(&timeline_.names);
+	wl_array_init(&timeline_.names);
+
+	if (pthread_create(&timeline_.writer, NULL,
+			   timeline_writer_thread, NULL) != 0) {
+		weston_log("Cannot start the timeline writer thread\n");
+		goto err_file;
+	}
+
 	weston_log("Opened timeline file '%s'\n", fname);
 
 	return 0;
+
+err_file:
+	fclose(timeline_.file);
+	timeline_.file = NULL;
+	return -1;
 }
 
 static void
 timeline_notify_destroy(struct wl_listener *listener, void *data)
 {
 	weston_timeline_close();
+
+	free(timeline_.ring);
+	timeline_.ring = NULL;
+	wl_array_release(&timeline_.names);
+	wl_array_init(&timeline_.names);
 }
 
 void
@@ -111,15 +228,31 @@ weston_timeline_close(void)
 
 	wl_list_remove(&timeline_.compositor_destroy_listener.link);
 
+	/* The writer drains what is left before exiting. */
+	__atomic_store_n(&timeline_.quit, 1, __ATOMIC_RELEASE);
+	pthread_join(timeline_.writer, NULL);
+
+	if (timeline_.write_failed)
+		weston_log("Timeline error writing the log file, "
+			   "it is incomplete.\n");
+	if (timeline_.dropped_total > 0)
+		weston_log("Timeline buffer overflow, %u points lost.\n",
+			   timeline_.dropped_total);
+
 	fclose(timeline_.file);
 	timeline_.file = NULL;
 	weston_log("Timeline log file closed.\n");
 }
 
 struct timeline_emit_context {
-	FILE *cur;
-	FILE *out;
+	const struct timespec *ts;
+	uint32_t head;		/* next record to fill */
+	uint32_t end;		/* first record not free in the ring */
+	bool overflow;
 	unsigned series;
+
+	struct weston_timeline_object *described[TIMELINE_MAX_DESCRIBED];
+	int n_described;
 };
 
 static unsigned
@@ -140,42 +273,104 @@ check_series(struct timeline_emit_context *ctx,
 	if (to->series == 0 || to->series != ctx->series) {
 		to->series = ctx->series;
 		to->id = timeline_new_id();
-		return 1;
+	} else if (to->force_refresh) {
+		to->force_refresh = 0;
+	} else {
+		return 0;
 	}
 
-	if (to->force_refresh) {
-		to->force_refresh = 0;
-		return 1;
+	/* Described again if the point does not make it into the ring. */
+	assert(ctx->n_described < TIMELINE_MAX_DESCRIBED);
+	ctx->described[ctx->n_described++] = to;
+
+	return 1;
+}
+
+static struct weston_timeline_record *
+emit_record(struct timeline_emit_context *ctx, uint16_t type, uint32_t id)
+{
+	struct weston_timeline_record *rec;
+
+	if (ctx->head == ctx->end) {
+		ctx->overflow = true;
+		return NULL;
 	}
 
-	return 0;
+	rec = &timeline_.ring[ctx->head++ & (TIMELINE_RING_SIZE - 1)];
+	memset(rec, 0, sizeof *rec);
+	rec->type = type;
+	rec->id = id;
+	rec->tv_sec = ctx->ts->tv_sec;
+	rec->tv_nsec = ctx->ts->tv_nsec;
+
+	return rec;
 }
 
 static void
-fprint_quoted_string(FILE *fp, const char *str)
+emit_string(struct timeline_emit_context *ctx, uint16_t type, uint32_t id,
+	    uint32_t aux, const char *str)
 {
+	struct weston_timeline_record *rec;
+	size_t len, n;
+
 	if (!str) {
-		fprintf(fp, "null");
+		rec = emit_record(ctx, type, id);
+		if (rec) {
+			rec->flags = WESTON_TIMELINE_RECORD_NULL;
+			rec->aux = aux;
+		}
 		return;
 	}
 
-	fprintf(fp, "\"%s\"", str);
+	len = strlen(str);
+	do {
+		rec = emit_record(ctx, type, id);
+		if (!rec)
+			return;
+
+		n = MIN(len, sizeof(rec->u.text));
+		memcpy(rec->u.text, str, n);
+		rec->aux = aux;
+		str += n;
+		len -= n;
+
+		if (len > 0)
+			rec->flags = WESTON_TIMELINE_RECORD_CONTINUED;
+	} while (len > 0);
+}
+
+static uint32_t
+lookup_name(struct timeline_emit_context *ctx, const char *name)
+{
+	const char **names = timeline_.names.data;
+	unsigned n = timeline_.names.size / sizeof(*names);
+	unsigned i;
+
+	for (i = 0; i < n; i++)
+		if (names[i] == name)
+			return i + 1;
+
+	for (i = 0; i < n; i++)
+		if (strcmp(names[i], name) == 0)
+			return i + 1;
+
+	/* New name, interned once the point is committed. */
+	emit_string(ctx, WESTON_TIMELINE_RECORD_NAME, n + 1, 0, name);
+
+	return n + 1;
 }
 
 static int
-emit_weston_output(struct timeline_emit_context *ctx, void *obj)
+emit_weston_output(struct timeline_emit_context *ctx,
+		   struct weston_timeline_record *point, void *obj)
 {
 	struct weston_output *o = obj;
 
-	if (check_series(ctx, &o->timeline)) {
-		fprintf(ctx->out, "{ \"id\":%u, "
-			"\"type\":\"weston_output\", \"name\":",
-			o->timeline.id);
-		fprint_quoted_string(ctx->out, o->name);
-		fprintf(ctx->out, " }\n");
-	}
+	if (check_series(ctx, &o->timeline))
+		emit_string(ctx, WESTON_TIMELINE_RECORD_OUTPUT,
+			    o->timeline.id, 0, o->name);
 
-	fprintf(ctx->cur, "\"wo\":%u", o->timeline.id);
+	point->u.point.output = o->timeline.id;
 
 	return 1;
 }
@@ -186,7 +381,7 @@ check_weston_surface_description(struct timeline_emit_context *ctx,
 {
 	struct weston_surface *mains;
 	char d[512];
-	char mainstr[32];
+	uint32_t main_id = 0;
 
 	if (!check_series(ctx, &s->timeline))
 		return;
@@ -194,45 +389,42 @@ check_weston_surface_description(struct timeline_emit_context *ctx,
 	mains = weston_surface_get_main_surface(s);
 	if (mains != s) {
 		check_weston_surface_description(ctx, mains);
-		if (snprintf(mainstr, sizeof(mainstr),
-			     ", \"main_surface\":%u", mains->timeline.id) < 0)
-			mainstr[0] = '\0';
-	} else {
-		mainstr[0] = '\0';
+		main_id = mains->timeline.id;
 	}
 
 	if (!s->get_label || s->get_label(s, d, sizeof(d)) < 0)
 		d[0] = '\0';
 
-	fprintf(ctx->out, "{ \"id\":%u, "
-		"\"type\":\"weston_surface\", \"desc\":", s->timeline.id);
-	fprint_quoted_string(ctx->out, d[0] ? d : NULL);
-	fprintf(ctx->out, "%s }\n", mainstr);
+	emit_string(ctx, WESTON_TIMELINE_RECORD_SURFACE, s->timeline.id,
+		    main_id, d[0] ? d : NULL);
 }
 
 static int
-emit_weston_surface(struct timeline_emit_context *ctx, void *obj)
+emit_weston_surface(struct timeline_emit_context *ctx,
+		    struct weston_timeline_record *point, void *obj)
 {
 	struct weston_surface *s = obj;
 
 	check_weston_surface_description(ctx, s);
-	fprintf(ctx->cur, "\"ws\":%u", s->timeline.id);
+	point->u.point.surface = s->timeline.id;
 
 	return 1;
 }
 
 static int
-emit_vblank_timestamp(struct timeline_emit_context *ctx, void *obj)
+emit_vblank_timestamp(struct timeline_emit_context *ctx,
+		      struct weston_timeline_record *point, void *obj)
 {
 	struct timespec *ts = obj;
 
-	fprintf(ctx->cur, "\"vblank\":[%" PRId64 ", %ld]",
-		(int64_t)ts->tv_sec, ts->tv_nsec);
+	point->u.point.vblank_sec = ts->tv_sec;
+	point->u.point.vblank_nsec = ts->tv_nsec;
 
 	return 1;
 }
 
-typedef int (*type_func)(struct timeline_emit_context *ctx, void *obj);
+typedef int (*type_func)(struct timeline_emit_context *ctx,
+			 struct weston_timeline_record *point, void *obj);
 
 static const type_func type_dispatch[] = {
 	[TLT_OUTPUT] = emit_weston_output,
@@ -247,23 +439,33 @@ weston_timeline_point(const char *name, ...)
 	struct timespec ts;
 	enum timeline_type otype;
 	void *obj;
-	char buf[512];
+	struct weston_timeline_record point = { 0 };
+	struct weston_timeline_record *rec;
 	struct timeline_emit_context ctx;
+	const char **interned;
+	uint32_t tail;
+	int i;
 
 	clock_gettime(timeline_.clk_id, &ts);
 
-	ctx.out = timeline_.file;
-	ctx.cur = fmemopen(buf, sizeof(buf), "w");
+	tail = __atomic_load_n(&timeline_.tail, __ATOMIC_ACQUIRE);
+	ctx.ts = &ts;
+	ctx.head = timeline_.head;
+	ctx.end = tail + TIMELINE_RING_SIZE;
+	ctx.overflow = false;
 	ctx.series = timeline_.series;
+	ctx.n_described = 0;
 
-	if (!ctx.cur) {
-		weston_log("Timeline error in fmemopen, closing.\n");
-		weston_timeline_close();
-		return;
+	if (timeline_.dropped > 0) {
+		rec = emit_record(&ctx, WESTON_TIMELINE_RECORD_DROPPED, 0);
+		if (rec)
+			rec->aux = timeline_.dropped;
 	}
 
-	fprintf(ctx.cur, "{ \"T\":[%" PRId64 ", %ld], \"N\":\"%s\"",
-		(int64_t)ts.tv_sec, ts.tv_nsec, name);
+	point.type = WESTON_TIMELINE_RECORD_POINT;
+	point.id = lookup_name(&ctx, name);
+	point.tv_sec = ts.tv_sec;
+	point.tv_nsec = ts.tv_nsec;
 
 	va_start(argp, name);
 	while (1) {
@@ -272,21 +474,35 @@ weston_timeline_point(const char *name, ...)
 			break;
 
 		obj = va_arg(argp, void *);
-		if (type_dispatch[otype]) {
-			fprintf(ctx.cur, ", ");
-			type_dispatch[otype](&ctx, obj);
+		if (type_dispatch[otype] &&
+		    point.aux < WESTON_TIMELINE_MAX_ARGS) {
+			point.u.point.arg_type[point.aux++] = otype;
+			type_dispatch[otype](&ctx, &point, obj);
 		}
 	}
 	va_end(argp);
 
-	fprintf(ctx.cur, " }\n");
-	fflush(ctx.cur);
-	if (ferror(ctx.cur)) {
-		weston_log("Timeline error in constructing entry, closing.\n");
-		weston_timeline_close();
-	} else {
-		fprintf(ctx.out, "%s", buf);
+	rec = emit_record(&ctx, WESTON_TIMELINE_RECORD_POINT, 0);
+	if (!rec) {
+		/* Nothing is published, describe the objects next time. */
+		for (i = 0; i < ctx.n_described; i++)
+			ctx.described[i]->force_refresh = 1;
+		timeline_.dropped++;
+		timeline_.dropped_total++;
+		return;
+	}
+	*rec = point;
+
+	if (point.id > timeline_.names.size / sizeof(*interned)) {
+		interned = wl_array_add(&timeline_.names, sizeof(*interned));
+		if (!interned) {
+			weston_log("Timeline out of memory, closing.\n");
+			weston_timeline_close();
+			return;
+		}
+		*interned = name;
 	}
 
-	fclose(ctx.cur);
+	timeline_.dropped = 0;
+	__atomic_store_n(&timeline_.head, ctx.head, __ATOMIC_RELEASE);
 }
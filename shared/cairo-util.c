@@ -184,13 +184,14 @@ render_shadow(cairo_t *cr, cairo_surface_t *surface,
 		if (width < 2 * shadow_width)
 			shadow_width = (width + !fx) / 2;
 
-		cairo_reset_clip(cr);
+		cairo_save(cr);
 		cairo_rectangle(cr,
 				x + fx * (width - shadow_width),
 				y + fy * (height - shadow_height),
 				shadow_width, shadow_height);
 		cairo_clip (cr);
 		cairo_mask(cr, pattern);
+		cairo_restore(cr);
 	}
 
 
@@ -205,24 +206,25 @@ render_shadow(cairo_t *cr, cairo_surface_t *surface,
 		cairo_matrix_scale(&matrix, 8.0 / width, 1);
 		cairo_matrix_translate(&matrix, -x - width / 2, -y);
 		cairo_pattern_set_matrix(pattern, &matrix);
-		cairo_rectangle(cr, x + margin, y, shadow_width, shadow_height);
 
-		cairo_reset_clip(cr);
+		cairo_save(cr);
 		cairo_rectangle(cr,
 				x + margin, y,
 				shadow_width, shadow_height);
 		cairo_clip (cr);
 		cairo_mask(cr, pattern);
+		cairo_restore(cr);
 
 		/* Bottom stretch */
 		cairo_matrix_translate(&matrix, 0, -height + 128);
 		cairo_pattern_set_matrix(pattern, &matrix);
 
-		cairo_reset_clip(cr);
+		cairo_save(cr);
 		cairo_rectangle(cr, x + margin, y + height - margin,
 				shadow_width, margin);
 		cairo_clip (cr);
 		cairo_mask(cr, pattern);
+		cairo_restore(cr);
 	}
 
 	shadow_width = margin;
@@ -239,24 +241,25 @@ render_shadow(cairo_t *cr, cairo_surface_t *surface,
 		cairo_matrix_scale(&matrix, 1, 8.0 / height);
 		cairo_matrix_translate(&matrix, -x, -y - height / 2);
 		cairo_pattern_set_matrix(pattern, &matrix);
-		cairo_reset_clip(cr);
+		cairo_save(cr);
 		cairo_rectangle(cr, x, y + top_margin,
 				shadow_width, shadow_height);
 		cairo_clip (cr);
 		cairo_mask(cr, pattern);
+		cairo_restore(cr);
 
 		/* Right stretch */
 		cairo_matrix_translate(&matrix, -width + 128, 0);
 		cairo_pattern_set_matrix(pattern, &matrix);
+		cairo_save(cr);
 		cairo_rectangle(cr, x + width - shadow_width, y + top_margin,
 				shadow_width, shadow_height);
-		cairo_reset_clip(cr);
 		cairo_clip (cr);
 		cairo_mask(cr, pattern);
+		cairo_restore(cr);
 	}
 
 	cairo_pattern_destroy(pattern);
-	cairo_reset_clip(cr);
 }
 
 void
@@ -226,4 +226,9 @@ frame_double_touch_up(struct frame *frame, void *data, int32_t id);
 void
 frame_repaint(struct frame *frame, cairo_t *cr);
 
+/* Like frame_repaint(), for a target still holding the frame as it was
+ * last painted: only the parts changed since are painted again. */
+void
+frame_repaint_damaged(struct frame *frame, cairo_t *cr);
+
 #endif
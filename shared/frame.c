@@ -84,6 +84,13 @@ struct frame_touch {
 	struct frame_button *button;
 };
 
+/* The parts of the frame changed since it was last painted */
+enum frame_damage {
+	FRAME_DAMAGE_TITLEBAR = 0x1,	/* title and buttons */
+	FRAME_DAMAGE_BORDER = 0x2,	/* around the interior, titlebar included */
+	FRAME_DAMAGE_ALL = 0x4,
+};
+
 struct frame {
 	int32_t width, height;
 	char *title;
@@ -99,12 +106,20 @@ struct frame {
 	int geometry_dirty;
 
 	uint32_t status;
+	uint32_t damage;
 
 	struct wl_list buttons;
 	struct wl_list pointers;
 	struct wl_list touches;
 };
 
+static void
+frame_damage(struct frame *frame, enum frame_damage damage)
+{
+	frame->damage |= damage;
+	frame->status |= FRAME_STATUS_REPAINT;
+}
+
 static struct frame_button *
 frame_button_create(struct frame *frame, const char *icon,
 		    enum frame_status status_effect,
@@ -142,7 +157,7 @@ static void
 frame_button_enter(struct frame_button *button)
 {
 	if (!button->hover_count)
-		button->frame->status |= FRAME_STATUS_REPAINT;
+		frame_damage(button->frame, FRAME_DAMAGE_TITLEBAR);
 	button->hover_count++;
 }
 
@@ -151,14 +166,14 @@ frame_button_leave(struct frame_button *button, struct frame_pointer *pointer)
 {
 	button->hover_count--;
 	if (!button->hover_count)
-		button->frame->status |= FRAME_STATUS_REPAINT;
+		frame_damage(button->frame, FRAME_DAMAGE_TITLEBAR);
 }
 
 static void
 frame_button_press(struct frame_button *button)
 {
 	if (!button->press_count)
-		button->frame->status |= FRAME_STATUS_REPAINT;
+		frame_damage(button->frame, FRAME_DAMAGE_TITLEBAR);
 	button->press_count++;
 
 	if (button->flags & FRAME_BUTTON_CLICK_DOWN)
@@ -172,7 +187,7 @@ frame_button_release(struct frame_button *button)
 	if (button->press_count)
 		return;
 
-	button->frame->status |= FRAME_STATUS_REPAINT;
+	frame_damage(button->frame, FRAME_DAMAGE_TITLEBAR);
 
 	if (!(button->flags & FRAME_BUTTON_CLICK_DOWN))
 		button->frame->status |= button->status_effect;
@@ -183,7 +198,7 @@ frame_button_cancel(struct frame_button *button)
 {
 	button->press_count--;
 	if (!button->press_count)
-		button->frame->status |= FRAME_STATUS_REPAINT;
+		frame_damage(button->frame, FRAME_DAMAGE_TITLEBAR);
 }
 
 static void
@@ -317,6 +332,7 @@ frame_create(struct theme *t, int32_t width, int32_t height, uint32_t buttons,
 	frame->flags = 0;
 	frame->theme = t;
 	frame->status = FRAME_STATUS_REPAINT;
+	frame->damage = FRAME_DAMAGE_ALL;
 	frame->geometry_dirty = 1;
 
 	wl_list_init(&frame->buttons);
@@ -386,38 +402,55 @@ frame_set_title(struct frame *frame, const char *title)
 			return -1;
 	}
 
+	/* Adding or removing the title resizes the titlebar. */
+	if (!dup != !frame->title)
+		frame_damage(frame, FRAME_DAMAGE_ALL);
+	else
+		frame_damage(frame, FRAME_DAMAGE_TITLEBAR);
+
 	free(frame->title);
 	frame->title = dup;
 
 	frame->geometry_dirty = 1;
-	frame->status |= FRAME_STATUS_REPAINT;
 
 	return 0;
 }
 
-void
-frame_set_flag(struct frame *frame, enum frame_flag flag)
+static void
+frame_update_flags(struct frame *frame, uint32_t flags)
 {
-	if (flag & FRAME_FLAG_MAXIMIZED && !(frame->flags & FRAME_FLAG_MAXIMIZED))
+	uint32_t changed = frame->flags ^ flags;
+
+	if (changed & FRAME_FLAG_MAXIMIZED) {
 		frame->geometry_dirty = 1;
+		frame->damage |= FRAME_DAMAGE_ALL;
+	}
+	/* The shadow does not depend on the focus. */
+	if (changed & FRAME_FLAG_ACTIVE)
+		frame->damage |= FRAME_DAMAGE_BORDER;
 
-	frame->flags |= flag;
+	frame->flags = flags;
 	frame->status |= FRAME_STATUS_REPAINT;
 }
 
 void
-frame_unset_flag(struct frame *frame, enum frame_flag flag)
+frame_set_flag(struct frame *frame, enum frame_flag flag)
 {
-	if (flag & FRAME_FLAG_MAXIMIZED && frame->flags & FRAME_FLAG_MAXIMIZED)
-		frame->geometry_dirty = 1;
+	frame_update_flags(frame, frame->flags | flag);
+}
 
-	frame->flags &= ~flag;
-	frame->status |= FRAME_STATUS_REPAINT;
+void
+frame_unset_flag(struct frame *frame, enum frame_flag flag)
+{
+	frame_update_flags(frame, frame->flags & ~flag);
 }
 
 void
 frame_resize(struct frame *frame, int32_t width, int32_t height)
 {
+	if (frame->width != width || frame->height != height)
+		frame->damage |= FRAME_DAMAGE_ALL;
+
 	frame->width = width;
 	frame->height = height;
 
@@ -944,5 +977,53 @@ frame_repaint(struct frame *frame, cairo_t *cr)
 	wl_list_for_each(button, &frame->buttons, link)
 		frame_button_repaint(button, cr);
 
+	frame->damage = 0;
 	frame_status_clear(frame, FRAME_STATUS_REPAINT);
 }
+
+void
+frame_repaint_damaged(struct frame *frame, cairo_t *cr)
+{
+	struct theme *t = frame->theme;
+	int32_t margin, top_margin, width, height;
+
+	if (!frame->damage || frame->damage & FRAME_DAMAGE_ALL) {
+		if (frame->damage)
+			frame_repaint(frame, cr);
+		frame_status_clear(frame, FRAME_STATUS_REPAINT);
+		return;
+	}
+
+	frame_refresh_geometry(frame);
+
+	if (frame->title || !wl_list_empty(&frame->buttons))
+		top_margin = t->titlebar_height;
+	else
+		top_margin = t->width;
+
+	margin = frame->shadow_margin;
+	width = frame->width - margin * 2;
+	height = frame->height - margin * 2;
+
+	/* The frame paints the same pixels when clipped, the shadow
+	 * under the border included. */
+	cairo_save(cr);
+	if (frame->damage & FRAME_DAMAGE_BORDER) {
+		cairo_rectangle(cr, margin, margin, width, top_margin);
+		cairo_rectangle(cr, margin, margin + height - t->width,
+				width, t->width);
+		cairo_rectangle(cr, margin, margin + top_margin,
+				t->width, height - top_margin - t->width);
+		cairo_rectangle(cr, margin + width - t->width,
+				margin + top_margin,
+				t->width, height - top_margin - t->width);
+	} else {
+		cairo_rectangle(cr, margin + t->width, margin,
+				width - t->width * 2, top_margin);
+	}
+	cairo_clip(cr);
+
+	frame_repaint(frame, cr);
+
+	cairo_restore(cr);
+}
@@ -59,6 +59,38 @@ weston_matrix_init(struct weston_matrix *matrix)
 	memcpy(matrix, &identity, sizeof identity);
 }
 
+/* Matrices without WESTON_MATRIX_TRANSFORM_OTHER are affine: their last
+ * row is always 0 0 0 1, which the fast paths below rely on. */
+static inline int
+matrix_is_affine(const struct weston_matrix *matrix)
+{
+	return !(matrix->type & WESTON_MATRIX_TRANSFORM_OTHER);
+}
+
+/* m <- n * m for affine matrices, skipping the projective row. */
+static void
+matrix_multiply_affine(struct weston_matrix *m, const struct weston_matrix *n)
+{
+	struct weston_matrix tmp;
+	const float *column;
+	int r, c;
+
+	for (c = 0; c < 4; c++) {
+		column = m->d + c * 4;
+		for (r = 0; r < 3; r++)
+			tmp.d[c * 4 + r] = column[0] * n->d[r] +
+					   column[1] * n->d[r + 4] +
+					   column[2] * n->d[r + 8];
+		tmp.d[c * 4 + 3] = 0;
+	}
+	for (r = 0; r < 3; r++)
+		tmp.d[12 + r] += n->d[12 + r];
+	tmp.d[15] = 1;
+
+	tmp.type = m->type | n->type;
+	memcpy(m, &tmp, sizeof tmp);
+}
+
 /* m <- n * m, that is, m is multiplied on the LEFT. */
 WL_EXPORT void
 weston_matrix_multiply(struct weston_matrix *m, const struct weston_matrix *n)
@@ -68,6 +100,27 @@ weston_matrix_multiply(struct weston_matrix *m, const struct weston_matrix *n)
 	div_t d;
 	int i, j;
 
+	/* the identity */
+	if (n->type == 0)
+		return;
+	if (m->type == 0) {
+		memcpy(m, n, sizeof *m);
+		return;
+	}
+
+	if (m->type == WESTON_MATRIX_TRANSFORM_TRANSLATE &&
+	    n->type == WESTON_MATRIX_TRANSFORM_TRANSLATE) {
+		m->d[12] += n->d[12];
+		m->d[13] += n->d[13];
+		m->d[14] += n->d[14];
+		return;
+	}
+
+	if (matrix_is_affine(m) && matrix_is_affine(n)) {
+		matrix_multiply_affine(m, n);
+		return;
+	}
+
 	for (i = 0; i < 16; i++) {
 		tmp.d[i] = 0;
 		d = div(i, 4);
@@ -120,6 +173,18 @@ weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v)
 	int i, j;
 	struct weston_vector t;
 
+	if (matrix_is_affine(matrix)) {
+		for (i = 0; i < 3; i++)
+			t.f[i] = v->f[0] * matrix->d[i] +
+				 v->f[1] * matrix->d[i + 4] +
+				 v->f[2] * matrix->d[i + 8] +
+				 v->f[3] * matrix->d[i + 12];
+		t.f[3] = v->f[3];
+
+		*v = t;
+		return;
+	}
+
 	for (i = 0; i < 4; i++) {
 		t.f[i] = 0;
 		for (j = 0; j < 4; j++)
@@ -256,21 +321,166 @@ inverse_transform(const double *LU, const unsigned *p, float *v)
 		v[j] = b[j];
 }
 
+/* Matrices made of scalings and translations only have their factors on
+ * the diagonal and their offsets in the last column, so the inverse has
+ * a closed form. inverse may be matrix. */
+static int
+invert_scale_translate(struct weston_matrix *inverse,
+		       const struct weston_matrix *matrix)
+{
+	unsigned int type = matrix->type;
+	double sx = matrix->d[0];
+	double sy = matrix->d[5];
+	double sz = matrix->d[10];
+	double tx = matrix->d[12];
+	double ty = matrix->d[13];
+	double tz = matrix->d[14];
+
+	if (fabs(sx) < 1e-9 || fabs(sy) < 1e-9 || fabs(sz) < 1e-9)
+		return -1;
+
+	weston_matrix_init(inverse);
+	inverse->d[0] = 1.0 / sx;
+	inverse->d[5] = 1.0 / sy;
+	inverse->d[10] = 1.0 / sz;
+	inverse->d[12] = -tx / sx;
+	inverse->d[13] = -ty / sy;
+	inverse->d[14] = -tz / sz;
+	inverse->type = type;
+
+	return 0;
+}
+
+/* The inverse of an affine matrix is the inverse of its linear part,
+ * computed from the cofactors, and the opposite translation mapped
+ * through it. Nearly singular matrices are left to the LU decomposition,
+ * which decides on invertibility for all matrix types. inverse may be
+ * matrix. */
+static int
+invert_affine(struct weston_matrix *inverse,
+	      const struct weston_matrix *matrix)
+{
+	unsigned int type = matrix->type;
+	const float *m = matrix->d;
+	double t[3] = { m[12], m[13], m[14] };
+	double c[9], det;
+	unsigned r, k;
+
+	/* cofactors, transposed */
+	c[0] = (double)m[5] * m[10] - (double)m[9] * m[6];
+	c[1] = (double)m[9] * m[2] - (double)m[1] * m[10];
+	c[2] = (double)m[1] * m[6] - (double)m[5] * m[2];
+	c[3] = (double)m[8] * m[6] - (double)m[4] * m[10];
+	c[4] = (double)m[0] * m[10] - (double)m[8] * m[2];
+	c[5] = (double)m[4] * m[2] - (double)m[0] * m[6];
+	c[6] = (double)m[4] * m[9] - (double)m[8] * m[5];
+	c[7] = (double)m[8] * m[1] - (double)m[0] * m[9];
+	c[8] = (double)m[0] * m[5] - (double)m[4] * m[1];
+
+	det = m[0] * c[0] + m[4] * c[1] + m[8] * c[2];
+	if (fabs(det) < 1e-9)
+		return -1;
+
+	weston_matrix_init(inverse);
+	for (k = 0; k < 3; k++)
+		for (r = 0; r < 3; r++)
+			inverse->d[k * 4 + r] = c[k * 3 + r] / det;
+
+	for (r = 0; r < 3; r++)
+		inverse->d[12 + r] = -(c[r] * t[0] +
+				       c[3 + r] * t[1] +
+				       c[6 + r] * t[2]) / det;
+	inverse->type = type;
+
+	return 0;
+}
+
 WL_EXPORT int
 weston_matrix_invert(struct weston_matrix *inverse,
 		     const struct weston_matrix *matrix)
 {
+	unsigned int type = matrix->type;
 	double LU[16];		/* column-major */
 	unsigned perm[4];	/* permutation */
 	unsigned c;
 
+	switch (type) {
+	case 0:
+		weston_matrix_init(inverse);
+		return 0;
+	case WESTON_MATRIX_TRANSFORM_TRANSLATE:
+	case WESTON_MATRIX_TRANSFORM_SCALE:
+	case WESTON_MATRIX_TRANSFORM_SCALE | WESTON_MATRIX_TRANSFORM_TRANSLATE:
+		return invert_scale_translate(inverse, matrix);
+	}
+
+	if (matrix_is_affine(matrix) && invert_affine(inverse, matrix) == 0)
+		return 0;
+
 	if (matrix_invert(LU, perm, matrix) < 0)
 		return -1;
 
 	weston_matrix_init(inverse);
 	for (c = 0; c < 4; ++c)
 		inverse_transform(LU, perm, &inverse->d[c * 4]);
-	inverse->type = matrix->type;
+	inverse->type = type;
 
 	return 0;
 }
+
+/** Transform a rectangle and compute the bounding box of its corners
+ *
+ * \param matrix The transformation.
+ * \param box On input the rectangle as x1, y1, x2, y2 with z = 0, on output
+ * the bounding box of the transformed corners, in the same order.
+ * \return 0 on success, -1 if a corner has a vanishing w coordinate; that
+ * corner is then counted as the origin.
+ *
+ * Affine matrices skip the projective row, and those without rotation only
+ * transform two of the corners.
+ */
+WL_EXPORT int
+weston_matrix_transform_bbox(const struct weston_matrix *matrix, float box[4])
+{
+	const float *m = matrix->d;
+	float x[4] = { box[0], box[0], box[2], box[2] };
+	float y[4] = { box[1], box[3], box[1], box[3] };
+	float tx, ty, w;
+	int i, n = 4, ret = 0;
+
+	if (!(matrix->type & (WESTON_MATRIX_TRANSFORM_ROTATE |
+			      WESTON_MATRIX_TRANSFORM_OTHER))) {
+		/* the opposite corners stay opposite */
+		x[1] = box[2];
+		y[1] = box[3];
+		n = 2;
+	}
+
+	for (i = 0; i < n; i++) {
+		tx = x[i] * m[0] + y[i] * m[4] + m[12];
+		ty = x[i] * m[1] + y[i] * m[5] + m[13];
+
+		if (!matrix_is_affine(matrix)) {
+			w = x[i] * m[3] + y[i] * m[7] + m[15];
+			if (fabsf(w) < 1e-6) {
+				tx = 0;
+				ty = 0;
+				ret = -1;
+			} else {
+				tx /= w;
+				ty /= w;
+			}
+		}
+
+		if (i == 0 || tx < box[0])
+			box[0] = tx;
+		if (i == 0 || tx > box[2])
+			box[2] = tx;
+		if (i == 0 || ty < box[1])
+			box[1] = ty;
+		if (i == 0 || ty > box[3])
+			box[3] = ty;
+	}
+
+	return ret;
+}
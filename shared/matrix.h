@@ -38,6 +38,13 @@ enum weston_matrix_transform_type {
 	WESTON_MATRIX_TRANSFORM_OTHER		= (1 << 3),
 };
 
+/* type is the union of the transformations the matrix is made of, 0 for
+ * the identity; the weston_matrix functions maintain it. Code writing
+ * d[] directly must set it too, WESTON_MATRIX_TRANSFORM_OTHER when in
+ * doubt: weston_matrix_invert() picks a closed-form inverse from it, and
+ * multiplications skip identities and take matrices without
+ * WESTON_MATRIX_TRANSFORM_OTHER to have 0 0 0 1 as their last row, as do
+ * weston_matrix_transform() and weston_matrix_transform_bbox(). */
 struct weston_matrix {
 	float d[16];
 	unsigned int type;
@@ -64,6 +71,9 @@ weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v);
 int
 weston_matrix_invert(struct weston_matrix *inverse,
 		     const struct weston_matrix *matrix);
+int
+weston_matrix_transform_bbox(const struct weston_matrix *matrix,
+			     float box[4]);
 
 #ifdef UNIT_TEST
 #  define MATRIX_TEST_EXPORT WL_EXPORT
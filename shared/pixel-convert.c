@@ -0,0 +1,640 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "pixel-convert.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXEL_CONVERT_X86
+#include <immintrin.h>
+#define X86_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define PIXEL_CONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+/*
+ * The YUV conversion uses 16.16 fixed point factors. The luma factors add
+ * up to 65536, so Y never exceeds 255. The chroma differences are scaled
+ * by another 2^18 (and divided by 0.3 at full resolution), which the SIMD
+ * versions reproduce exactly, including the double precision division.
+ */
+#define Y_R 19595
+#define Y_G 38469
+#define Y_B 7472
+#define U_R 46727
+#define V_B 36962
+
+static inline int
+rgb_to_yuv(uint32_t p, bool xbgr, int *u, int *v)
+{
+	int r, g, b, y;
+
+	if (xbgr) {
+		r = (p >> 0) & 0xff;
+		b = (p >> 16) & 0xff;
+	} else {
+		r = (p >> 16) & 0xff;
+		b = (p >> 0) & 0xff;
+	}
+	g = (p >> 8) & 0xff;
+
+	y = (Y_R * r + Y_G * g + Y_B * b) >> 16;
+	if (y > 255)
+		y = 255;
+
+	*u += U_R * (r - y);
+	*v += V_B * (b - y);
+
+	return y;
+}
+
+static inline int
+clamp_uv(int u)
+{
+	int clamp = (u >> 18) + 128;
+
+	if (clamp < 0)
+		return 0;
+	else if (clamp > 255)
+		return 255;
+	else
+		return clamp;
+}
+
+static void
+swap_rb_scalar(uint32_t *dst, const uint32_t *src, int n)
+{
+	uint32_t v;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		v = src[i];
+		/*                A R G B */
+		dst[i] = (v & 0xff00ff00) |
+			 ((v >> 16) & 0x000000ff) |
+			 ((v << 16) & 0x00ff0000);
+	}
+}
+
+static void
+yuv444_scalar(uint8_t *y, uint8_t *u, uint8_t *v,
+	      const uint32_t *src, int n, bool xbgr)
+{
+	int i, u_accum, v_accum;
+
+	for (i = 0; i < n; i++) {
+		u_accum = 0;
+		v_accum = 0;
+		y[i] = rgb_to_yuv(src[i], xbgr, &u_accum, &v_accum);
+		u[i] = clamp_uv(u_accum / .3);
+		v[i] = clamp_uv(v_accum / .3);
+	}
+}
+
+static void
+yuv420_scalar(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+	      const uint32_t *src0, const uint32_t *src1, int n, bool xbgr)
+{
+	int i, u_accum, v_accum;
+
+	for (i = 0; i < n; i += 2) {
+		u_accum = 0;
+		v_accum = 0;
+		y0[i] = rgb_to_yuv(src0[i], xbgr, &u_accum, &v_accum);
+		y0[i + 1] = rgb_to_yuv(src0[i + 1], xbgr, &u_accum, &v_accum);
+		y1[i] = rgb_to_yuv(src1[i], xbgr, &u_accum, &v_accum);
+		y1[i + 1] = rgb_to_yuv(src1[i + 1], xbgr, &u_accum, &v_accum);
+		u[i / 2] = clamp_uv(u_accum);
+		v[i / 2] = clamp_uv(v_accum);
+	}
+}
+
+#ifdef PIXEL_CONVERT_X86
+
+/* Pack 8 chroma sums to bytes, with the same clamping as clamp_uv(). */
+X86_TARGET("sse2") static inline __m128i
+clamp_uv_sse2(__m128i a, __m128i b)
+{
+	const __m128i bias = _mm_set1_epi32(128);
+
+	a = _mm_add_epi32(_mm_srai_epi32(a, 18), bias);
+	b = _mm_add_epi32(_mm_srai_epi32(b, 18), bias);
+
+	return _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_setzero_si128());
+}
+
+/* Truncating division by 0.3 of 4 integers, as in (int) (x / .3). */
+X86_TARGET("sse2") static inline __m128i
+div_03_sse2(__m128i x)
+{
+	const __m128d k = _mm_set1_pd(.3);
+	__m128i lo, hi;
+
+	lo = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(x), k));
+	hi = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(_mm_srli_si128(x, 8)),
+					 k));
+
+	return _mm_unpacklo_epi64(lo, hi);
+}
+
+/* Convert 8 pixels to 8 Y samples in 16 bit lanes and the U and V terms
+ * of rgb_to_yuv() in 32 bit lanes. SSE2 has no 32 bit multiplication, so
+ * this uses pmaddwd on 16 bit channels; the factors that do not fit in a
+ * signed 16 bit lane are split in two. */
+X86_TARGET("sse2") static inline void
+yuv8_sse2(const uint32_t *src, bool xbgr, __m128i *y, __m128i u[2],
+	  __m128i v[2])
+{
+	const __m128i mask = _mm_set1_epi32(0xff);
+	const __m128i k_rg = _mm_set1_epi32(Y_R | 32767 << 16);
+	const __m128i k_gb = _mm_set1_epi32((Y_G - 32767) | Y_B << 16);
+	const __m128i k_u = _mm_set1_epi32(32767 | (U_R - 32767) << 16);
+	const __m128i k_v = _mm_set1_epi32(32767 | (V_B - 32767) << 16);
+	__m128i p0, p1, c0, g, c2, r, b, lo, hi, du, dv;
+
+	p0 = _mm_loadu_si128((const __m128i *) src);
+	p1 = _mm_loadu_si128((const __m128i *) (src + 4));
+
+	c0 = _mm_packs_epi32(_mm_and_si128(p0, mask),
+			     _mm_and_si128(p1, mask));
+	g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask),
+			    _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+	c2 = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask),
+			     _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+	r = xbgr ? c0 : c2;
+	b = xbgr ? c2 : c0;
+
+	lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r, g), k_rg),
+			   _mm_madd_epi16(_mm_unpacklo_epi16(g, b), k_gb));
+	hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r, g), k_rg),
+			   _mm_madd_epi16(_mm_unpackhi_epi16(g, b), k_gb));
+	*y = _mm_packs_epi32(_mm_srli_epi32(lo, 16), _mm_srli_epi32(hi, 16));
+
+	du = _mm_sub_epi16(r, *y);
+	dv = _mm_sub_epi16(b, *y);
+	u[0] = _mm_madd_epi16(_mm_unpacklo_epi16(du, du), k_u);
+	u[1] = _mm_madd_epi16(_mm_unpackhi_epi16(du, du), k_u);
+	v[0] = _mm_madd_epi16(_mm_unpacklo_epi16(dv, dv), k_v);
+	v[1] = _mm_madd_epi16(_mm_unpackhi_epi16(dv, dv), k_v);
+}
+
+/* Sum horizontal pairs of 8 integers. */
+X86_TARGET("sse2") static inline __m128i
+pair_sum_sse2(__m128i a, __m128i b)
+{
+	__m128 fa = _mm_castsi128_ps(a);
+	__m128 fb = _mm_castsi128_ps(b);
+
+	return _mm_add_epi32(
+		_mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0))),
+		_mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1))));
+}
+
+X86_TARGET("sse2") static inline void
+store4(uint8_t *dst, __m128i x)
+{
+	uint32_t w = _mm_cvtsi128_si32(x);
+
+	memcpy(dst, &w, sizeof w);
+}
+
+X86_TARGET("sse2") static void
+swap_rb_sse2(uint32_t *dst, const uint32_t *src, int n)
+{
+	const __m128i ag = _mm_set1_epi32(0xff00ff00);
+	const __m128i mask = _mm_set1_epi32(0xff);
+	__m128i p, q;
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		p = _mm_loadu_si128((const __m128i *) (src + i));
+		q = _mm_and_si128(p, ag);
+		q = _mm_or_si128(q, _mm_and_si128(_mm_srli_epi32(p, 16), mask));
+		q = _mm_or_si128(q, _mm_slli_epi32(_mm_and_si128(p, mask), 16));
+		_mm_storeu_si128((__m128i *) (dst + i), q);
+	}
+
+	swap_rb_scalar(dst + i, src + i, n - i);
+}
+
+X86_TARGET("sse2") static void
+yuv444_sse2(uint8_t *y, uint8_t *u, uint8_t *v,
+	    const uint32_t *src, int n, bool xbgr)
+{
+	__m128i py, pu[2], pv[2];
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		yuv8_sse2(src + i, xbgr, &py, pu, pv);
+		_mm_storel_epi64((__m128i *) (y + i),
+				 _mm_packus_epi16(py, py));
+		_mm_storel_epi64((__m128i *) (u + i),
+				 clamp_uv_sse2(div_03_sse2(pu[0]),
+					       div_03_sse2(pu[1])));
+		_mm_storel_epi64((__m128i *) (v + i),
+				 clamp_uv_sse2(div_03_sse2(pv[0]),
+					       div_03_sse2(pv[1])));
+	}
+
+	yuv444_scalar(y + i, u + i, v + i, src + i, n - i, xbgr);
+}
+
+X86_TARGET("sse2") static void
+yuv420_sse2(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+	    const uint32_t *src0, const uint32_t *src1, int n, bool xbgr)
+{
+	__m128i py0, pu0[2], pv0[2], py1, pu1[2], pv1[2], su, sv;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		yuv8_sse2(src0 + i, xbgr, &py0, pu0, pv0);
+		yuv8_sse2(src1 + i, xbgr, &py1, pu1, pv1);
+		_mm_storel_epi64((__m128i *) (y0 + i),
+				 _mm_packus_epi16(py0, py0));
+		_mm_storel_epi64((__m128i *) (y1 + i),
+				 _mm_packus_epi16(py1, py1));
+
+		su = pair_sum_sse2(_mm_add_epi32(pu0[0], pu1[0]),
+				   _mm_add_epi32(pu0[1], pu1[1]));
+		sv = pair_sum_sse2(_mm_add_epi32(pv0[0], pv1[0]),
+				   _mm_add_epi32(pv0[1], pv1[1]));
+		store4(u + i / 2, clamp_uv_sse2(su, su));
+		store4(v + i / 2, clamp_uv_sse2(sv, sv));
+	}
+
+	yuv420_scalar(y0 + i, y1 + i, u + i / 2, v + i / 2,
+		      src0 + i, src1 + i, n - i, xbgr);
+}
+
+/* Pack 8 integers in 0-255 to bytes. */
+X86_TARGET("avx2") static inline __m128i
+pack8_avx2(__m256i x)
+{
+	__m128i w = _mm_packs_epi32(_mm256_castsi256_si128(x),
+				    _mm256_extracti128_si256(x, 1));
+
+	return _mm_packus_epi16(w, w);
+}
+
+X86_TARGET("avx2") static inline __m128i
+div_03_avx2(__m128i x)
+{
+	return _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(x),
+						 _mm256_set1_pd(.3)));
+}
+
+/* Convert 8 pixels to Y samples and the U and V terms of rgb_to_yuv(),
+ * all in 32 bit lanes. */
+X86_TARGET("avx2") static inline void
+yuv8_avx2(const uint32_t *src, bool xbgr, __m256i *y, __m256i *u,
+	  __m256i *v)
+{
+	const __m256i mask = _mm256_set1_epi32(0xff);
+	__m256i p, c0, g, c2, r, b, sum;
+
+	p = _mm256_loadu_si256((const __m256i *) src);
+	c0 = _mm256_and_si256(p, mask);
+	g = _mm256_and_si256(_mm256_srli_epi32(p, 8), mask);
+	c2 = _mm256_and_si256(_mm256_srli_epi32(p, 16), mask);
+	r = xbgr ? c0 : c2;
+	b = xbgr ? c2 : c0;
+
+	sum = _mm256_add_epi32(
+		_mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(Y_R)),
+				 _mm256_mullo_epi32(g, _mm256_set1_epi32(Y_G))),
+		_mm256_mullo_epi32(b, _mm256_set1_epi32(Y_B)));
+	*y = _mm256_srli_epi32(sum, 16);
+
+	*u = _mm256_mullo_epi32(_mm256_sub_epi32(r, *y),
+				_mm256_set1_epi32(U_R));
+	*v = _mm256_mullo_epi32(_mm256_sub_epi32(b, *y),
+				_mm256_set1_epi32(V_B));
+}
+
+X86_TARGET("avx2") static void
+swap_rb_avx2(uint32_t *dst, const uint32_t *src, int n)
+{
+	const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+						 10, 9, 8, 11, 14, 13, 12, 15,
+						 2, 1, 0, 3, 6, 5, 4, 7,
+						 10, 9, 8, 11, 14, 13, 12, 15);
+	__m256i p;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		p = _mm256_loadu_si256((const __m256i *) (src + i));
+		_mm256_storeu_si256((__m256i *) (dst + i),
+				    _mm256_shuffle_epi8(p, shuffle));
+	}
+
+	swap_rb_scalar(dst + i, src + i, n - i);
+}
+
+X86_TARGET("avx2") static void
+yuv444_avx2(uint8_t *y, uint8_t *u, uint8_t *v,
+	    const uint32_t *src, int n, bool xbgr)
+{
+	__m256i py, pu, pv;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		yuv8_avx2(src + i, xbgr, &py, &pu, &pv);
+		_mm_storel_epi64((__m128i *) (y + i), pack8_avx2(py));
+		_mm_storel_epi64((__m128i *) (u + i),
+			clamp_uv_sse2(div_03_avx2(_mm256_castsi256_si128(pu)),
+				      div_03_avx2(_mm256_extracti128_si256(pu, 1))));
+		_mm_storel_epi64((__m128i *) (v + i),
+			clamp_uv_sse2(div_03_avx2(_mm256_castsi256_si128(pv)),
+				      div_03_avx2(_mm256_extracti128_si256(pv, 1))));
+	}
+
+	yuv444_scalar(y + i, u + i, v + i, src + i, n - i, xbgr);
+}
+
+/* Sum horizontal pairs of 16 integers. */
+X86_TARGET("avx2") static inline __m256i
+pair_sum_avx2(__m256i a, __m256i b)
+{
+	return _mm256_permute4x64_epi64(_mm256_hadd_epi32(a, b),
+					_MM_SHUFFLE(3, 1, 2, 0));
+}
+
+X86_TARGET("avx2") static void
+yuv420_avx2(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+	    const uint32_t *src0, const uint32_t *src1, int n, bool xbgr)
+{
+	__m256i py[4], pu[4], pv[4], su, sv;
+	int i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		yuv8_avx2(src0 + i, xbgr, &py[0], &pu[0], &pv[0]);
+		yuv8_avx2(src0 + i + 8, xbgr, &py[1], &pu[1], &pv[1]);
+		yuv8_avx2(src1 + i, xbgr, &py[2], &pu[2], &pv[2]);
+		yuv8_avx2(src1 + i + 8, xbgr, &py[3], &pu[3], &pv[3]);
+
+		_mm_storel_epi64((__m128i *) (y0 + i), pack8_avx2(py[0]));
+		_mm_storel_epi64((__m128i *) (y0 + i + 8), pack8_avx2(py[1]));
+		_mm_storel_epi64((__m128i *) (y1 + i), pack8_avx2(py[2]));
+		_mm_storel_epi64((__m128i *) (y1 + i + 8), pack8_avx2(py[3]));
+
+		su = pair_sum_avx2(_mm256_add_epi32(pu[0], pu[2]),
+				   _mm256_add_epi32(pu[1], pu[3]));
+		sv = pair_sum_avx2(_mm256_add_epi32(pv[0], pv[2]),
+				   _mm256_add_epi32(pv[1], pv[3]));
+		_mm_storel_epi64((__m128i *) (u + i / 2),
+				 clamp_uv_sse2(_mm256_castsi256_si128(su),
+					       _mm256_extracti128_si256(su, 1)));
+		_mm_storel_epi64((__m128i *) (v + i / 2),
+				 clamp_uv_sse2(_mm256_castsi256_si128(sv),
+					       _mm256_extracti128_si256(sv, 1)));
+	}
+
+	yuv420_scalar(y0 + i, y1 + i, u + i / 2, v + i / 2,
+		      src0 + i, src1 + i, n - i, xbgr);
+}
+
+#endif /* PIXEL_CONVERT_X86 */
+
+#ifdef PIXEL_CONVERT_NEON
+
+static inline uint8x8_t
+clamp_uv_neon(int32x4_t a, int32x4_t b)
+{
+	a = vaddq_s32(vshrq_n_s32(a, 18), vdupq_n_s32(128));
+	b = vaddq_s32(vshrq_n_s32(b, 18), vdupq_n_s32(128));
+
+	return vqmovun_s16(vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+}
+
+static inline int32x4_t
+div_03_neon(int32x4_t x)
+{
+	const float64x2_t k = vdupq_n_f64(.3);
+	int64x2_t lo, hi;
+
+	lo = vcvtq_s64_f64(vdivq_f64(vcvtq_f64_s64(vmovl_s32(vget_low_s32(x))),
+				     k));
+	hi = vcvtq_s64_f64(vdivq_f64(vcvtq_f64_s64(vmovl_high_s32(x)), k));
+
+	return vcombine_s32(vmovn_s64(lo), vmovn_s64(hi));
+}
+
+static inline void
+yuv4_neon(const uint32_t *src, bool xbgr, int32x4_t *y, int32x4_t *u,
+	  int32x4_t *v)
+{
+	const uint32x4_t mask = vdupq_n_u32(0xff);
+	uint32x4_t p = vld1q_u32(src);
+	int32x4_t c0, g, c2, r, b, sum;
+
+	c0 = vreinterpretq_s32_u32(vandq_u32(p, mask));
+	g = vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(p, 8), mask));
+	c2 = vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(p, 16), mask));
+	r = xbgr ? c0 : c2;
+	b = xbgr ? c2 : c0;
+
+	sum = vmulq_n_s32(r, Y_R);
+	sum = vmlaq_n_s32(sum, g, Y_G);
+	sum = vmlaq_n_s32(sum, b, Y_B);
+	*y = vshrq_n_s32(sum, 16);
+
+	*u = vmulq_n_s32(vsubq_s32(r, *y), U_R);
+	*v = vmulq_n_s32(vsubq_s32(b, *y), V_B);
+}
+
+static inline uint8x8_t
+pack8_neon(int32x4_t a, int32x4_t b)
+{
+	return vqmovun_s16(vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+}
+
+static inline void
+store4(uint8_t *dst, uint8x8_t x)
+{
+	uint32_t w = vget_lane_u32(vreinterpret_u32_u8(x), 0);
+
+	memcpy(dst, &w, sizeof w);
+}
+
+static void
+swap_rb_neon(uint32_t *dst, const uint32_t *src, int n)
+{
+	uint8x16x4_t p;
+	uint8x16_t t;
+	int i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		p = vld4q_u8((const uint8_t *) (src + i));
+		t = p.val[0];
+		p.val[0] = p.val[2];
+		p.val[2] = t;
+		vst4q_u8((uint8_t *) (dst + i), p);
+	}
+
+	swap_rb_scalar(dst + i, src + i, n - i);
+}
+
+static void
+yuv444_neon(uint8_t *y, uint8_t *u, uint8_t *v,
+	    const uint32_t *src, int n, bool xbgr)
+{
+	int32x4_t py[2], pu[2], pv[2];
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		yuv4_neon(src + i, xbgr, &py[0], &pu[0], &pv[0]);
+		yuv4_neon(src + i + 4, xbgr, &py[1], &pu[1], &pv[1]);
+		vst1_u8(y + i, pack8_neon(py[0], py[1]));
+		vst1_u8(u + i, clamp_uv_neon(div_03_neon(pu[0]),
+					     div_03_neon(pu[1])));
+		vst1_u8(v + i, clamp_uv_neon(div_03_neon(pv[0]),
+					     div_03_neon(pv[1])));
+	}
+
+	yuv444_scalar(y + i, u + i, v + i, src + i, n - i, xbgr);
+}
+
+static void
+yuv420_neon(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+	    const uint32_t *src0, const uint32_t *src1, int n, bool xbgr)
+{
+	int32x4_t py[4], pu[4], pv[4], su, sv;
+	int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		yuv4_neon(src0 + i, xbgr, &py[0], &pu[0], &pv[0]);
+		yuv4_neon(src0 + i + 4, xbgr, &py[1], &pu[1], &pv[1]);
+		yuv4_neon(src1 + i, xbgr, &py[2], &pu[2], &pv[2]);
+		yuv4_neon(src1 + i + 4, xbgr, &py[3], &pu[3], &pv[3]);
+
+		vst1_u8(y0 + i, pack8_neon(py[0], py[1]));
+		vst1_u8(y1 + i, pack8_neon(py[2], py[3]));
+
+		su = vpaddq_s32(vaddq_s32(pu[0], pu[2]),
+				vaddq_s32(pu[1], pu[3]));
+		sv = vpaddq_s32(vaddq_s32(pv[0], pv[2]),
+				vaddq_s32(pv[1], pv[3]));
+		store4(u + i / 2, clamp_uv_neon(su, su));
+		store4(v + i / 2, clamp_uv_neon(sv, sv));
+	}
+
+	yuv420_scalar(y0 + i, y1 + i, u + i / 2, v + i / 2,
+		      src0 + i, src1 + i, n - i, xbgr);
+}
+
+#endif /* PIXEL_CONVERT_NEON */
+
+static const struct pixel_convert_funcs impls[PIXEL_CONVERT_IMPL_COUNT] = {
+	[PIXEL_CONVERT_IMPL_SCALAR] = {
+		"scalar", swap_rb_scalar, yuv444_scalar, yuv420_scalar
+	},
+#ifdef PIXEL_CONVERT_X86
+	[PIXEL_CONVERT_IMPL_SSE2] = {
+		"sse2", swap_rb_sse2, yuv444_sse2, yuv420_sse2
+	},
+	[PIXEL_CONVERT_IMPL_AVX2] = {
+		"avx2", swap_rb_avx2, yuv444_avx2, yuv420_avx2
+	},
+#endif
+#ifdef PIXEL_CONVERT_NEON
+	[PIXEL_CONVERT_IMPL_NEON] = {
+		"neon", swap_rb_neon, yuv444_neon, yuv420_neon
+	},
+#endif
+};
+
+static bool
+impl_supported(enum pixel_convert_impl impl)
+{
+	switch (impl) {
+	case PIXEL_CONVERT_IMPL_SCALAR:
+		return true;
+#ifdef PIXEL_CONVERT_X86
+	case PIXEL_CONVERT_IMPL_SSE2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("sse2");
+	case PIXEL_CONVERT_IMPL_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+#endif
+#ifdef PIXEL_CONVERT_NEON
+	case PIXEL_CONVERT_IMPL_NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+/** Get a given implementation of the conversion kernels
+ *
+ * \param impl The implementation.
+ * \return The kernels, or NULL if the implementation was not built or the
+ * CPU does not support it.
+ */
+const struct pixel_convert_funcs *
+pixel_convert_get_impl(enum pixel_convert_impl impl)
+{
+	if (impl < 0 || impl >= PIXEL_CONVERT_IMPL_COUNT ||
+	    !impl_supported(impl))
+		return NULL;
+
+	return &impls[impl];
+}
+
+/** Get the fastest conversion kernels supported by the CPU
+ *
+ * Setting WESTON_PIXEL_CONVERT to the name of an implementation, e.g.
+ * "scalar", selects that one instead if it is supported.
+ */
+const struct pixel_convert_funcs *
+pixel_convert_get(void)
+{
+	const struct pixel_convert_funcs *funcs;
+	const char *name;
+	int i;
+
+	name = getenv("WESTON_PIXEL_CONVERT");
+	for (i = PIXEL_CONVERT_IMPL_COUNT - 1; name && i >= 0; i--) {
+		funcs = pixel_convert_get_impl(i);
+		if (funcs && strcmp(funcs->name, name) == 0)
+			return funcs;
+	}
+
+	for (i = PIXEL_CONVERT_IMPL_COUNT - 1; i >= 0; i--) {
+		funcs = pixel_convert_get_impl(i);
+		if (funcs)
+			return funcs;
+	}
+
+	return &impls[PIXEL_CONVERT_IMPL_SCALAR];
+}
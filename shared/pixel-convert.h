@@ -0,0 +1,77 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_PIXEL_CONVERT_H
+#define WESTON_PIXEL_CONVERT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Row conversion kernels for 32-bit pixels, used by the screenshooter and
+ * the wcap tools. Every implementation produces exactly the same output
+ * as the scalar one.
+ */
+
+enum pixel_convert_impl {
+	PIXEL_CONVERT_IMPL_SCALAR = 0,
+	PIXEL_CONVERT_IMPL_SSE2,
+	PIXEL_CONVERT_IMPL_AVX2,
+	PIXEL_CONVERT_IMPL_NEON,
+	PIXEL_CONVERT_IMPL_COUNT
+};
+
+struct pixel_convert_funcs {
+	const char *name;
+
+	/* Copy n pixels, exchanging their first and third byte (red and
+	 * blue, for the 8888 formats). dst and src may be the same. */
+	void (*swap_rb)(uint32_t *dst, const uint32_t *src, int n);
+
+	/* Convert n x8r8g8b8 pixels, or x8b8g8r8 if xbgr is set, to one
+	 * Y, U and V sample each. */
+	void (*yuv444)(uint8_t *y, uint8_t *u, uint8_t *v,
+		       const uint32_t *src, int n, bool xbgr);
+
+	/* Convert two rows of n pixels, n even, to Y samples and one U
+	 * and V sample per 2x2 block. */
+	void (*yuv420)(uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v,
+		       const uint32_t *src0, const uint32_t *src1,
+		       int n, bool xbgr);
+};
+
+const struct pixel_convert_funcs *
+pixel_convert_get_impl(enum pixel_convert_impl impl);
+
+const struct pixel_convert_funcs *
+pixel_convert_get(void);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* WESTON_PIXEL_CONVERT_H */
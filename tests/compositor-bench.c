@@ -0,0 +1,383 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Compositor frame time benchmark.
+ *
+ * Every scenario maps a set of synthetic surfaces, then commits new
+ * content to all of them once per frame and waits for the frame
+ * callback. The compositor runs free running on the headless backend, so
+ * frames are drawn as fast as the pixman renderer allows, and reports
+ * the time spent in each repaint stage through weston_test.
+ *
+ * Results are printed as one JSON object per scenario and line, and
+ * appended to the file named by WESTON_BENCH_OUTPUT if it is set.
+ */
+
+#include "config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "weston-test-client-helper.h"
+
+char *server_parameters = "--use-pixman --width=1280 --height=720 "
+			  "--free-running";
+
+#define WARMUP_FRAMES 20
+#define BENCH_FRAMES 300
+
+struct bench_scenario {
+	const char *name;
+	int n_surfaces;
+	int n_subsurfaces;	/* per surface */
+	int size;		/* in surface coordinates */
+	bool alpha;
+	enum wl_output_transform transform;
+	int scale;
+	int damage_size;	/* 0 for full damage */
+};
+
+static const struct bench_scenario scenarios[] = {
+	{ "opaque", 64, 0, 128, false, WL_OUTPUT_TRANSFORM_NORMAL, 1, 0 },
+	{ "alpha", 64, 0, 128, true, WL_OUTPUT_TRANSFORM_NORMAL, 1, 0 },
+	{ "subsurfaces", 16, 4, 128, true, WL_OUTPUT_TRANSFORM_NORMAL, 1, 0 },
+	{ "transformed", 64, 0, 128, false, WL_OUTPUT_TRANSFORM_90, 2, 0 },
+	{ "partial-damage", 64, 0, 128, true, WL_OUTPUT_TRANSFORM_NORMAL, 1, 16 },
+	{ "many-small", 1024, 0, 16, true, WL_OUTPUT_TRANSFORM_NORMAL, 1, 0 },
+};
+
+struct bench_surface {
+	struct wl_surface *wl_surface;
+	struct wl_subsurface *wl_subsurface;
+	struct buffer *buffer;
+};
+
+struct bench {
+	struct client *client;
+	const struct bench_scenario *scenario;
+	struct wl_subcompositor *subcompositor;
+	struct bench_surface *surfaces;	/* parents then children */
+	int n_surfaces;
+};
+
+static const struct {
+	const char *name;
+	size_t offset;
+} stages[] = {
+	{ "build_view_list", offsetof(struct repaint_profile, view_list) },
+	{ "assign_planes", offsetof(struct repaint_profile, assign_planes) },
+	{ "accumulate_damage",
+	  offsetof(struct repaint_profile, accumulate_damage) },
+	{ "render", offsetof(struct repaint_profile, render) },
+	{ "frame_callbacks", offsetof(struct repaint_profile, frame_callbacks) },
+};
+
+static struct wl_subcompositor *
+get_subcompositor(struct client *client)
+{
+	struct global *g;
+	struct global *global_sub = NULL;
+	struct wl_subcompositor *sub;
+
+	wl_list_for_each(g, &client->global_list, link) {
+		if (strcmp(g->interface, "wl_subcompositor"))
+			continue;
+
+		if (global_sub)
+			assert(0 && "multiple wl_subcompositor objects");
+
+		global_sub = g;
+	}
+
+	assert(global_sub && "no wl_subcompositor found");
+
+	sub = wl_registry_bind(client->wl_registry, global_sub->name,
+			       &wl_subcompositor_interface, 1);
+	assert(sub);
+
+	return sub;
+}
+
+static void
+bench_surface_init(struct bench *bench, struct bench_surface *bs,
+		   struct wl_surface *parent, int x, int y)
+{
+	const struct bench_scenario *scenario = bench->scenario;
+	struct client *client = bench->client;
+	int size = scenario->size * scenario->scale;
+	pixman_color_t color;
+	pixman_image_t *solid;
+	struct wl_region *region;
+
+	bs->wl_surface = wl_compositor_create_surface(client->wl_compositor);
+	assert(bs->wl_surface);
+
+	/* premultiplied, a shade of grey that varies per surface */
+	color.alpha = scenario->alpha ? 0x8000 : 0xffff;
+	color.red = color.green = color.blue =
+		(color.alpha / 2 + (x + y) * 16) % color.alpha;
+
+	bs->buffer = create_shm_buffer_a8r8g8b8(client, size, size);
+	solid = pixman_image_create_solid_fill(&color);
+	pixman_image_composite32(PIXMAN_OP_SRC, solid, NULL,
+				 bs->buffer->image,
+				 0, 0, 0, 0, 0, 0, size, size);
+	pixman_image_unref(solid);
+
+	if (!scenario->alpha) {
+		region = wl_compositor_create_region(client->wl_compositor);
+		wl_region_add(region, 0, 0, scenario->size, scenario->size);
+		wl_surface_set_opaque_region(bs->wl_surface, region);
+		wl_region_destroy(region);
+	}
+
+	wl_surface_set_buffer_transform(bs->wl_surface, scenario->transform);
+	wl_surface_set_buffer_scale(bs->wl_surface, scenario->scale);
+
+	if (parent) {
+		bs->wl_subsurface =
+			wl_subcompositor_get_subsurface(bench->subcompositor,
+							bs->wl_surface,
+							parent);
+		wl_subsurface_set_position(bs->wl_subsurface, x, y);
+	} else {
+		weston_test_move_surface(client->test->weston_test,
+					 bs->wl_surface, x, y);
+	}
+}
+
+static void
+bench_init(struct bench *bench, const struct bench_scenario *scenario)
+{
+	struct output *output;
+	struct bench_surface *parent;
+	int columns, step, i, j, x, y;
+
+	memset(bench, 0, sizeof *bench);
+	bench->scenario = scenario;
+	bench->client = create_client();
+	bench->subcompositor = get_subcompositor(bench->client);
+	bench->n_surfaces =
+		scenario->n_surfaces * (1 + scenario->n_subsurfaces);
+	bench->surfaces = xzalloc(bench->n_surfaces * sizeof *bench->surfaces);
+
+	/* Spread the surfaces over the output, overlapping when there are
+	 * too many of them to fit. */
+	output = bench->client->output;
+	step = scenario->size / 2;
+	columns = MAX((output->width - scenario->size) / step, 1);
+
+	for (i = 0; i < scenario->n_surfaces; i++) {
+		x = (i % columns) * step;
+		y = (i / columns * step) % MAX(output->height - scenario->size, 1);
+		bench_surface_init(bench, &bench->surfaces[i], NULL, x, y);
+	}
+
+	for (i = 0; i < scenario->n_surfaces; i++) {
+		parent = &bench->surfaces[i];
+		for (j = 0; j < scenario->n_subsurfaces; j++) {
+			x = (j + 1) * scenario->size / 4;
+			bench_surface_init(bench,
+					   &bench->surfaces[scenario->n_surfaces +
+							    i * scenario->n_subsurfaces + j],
+					   parent->wl_surface, x, x);
+		}
+	}
+}
+
+static void
+bench_release(struct bench *bench)
+{
+	struct bench_surface *bs;
+	int i;
+
+	for (i = bench->n_surfaces - 1; i >= 0; i--) {
+		bs = &bench->surfaces[i];
+		if (bs->wl_subsurface)
+			wl_subsurface_destroy(bs->wl_subsurface);
+		wl_surface_destroy(bs->wl_surface);
+		buffer_destroy(bs->buffer);
+	}
+
+	free(bench->surfaces);
+	wl_subcompositor_destroy(bench->subcompositor);
+}
+
+/* Commit new content to every surface and wait for the next frame. */
+static void
+bench_frame(struct bench *bench, int frame)
+{
+	const struct bench_scenario *scenario = bench->scenario;
+	struct bench_surface *bs;
+	int damage = scenario->damage_size;
+	int done, i, pos;
+
+	/* children first, their state is applied on the parent commit */
+	for (i = bench->n_surfaces - 1; i >= 0; i--) {
+		bs = &bench->surfaces[i];
+
+		wl_surface_attach(bs->wl_surface, bs->buffer->proxy, 0, 0);
+		if (damage > 0) {
+			pos = (frame * damage) % (scenario->size - damage + 1);
+			wl_surface_damage(bs->wl_surface, pos, pos,
+					  damage, damage);
+		} else {
+			wl_surface_damage(bs->wl_surface, 0, 0,
+					  scenario->size, scenario->size);
+		}
+
+		if (i == 0)
+			frame_callback_set(bs->wl_surface, &done);
+
+		wl_surface_commit(bs->wl_surface);
+	}
+
+	frame_callback_wait(bench->client, &done);
+}
+
+static int
+compare_uint32(const void *a, const void *b)
+{
+	uint32_t ua = *(const uint32_t *) a;
+	uint32_t ub = *(const uint32_t *) b;
+
+	return (ua > ub) - (ua < ub);
+}
+
+static void
+print_stage(FILE *fp, const char *name, uint32_t *samples, int n)
+{
+	uint64_t sum = 0;
+	int i;
+
+	qsort(samples, n, sizeof *samples, compare_uint32);
+	for (i = 0; i < n; i++)
+		sum += samples[i];
+
+	fprintf(fp, "\"%s\":{\"mean_us\":%.3f,\"p50_us\":%.3f,"
+		"\"p99_us\":%.3f,\"max_us\":%.3f}",
+		name, sum / 1000.0 / n, samples[n / 2] / 1000.0,
+		samples[(n - 1) * 99 / 100] / 1000.0, samples[n - 1] / 1000.0);
+}
+
+/* Without the region arenas, every heap region would have been one
+ * allocation. */
+static void
+print_regions(FILE *fp, struct repaint_profile *profiles, int n)
+{
+	double regions = 0, heap_regions = 0, allocs = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		regions += profiles[i].regions;
+		heap_regions += profiles[i].heap_regions;
+		allocs += profiles[i].region_allocs;
+	}
+
+	fprintf(fp, "\"regions\":{\"mean\":%.1f,\"heap_mean\":%.1f,"
+		"\"allocs_mean\":%.1f}", regions / n, heap_regions / n,
+		allocs / n);
+}
+
+static void
+print_results(FILE *fp, struct bench *bench,
+	      struct repaint_profile *profiles, int n)
+{
+	const struct bench_scenario *scenario = bench->scenario;
+	uint32_t *samples, *total;
+	unsigned int s;
+	int i;
+
+	fprintf(fp, "{\"benchmark\":\"%s\",\"surfaces\":%d,"
+		"\"subsurfaces\":%d,\"size\":%d,\"alpha\":%s,"
+		"\"transform\":%d,\"scale\":%d,\"damage_size\":%d,"
+		"\"frames\":%d,\"repaints\":%d,\"stages\":{",
+		scenario->name, scenario->n_surfaces, scenario->n_subsurfaces,
+		scenario->size, scenario->alpha ? "true" : "false",
+		scenario->transform, scenario->scale, scenario->damage_size,
+		BENCH_FRAMES, n);
+
+	samples = xzalloc(n * sizeof *samples);
+	total = xzalloc(n * sizeof *total);
+	for (s = 0; s < ARRAY_LENGTH(stages); s++) {
+		for (i = 0; i < n; i++) {
+			samples[i] = *(uint32_t *) ((char *) &profiles[i] +
+						    stages[s].offset);
+			total[i] += samples[i];
+		}
+
+		print_stage(fp, stages[s].name, samples, n);
+		fprintf(fp, ",");
+	}
+	print_stage(fp, "total", total, n);
+	free(samples);
+	free(total);
+
+	fprintf(fp, "},");
+	print_regions(fp, profiles, n);
+	fprintf(fp, "}\n");
+}
+
+TEST_P(compositor_bench, scenarios)
+{
+	const struct bench_scenario *scenario = data;
+	struct bench bench;
+	struct test *test;
+	const char *path;
+	FILE *fp;
+	int n, i;
+
+	bench_init(&bench, scenario);
+	test = bench.client->test;
+
+	for (i = 0; i < WARMUP_FRAMES; i++)
+		bench_frame(&bench, i);
+
+	weston_test_profile_repaint(test->weston_test, 1);
+	for (i = 0; i < BENCH_FRAMES; i++)
+		bench_frame(&bench, WARMUP_FRAMES + i);
+	weston_test_profile_repaint(test->weston_test, 0);
+	client_roundtrip(bench.client);
+
+	n = test->repaint_profiles.size / sizeof(struct repaint_profile);
+	assert(n > 0);
+
+	print_results(stdout, &bench, test->repaint_profiles.data, n);
+
+	path = getenv("WESTON_BENCH_OUTPUT");
+	if (path) {
+		fp = fopen(path, "a");
+		assert(fp);
+		print_results(fp, &bench, test->repaint_profiles.data, n);
+		fclose(fp);
+	}
+
+	bench_release(&bench);
+}
@@ -0,0 +1,108 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "compositor.h"
+#include "shared/helpers.h"
+
+static int moves;
+static struct weston_view *moved_view;
+
+static int
+fake_move_cursor(struct weston_output *output, struct weston_view *view)
+{
+	moves++;
+	moved_view = view;
+
+	return 0;
+}
+
+static void
+cursor_update(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct weston_subsurface sub = { 0 };
+	struct weston_output *output;
+	struct weston_surface *surface;
+	struct weston_view *view;
+
+	assert(!wl_list_empty(&compositor->output_list));
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+	output->move_cursor = fake_move_cursor;
+
+	surface = weston_surface_create(compositor);
+	assert(surface);
+	view = weston_view_create(surface);
+	assert(view);
+	surface->width = 32;
+	surface->height = 32;
+	weston_layer_entry_insert(&compositor->cursor_layer.view_list,
+				  &view->layer_link);
+	weston_view_set_position(view, 10, 10);
+
+	/* Only the sprite moves. */
+	wl_list_for_each(view, &compositor->view_list, link)
+		weston_view_update_transform(view);
+	view = container_of(surface->views.next, struct weston_view,
+			    surface_link);
+	weston_view_update_transform(view);
+	assert(view->output_mask == 1u << output->id);
+
+	/* A bare sprite takes the fast path. */
+	weston_view_set_position(view, 20, 30);
+	assert(weston_output_update_cursors(output) == 0);
+	assert(moves == 1);
+	assert(moved_view == view);
+	assert(!view->transform.dirty);
+	assert(view->geometry.x == 20 && view->geometry.y == 30);
+
+	/* A sprite with a sub-surface, whose view is not in the cursor
+	 * layer, is repainted instead. */
+	wl_list_insert(&surface->subsurface_list, &sub.parent_link);
+	weston_view_set_position(view, 40, 50);
+	assert(weston_output_update_cursors(output) < 0);
+	assert(moves == 1);
+	wl_list_remove(&sub.parent_link);
+	wl_list_init(&surface->subsurface_list);
+
+	output->move_cursor = NULL;
+	weston_surface_destroy(surface);
+
+	wl_display_terminate(compositor->wl_display);
+}
+
+WL_EXPORT int
+module_init(struct weston_compositor *compositor, int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, cursor_update, compositor);
+
+	return 0;
+}
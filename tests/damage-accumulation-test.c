@@ -0,0 +1,179 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <assert.h>
+#include <time.h>
+
+#include "compositor.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+
+#define N_PLANES 3	/* on top of the primary plane */
+#define GRID_SIZE 32	/* views per row and column */
+#define VIEW_SIZE 32
+#define N_VIEWS (GRID_SIZE * GRID_SIZE)
+#define N_FRAMES 200
+
+static struct weston_plane *
+view_plane(struct weston_compositor *compositor,
+	   struct weston_plane *planes, int i)
+{
+	if (i % (N_PLANES + 1) == N_PLANES)
+		return &compositor->primary_plane;
+
+	return &planes[i % (N_PLANES + 1)];
+}
+
+static void
+damage_all_surfaces(struct weston_surface **surfaces)
+{
+	int i;
+
+	for (i = 0; i < N_VIEWS; i++)
+		pixman_region32_union_rect(&surfaces[i]->damage,
+					   &surfaces[i]->damage,
+					   0, 0, VIEW_SIZE, VIEW_SIZE);
+}
+
+static void
+check_planes(struct weston_compositor *compositor,
+	     struct weston_plane *planes, struct weston_view **views)
+{
+	pixman_box32_t *box;
+	struct weston_plane *plane;
+	bool above;
+	int i, p;
+
+	for (i = 0; i < N_VIEWS; i++) {
+		plane = view_plane(compositor, planes, i);
+		box = pixman_region32_extents(&views[i]->transform.boundingbox);
+
+		/* The damage of a view ends up on its own plane... */
+		assert(pixman_region32_contains_rectangle(&plane->damage, box) ==
+		       PIXMAN_REGION_IN);
+
+		/* ...and the view clips the planes stacked below it, but not
+		 * those above. planes[] is in stacking order, top first. */
+		above = true;
+		for (p = 0; p < N_PLANES; p++) {
+			if (&planes[p] == plane) {
+				above = false;
+				continue;
+			}
+			assert(pixman_region32_contains_rectangle(&planes[p].clip,
+								  box) ==
+			       (above ? PIXMAN_REGION_OUT : PIXMAN_REGION_IN));
+		}
+
+		if (plane != &compositor->primary_plane)
+			assert(pixman_region32_contains_rectangle(
+					&compositor->primary_plane.clip, box) ==
+			       PIXMAN_REGION_IN);
+	}
+}
+
+static void
+damage_accumulation(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct weston_plane planes[N_PLANES];
+	struct weston_surface *surfaces[N_VIEWS];
+	struct weston_view *views[N_VIEWS];
+	struct weston_plane *plane;
+	struct timespec begin, end;
+	int64_t nsec;
+	int i;
+
+	for (i = 0; i < N_PLANES; i++) {
+		weston_plane_init(&planes[i], compositor, 0, 0);
+		weston_compositor_stack_plane(compositor, &planes[i],
+					      &compositor->primary_plane);
+	}
+
+	for (i = 0; i < N_VIEWS; i++) {
+		surfaces[i] = weston_surface_create(compositor);
+		assert(surfaces[i]);
+		views[i] = weston_view_create(surfaces[i]);
+		assert(views[i]);
+
+		surfaces[i]->width = VIEW_SIZE;
+		surfaces[i]->height = VIEW_SIZE;
+		pixman_region32_union_rect(&surfaces[i]->opaque,
+					   &surfaces[i]->opaque,
+					   0, 0, VIEW_SIZE, VIEW_SIZE);
+
+		weston_view_set_position(views[i],
+					 (i % GRID_SIZE) * VIEW_SIZE,
+					 (i / GRID_SIZE) * VIEW_SIZE);
+		weston_view_update_transform(views[i]);
+		views[i]->plane = view_plane(compositor, planes, i);
+
+		wl_list_insert(compositor->view_list.prev, &views[i]->link);
+	}
+
+	damage_all_surfaces(surfaces);
+	weston_compositor_accumulate_damage(compositor);
+	check_planes(compositor, planes, views);
+
+	nsec = 0;
+	for (i = 0; i < N_FRAMES; i++) {
+		wl_list_for_each(plane, &compositor->plane_list, link)
+			pixman_region32_clear(&plane->damage);
+		damage_all_surfaces(surfaces);
+
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		weston_compositor_accumulate_damage(compositor);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		timespec_sub(&end, &end, &begin);
+		nsec += timespec_to_nsec(&end);
+	}
+
+	fprintf(stderr, "accumulate damage: %d views, %d planes: "
+		"%.1f us per frame\n", N_VIEWS, N_PLANES + 1,
+		nsec / 1000.0 / N_FRAMES);
+
+	for (i = 0; i < N_VIEWS; i++)
+		weston_surface_destroy(surfaces[i]);
+
+	for (i = 0; i < N_PLANES; i++)
+		weston_plane_release(&planes[i]);
+
+	wl_display_terminate(compositor->wl_display);
+}
+
+WL_EXPORT int
+module_init(struct weston_compositor *compositor, int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, damage_accumulation, compositor);
+
+	return 0;
+}
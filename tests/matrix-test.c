@@ -27,6 +27,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <unistd.h>
 #include <signal.h>
@@ -243,6 +244,120 @@ test(void)
 	return TEST_FAIL;
 }
 
+/* Check the closed-form inverses of weston_matrix_invert() against the
+ * LU decomposition. */
+static int
+test_fast_paths(void)
+{
+	struct weston_matrix m, fast, lu, in_place;
+	double err, errsup = 0.0;
+	unsigned i, k;
+
+	for (k = 0; k < 1000; ++k) {
+		weston_matrix_init(&m);
+		if (k % 3 != 1)
+			weston_matrix_translate(&m, frand() * 1000.0,
+						frand() * 1000.0, frand());
+		if (k % 3 != 0)
+			weston_matrix_scale(&m, frand() * 8.0,
+					    frand() * 8.0, 1.0);
+		if (k % 5 == 0)
+			weston_matrix_translate(&m, frand() * 100.0,
+						frand() * 100.0, 0.0);
+		if (k % 7 == 0)
+			weston_matrix_rotate_xy(&m, cos(k), sin(k));
+
+		if (weston_matrix_invert(&fast, &m) != 0)
+			continue;
+
+		in_place = m;
+		weston_matrix_invert(&in_place, &in_place);
+		if (memcmp(&in_place, &fast, sizeof fast) != 0) {
+			printf("in-place inverse differs\n");
+			return TEST_FAIL;
+		}
+
+		m.type |= WESTON_MATRIX_TRANSFORM_OTHER;
+		if (weston_matrix_invert(&lu, &m) != 0) {
+			printf("fast path inverted a singular matrix\n");
+			return TEST_FAIL;
+		}
+
+		for (i = 0; i < 16; ++i) {
+			err = fabs(fast.d[i] - lu.d[i]) /
+			      fmax(1.0, fabs(lu.d[i]));
+			if (err > errsup)
+				errsup = err;
+		}
+	}
+
+	printf("fast path inverse, max relative error: %g\n", errsup);
+
+	return errsup < 1e-6 ? TEST_OK : TEST_FAIL;
+}
+
+/* Check weston_matrix_transform_bbox() against the corners transformed
+ * one by one. */
+static int
+test_bbox(void)
+{
+	struct weston_matrix m;
+	struct weston_vector v;
+	float box[4], expected[4], x, y;
+	unsigned i, k;
+
+	for (k = 0; k < 1000; ++k) {
+		weston_matrix_init(&m);
+		weston_matrix_translate(&m, frand() * 1000.0,
+					frand() * 1000.0, 0.0);
+		if (k % 2)
+			weston_matrix_scale(&m, frand() * 8.0,
+					    frand() * 8.0, 1.0);
+		if (k % 3 == 0)
+			weston_matrix_rotate_xy(&m, cos(k), sin(k));
+		if (k % 5 == 0) {
+			m.d[3] = frand() * 1e-3;
+			m.d[7] = frand() * 1e-3;
+			m.type |= WESTON_MATRIX_TRANSFORM_OTHER;
+		}
+
+		box[0] = frand() * 500.0;
+		box[1] = frand() * 500.0;
+		box[2] = box[0] + fabs(frand()) * 500.0;
+		box[3] = box[1] + fabs(frand()) * 500.0;
+
+		expected[0] = expected[1] = INFINITY;
+		expected[2] = expected[3] = -INFINITY;
+		for (i = 0; i < 4; ++i) {
+			v.f[0] = box[(i & 1) ? 2 : 0];
+			v.f[1] = box[(i & 2) ? 3 : 1];
+			v.f[2] = 0.0;
+			v.f[3] = 1.0;
+			weston_matrix_transform(&m, &v);
+			x = v.f[0] / v.f[3];
+			y = v.f[1] / v.f[3];
+			expected[0] = fmin(expected[0], x);
+			expected[1] = fmin(expected[1], y);
+			expected[2] = fmax(expected[2], x);
+			expected[3] = fmax(expected[3], y);
+		}
+
+		if (weston_matrix_transform_bbox(&m, box) != 0)
+			return TEST_FAIL;
+
+		for (i = 0; i < 4; ++i) {
+			if (fabs(box[i] - expected[i]) >
+			    1e-4 * fmax(1.0, fabs(expected[i]))) {
+				printf("bbox test fail, %g != %g\n",
+				       box[i], expected[i]);
+				return TEST_FAIL;
+			}
+		}
+	}
+
+	return TEST_OK;
+}
+
 static int running;
 static void
 stopme(int n)
@@ -356,7 +471,9 @@ test_loop_speed_invert_explicit(void)
 
 	printf("\nRunning 3 s test on weston_matrix_invert()...\n");
 
+	/* an identity of unknown type, to time the LU decomposition */
 	weston_matrix_init(&m);
+	m.type = WESTON_MATRIX_TRANSFORM_OTHER;
 
 	running = 1;
 	alarm(3);
@@ -414,6 +531,9 @@ int main(void)
 	print_matrix(&M);
 	printf("max abs error: %g, original determinant %g\n", errsup, det);
 
+	if (test_fast_paths() != TEST_OK || test_bbox() != TEST_OK)
+		return 1;
+
 	test_loop_precision();
 	test_loop_speed_matrixvector();
 	test_loop_speed_inversetransform();
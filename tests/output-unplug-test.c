@@ -0,0 +1,82 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "weston-test-client-helper.h"
+
+static void
+wait_repaint(struct client *client)
+{
+	size_t size = client->test->repaint_profiles.size;
+
+	while (client->test->repaint_profiles.size == size)
+		assert(wl_display_dispatch(client->wl_display) >= 0);
+}
+
+static void
+request_frame(struct client *client)
+{
+	struct wl_callback *callback;
+	int done;
+
+	callback = frame_callback_set(client->surface->wl_surface, &done);
+	wl_surface_commit(client->surface->wl_surface);
+	client_roundtrip(client);
+
+	/* Hidden surfaces get no frame events. */
+	assert(!done);
+	wl_callback_destroy(callback);
+}
+
+/* Destroys the only output of the compositor, so this is the only test
+ * of this file. */
+TEST(unplug_output_under_hidden_surface)
+{
+	struct client *client;
+	struct weston_test *weston_test;
+
+	client = create_client_and_test_surface(46, 76, 111, 134);
+	assert(client);
+	weston_test = client->test->weston_test;
+	assert(client->surface->output == client->output);
+
+	/* Take the surface off the view list, it keeps its output. */
+	weston_test_set_surfaces_hidden(weston_test, 1);
+	weston_test_profile_repaint(weston_test, 1);
+	wait_repaint(client);
+	weston_test_profile_repaint(weston_test, 0);
+
+	request_frame(client);
+
+	weston_test_destroy_output(weston_test, client->output->wl_output);
+	client_roundtrip(client);
+
+	/* The surface left the output although it is not on screen... */
+	assert(client->surface->output == NULL);
+
+	/* ...and its next frame request does not go to the dead output. */
+	request_frame(client);
+}
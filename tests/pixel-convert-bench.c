@@ -0,0 +1,157 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Pixel conversion kernel benchmark.
+ *
+ * Converts a 4K frame with every kernel of every implementation supported
+ * by the CPU. Results are printed as one JSON object per kernel and line,
+ * and appended to the file named by WESTON_BENCH_OUTPUT if it is set.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "shared/pixel-convert.h"
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+
+#define WIDTH 3840
+#define HEIGHT 2160
+#define ITERATIONS 20
+
+enum kernel {
+	KERNEL_SWAP_RB,
+	KERNEL_YUV444,
+	KERNEL_YUV420,
+};
+
+static const char *kernel_names[] = {
+	"swap_rb", "yuv444", "yuv420",
+};
+
+static void
+run_kernel(const struct pixel_convert_funcs *funcs, enum kernel kernel,
+	   uint32_t *src, uint32_t *dst, uint8_t *yuv)
+{
+	uint8_t *u = yuv + WIDTH * HEIGHT;
+	uint8_t *v = u + WIDTH * HEIGHT;
+	int i;
+
+	switch (kernel) {
+	case KERNEL_SWAP_RB:
+		funcs->swap_rb(dst, src, WIDTH * HEIGHT);
+		break;
+	case KERNEL_YUV444:
+		for (i = 0; i < HEIGHT; i++)
+			funcs->yuv444(yuv + i * WIDTH, u + i * WIDTH,
+				      v + i * WIDTH, src + i * WIDTH,
+				      WIDTH, false);
+		break;
+	case KERNEL_YUV420:
+		for (i = 0; i < HEIGHT; i += 2)
+			funcs->yuv420(yuv + i * WIDTH, yuv + (i + 1) * WIDTH,
+				      u + i / 2 * WIDTH / 2,
+				      v + i / 2 * WIDTH / 2,
+				      src + i * WIDTH, src + (i + 1) * WIDTH,
+				      WIDTH, false);
+		break;
+	}
+}
+
+static void
+print_result(FILE *fp, const char *impl, const char *kernel, double ms)
+{
+	fprintf(fp, "{\"benchmark\":\"pixel-convert\",\"impl\":\"%s\","
+		"\"kernel\":\"%s\",\"width\":%d,\"height\":%d,"
+		"\"mean_ms\":%.3f,\"mpix_per_s\":%.1f}\n",
+		impl, kernel, WIDTH, HEIGHT, ms,
+		WIDTH * HEIGHT / ms / 1000.0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const struct pixel_convert_funcs *funcs;
+	struct timespec begin, end;
+	uint32_t *src, *dst;
+	uint8_t *yuv;
+	const char *path;
+	FILE *fp = NULL;
+	double ms;
+	int impl, kernel, i;
+
+	src = xmalloc(WIDTH * HEIGHT * sizeof *src);
+	dst = xmalloc(WIDTH * HEIGHT * sizeof *dst);
+	yuv = xmalloc(WIDTH * HEIGHT * 3);
+
+	srand(0);
+	for (i = 0; i < WIDTH * HEIGHT; i++)
+		src[i] = (uint32_t) rand() << 16 ^ rand();
+
+	path = getenv("WESTON_BENCH_OUTPUT");
+	if (path) {
+		fp = fopen(path, "a");
+		if (!fp) {
+			fprintf(stderr, "cannot open %s: %m\n", path);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (impl = 0; impl < PIXEL_CONVERT_IMPL_COUNT; impl++) {
+		funcs = pixel_convert_get_impl(impl);
+		if (!funcs)
+			continue;
+
+		for (kernel = 0; kernel <= KERNEL_YUV420; kernel++) {
+			/* warm up the caches and the page tables */
+			run_kernel(funcs, kernel, src, dst, yuv);
+
+			clock_gettime(CLOCK_MONOTONIC, &begin);
+			for (i = 0; i < ITERATIONS; i++)
+				run_kernel(funcs, kernel, src, dst, yuv);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+
+			timespec_sub(&end, &end, &begin);
+			ms = timespec_to_nsec(&end) / 1e6 / ITERATIONS;
+
+			print_result(stdout, funcs->name,
+				     kernel_names[kernel], ms);
+			if (fp)
+				print_result(fp, funcs->name,
+					     kernel_names[kernel], ms);
+		}
+	}
+
+	if (fp)
+		fclose(fp);
+	free(src);
+	free(dst);
+	free(yuv);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "shared/pixel-convert.h"
+
+/* Long enough for the main loops of every implementation, with all tail
+ * lengths covered by the widths below. */
+#define MAX_WIDTH 256
+#define N_ROWS 64
+
+static const enum pixel_convert_impl simd_impls[] = {
+	PIXEL_CONVERT_IMPL_SSE2,
+	PIXEL_CONVERT_IMPL_AVX2,
+	PIXEL_CONVERT_IMPL_NEON,
+};
+
+static uint32_t
+next_random(uint32_t *state)
+{
+	/* xorshift32, reproducible across platforms */
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+
+	return *state;
+}
+
+/* Random pixels, mixed with the extreme values that hit the clamping of
+ * the chroma samples. */
+static void
+fill_row(uint32_t *row, int n, uint32_t *state)
+{
+	static const uint32_t extremes[] = {
+		0x00000000, 0xffffffff, 0x00ff0000, 0x0000ff00, 0x000000ff,
+		0xffff00ff, 0x00ffff00, 0x0000ffff, 0x80808080, 0x7f010203,
+	};
+	uint32_t r;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		r = next_random(state);
+		if (r % 4 == 0)
+			row[i] = extremes[(r >> 8) % ARRAY_LENGTH(extremes)];
+		else
+			row[i] = next_random(state);
+	}
+}
+
+static const struct pixel_convert_funcs *
+get_impl(enum pixel_convert_impl impl)
+{
+	const struct pixel_convert_funcs *funcs;
+
+	funcs = pixel_convert_get_impl(impl);
+	if (!funcs)
+		fprintf(stderr, "implementation %d not supported, skipped\n",
+			impl);
+	else
+		fprintf(stderr, "testing %s\n", funcs->name);
+
+	return funcs;
+}
+
+TEST_P(swap_rb_bit_exact, simd_impls)
+{
+	const enum pixel_convert_impl *impl = data;
+	const struct pixel_convert_funcs *ref, *funcs;
+	uint32_t src[MAX_WIDTH], expected[MAX_WIDTH + 1], out[MAX_WIDTH + 1];
+	uint32_t state = 0x12345678;
+	int n, row;
+
+	funcs = get_impl(*impl);
+	if (!funcs)
+		return;
+	ref = pixel_convert_get_impl(PIXEL_CONVERT_IMPL_SCALAR);
+
+	for (row = 0; row < N_ROWS; row++) {
+		for (n = 0; n <= MAX_WIDTH; n += (n < 40) ? 1 : 37) {
+			fill_row(src, n, &state);
+			memset(expected, 0x5a, sizeof expected);
+			memset(out, 0x5a, sizeof out);
+
+			ref->swap_rb(expected, src, n);
+			funcs->swap_rb(out, src, n);
+			assert(memcmp(out, expected, sizeof out) == 0);
+
+			/* in place */
+			funcs->swap_rb(src, src, n);
+			assert(memcmp(src, expected, n * sizeof *src) == 0);
+		}
+	}
+}
+
+TEST_P(yuv444_bit_exact, simd_impls)
+{
+	const enum pixel_convert_impl *impl = data;
+	const struct pixel_convert_funcs *ref, *funcs;
+	uint32_t src[MAX_WIDTH];
+	uint8_t expected[3][MAX_WIDTH + 1], out[3][MAX_WIDTH + 1];
+	uint32_t state = 0x9abcdef0;
+	int n, row, xbgr;
+
+	funcs = get_impl(*impl);
+	if (!funcs)
+		return;
+	ref = pixel_convert_get_impl(PIXEL_CONVERT_IMPL_SCALAR);
+
+	for (xbgr = 0; xbgr < 2; xbgr++) {
+		for (row = 0; row < N_ROWS; row++) {
+			for (n = 0; n <= MAX_WIDTH; n += (n < 40) ? 1 : 37) {
+				fill_row(src, n, &state);
+				memset(expected, 0x5a, sizeof expected);
+				memset(out, 0x5a, sizeof out);
+
+				ref->yuv444(expected[0], expected[1],
+					    expected[2], src, n, xbgr);
+				funcs->yuv444(out[0], out[1], out[2],
+					      src, n, xbgr);
+				assert(memcmp(out, expected, sizeof out) == 0);
+			}
+		}
+	}
+}
+
+TEST_P(yuv420_bit_exact, simd_impls)
+{
+	const enum pixel_convert_impl *impl = data;
+	const struct pixel_convert_funcs *ref, *funcs;
+	uint32_t src[2][MAX_WIDTH];
+	uint8_t expected[4][MAX_WIDTH + 1], out[4][MAX_WIDTH + 1];
+	uint32_t state = 0x0fedcba9;
+	int n, row, xbgr;
+
+	funcs = get_impl(*impl);
+	if (!funcs)
+		return;
+	ref = pixel_convert_get_impl(PIXEL_CONVERT_IMPL_SCALAR);
+
+	for (xbgr = 0; xbgr < 2; xbgr++) {
+		for (row = 0; row < N_ROWS; row++) {
+			for (n = 0; n <= MAX_WIDTH; n += (n < 40) ? 2 : 38) {
+				fill_row(src[0], n, &state);
+				fill_row(src[1], n, &state);
+				memset(expected, 0x5a, sizeof expected);
+				memset(out, 0x5a, sizeof out);
+
+				ref->yuv420(expected[0], expected[1],
+					    expected[2], expected[3],
+					    src[0], src[1], n, xbgr);
+				funcs->yuv420(out[0], out[1], out[2], out[3],
+					      src[0], src[1], n, xbgr);
+				assert(memcmp(out, expected, sizeof out) == 0);
+			}
+		}
+	}
+}
+
+/* Every color, against the scalar conversion. */
+TEST_P(yuv444_all_colors, simd_impls)
+{
+	const enum pixel_convert_impl *impl = data;
+	const struct pixel_convert_funcs *ref, *funcs;
+	uint32_t src[MAX_WIDTH];
+	uint8_t expected[3][MAX_WIDTH], out[3][MAX_WIDTH];
+	uint32_t p;
+	int i;
+
+	funcs = get_impl(*impl);
+	if (!funcs)
+		return;
+	ref = pixel_convert_get_impl(PIXEL_CONVERT_IMPL_SCALAR);
+
+	for (p = 0; p < (1 << 24); p += MAX_WIDTH) {
+		for (i = 0; i < MAX_WIDTH; i++)
+			src[i] = p + i;
+
+		ref->yuv444(expected[0], expected[1], expected[2],
+			    src, MAX_WIDTH, false);
+		funcs->yuv444(out[0], out[1], out[2], src, MAX_WIDTH, false);
+		assert(memcmp(out, expected, sizeof out) == 0);
+	}
+}
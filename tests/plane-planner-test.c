@@ -0,0 +1,210 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <assert.h>
+
+#include "compositor.h"
+#include "shared/helpers.h"
+
+/*
+ * Mock plane model, after the ice and qcom backends: a few overlay
+ * planes stacked below the composited framebuffer, so a view can only
+ * be put on an overlay when no composited view below it overlaps its
+ * visible part.
+ */
+#define N_OVERLAYS 2
+
+struct mock_planes {
+	struct weston_plane overlays[N_OVERLAYS];
+	int n_used;
+};
+
+struct test_view {
+	struct weston_surface *surface;
+	struct weston_view *view;
+};
+
+static void
+mock_assign_planes(struct weston_compositor *compositor,
+		   struct weston_plane_planner *planner,
+		   struct mock_planes *mock)
+{
+	struct weston_plane_candidate *candidate;
+	struct weston_plane *plane;
+	pixman_region32_t composited, overlap;
+
+	weston_plane_planner_update(planner);
+
+	mock->n_used = 0;
+	pixman_region32_init(&composited);
+
+	weston_plane_planner_for_each(candidate, planner) {
+		if (candidate->occluded) {
+			plane = &planner->occluded_plane;
+		} else {
+			pixman_region32_init(&overlap);
+			pixman_region32_intersect(&overlap, &composited,
+						  &candidate->visible);
+
+			if (!pixman_region32_not_empty(&overlap) &&
+			    mock->n_used < N_OVERLAYS)
+				plane = &mock->overlays[mock->n_used++];
+			else
+				plane = &compositor->primary_plane;
+
+			pixman_region32_fini(&overlap);
+		}
+
+		if (plane == &compositor->primary_plane)
+			pixman_region32_union(&composited, &composited,
+				&candidate->view->transform.boundingbox);
+
+		weston_view_move_to_plane(candidate->view, plane);
+	}
+
+	pixman_region32_fini(&composited);
+}
+
+/* Views are stacked in the order they are created, the first on top. */
+static void
+test_view_create(struct weston_compositor *compositor, struct test_view *tv,
+		 int x, int y, int width, int height, bool opaque)
+{
+	tv->surface = weston_surface_create(compositor);
+	assert(tv->surface);
+	tv->view = weston_view_create(tv->surface);
+	assert(tv->view);
+
+	tv->surface->width = width;
+	tv->surface->height = height;
+	if (opaque)
+		pixman_region32_union_rect(&tv->surface->opaque,
+					   &tv->surface->opaque,
+					   0, 0, width, height);
+
+	weston_view_set_position(tv->view, x, y);
+	weston_view_update_transform(tv->view);
+	tv->view->plane = &compositor->primary_plane;
+
+	wl_list_insert(compositor->view_list.prev, &tv->view->link);
+}
+
+static struct weston_plane_candidate *
+find_candidate(struct weston_plane_planner *planner, struct test_view *tv)
+{
+	struct weston_plane_candidate *candidate;
+
+	weston_plane_planner_for_each(candidate, planner)
+		if (candidate->view == tv->view)
+			return candidate;
+
+	assert(!"view not listed");
+	return NULL;
+}
+
+static void
+plane_planner(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct weston_plane_planner planner;
+	struct weston_plane_candidate *candidate;
+	struct mock_planes mock;
+	struct test_view top, middle, hidden, bottom;
+	pixman_region32_t expected;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(mock.overlays); i++) {
+		weston_plane_init(&mock.overlays[i], compositor, 0, 0);
+		weston_compositor_stack_plane(compositor, &mock.overlays[i],
+					      &compositor->primary_plane);
+	}
+	weston_plane_planner_init(&planner, compositor);
+
+	/* top covers hidden, and half of middle; bottom is translucent
+	 * and in the clear */
+	test_view_create(compositor, &top, 0, 0, 200, 200, true);
+	test_view_create(compositor, &middle, 100, 0, 200, 100, true);
+	test_view_create(compositor, &hidden, 50, 50, 100, 100, true);
+	test_view_create(compositor, &bottom, 400, 0, 100, 100, false);
+
+	weston_plane_planner_update(&planner);
+	assert(planner.n_candidates == 4);
+	assert(planner.n_occluded == 1);
+
+	/* bottom-most first */
+	candidate = planner.candidates.data;
+	assert(candidate[0].view == bottom.view);
+	assert(candidate[3].view == top.view);
+
+	assert(find_candidate(&planner, &hidden)->occluded);
+	assert(!find_candidate(&planner, &top)->occluded);
+	assert(!find_candidate(&planner, &bottom)->occluded);
+
+	candidate = find_candidate(&planner, &middle);
+	assert(!candidate->occluded);
+	pixman_region32_init_rect(&expected, 200, 0, 100, 100);
+	assert(pixman_region32_equal(&candidate->visible, &expected));
+	pixman_region32_fini(&expected);
+
+	/* The hidden view does not take an overlay from the visible ones:
+	 * bottom and middle get the overlays, top must be composited. */
+	mock_assign_planes(compositor, &planner, &mock);
+	assert(hidden.view->plane == &planner.occluded_plane);
+	assert(bottom.view->plane == &mock.overlays[0]);
+	assert(middle.view->plane == &mock.overlays[1]);
+	assert(top.view->plane == &compositor->primary_plane);
+
+	/* Uncovered, the view is given a plane again. */
+	weston_view_set_position(top.view, 0, 300);
+	weston_view_update_transform(top.view);
+	mock_assign_planes(compositor, &planner, &mock);
+	assert(planner.n_occluded == 0);
+	assert(hidden.view->plane != &planner.occluded_plane);
+	assert(top.view->plane == &compositor->primary_plane);
+
+	weston_surface_destroy(top.surface);
+	weston_surface_destroy(middle.surface);
+	weston_surface_destroy(hidden.surface);
+	weston_surface_destroy(bottom.surface);
+
+	weston_plane_planner_release(&planner);
+	for (i = 0; i < ARRAY_LENGTH(mock.overlays); i++)
+		weston_plane_release(&mock.overlays[i]);
+
+	wl_display_terminate(compositor->wl_display);
+}
+
+WL_EXPORT int
+module_init(struct weston_compositor *compositor, int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, plane_planner, compositor);
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <linux/input.h>
+
+#include "compositor.h"
+#include "shared/helpers.h"
+
+#define N_EVENTS 64
+
+struct recording_grab {
+	struct weston_pointer_grab base;
+	int motions;
+	int buttons;
+	int frames;
+	uint32_t motion_time;
+	struct weston_pointer_motion_event motion;
+};
+
+static void
+grab_focus(struct weston_pointer_grab *base)
+{
+}
+
+static void
+grab_motion(struct weston_pointer_grab *base, uint32_t time,
+	    struct weston_pointer_motion_event *event)
+{
+	struct recording_grab *grab = container_of(base, struct recording_grab,
+						   base);
+
+	grab->motions++;
+	grab->motion_time = time;
+	grab->motion = *event;
+}
+
+static void
+grab_button(struct weston_pointer_grab *base, uint32_t time,
+	    uint32_t button, uint32_t state)
+{
+	struct recording_grab *grab = container_of(base, struct recording_grab,
+						   base);
+
+	grab->buttons++;
+}
+
+static void
+grab_axis(struct weston_pointer_grab *base, uint32_t time,
+	  struct weston_pointer_axis_event *event)
+{
+}
+
+static void
+grab_axis_source(struct weston_pointer_grab *base, uint32_t source)
+{
+}
+
+static void
+grab_frame(struct weston_pointer_grab *base)
+{
+	struct recording_grab *grab = container_of(base, struct recording_grab,
+						   base);
+
+	grab->frames++;
+}
+
+static void
+grab_cancel(struct weston_pointer_grab *base)
+{
+}
+
+static const struct weston_pointer_grab_interface recording_grab_interface = {
+	grab_focus,
+	grab_motion,
+	grab_button,
+	grab_axis,
+	grab_axis_source,
+	grab_frame,
+	grab_cancel,
+};
+
+static void
+pointer_coalesce(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct recording_grab grab = { { &recording_grab_interface } };
+	struct weston_pointer_motion_event event;
+	struct weston_pointer *pointer;
+	struct weston_seat seat;
+	int i;
+
+	compositor->coalesce_pointer_motion = true;
+
+	weston_seat_init(&seat, compositor, "coalesce");
+	weston_seat_init_pointer(&seat);
+	pointer = weston_seat_get_pointer(&seat);
+	weston_pointer_start_grab(pointer, &grab.base);
+
+	for (i = 0; i < N_EVENTS; i++) {
+		event = (struct weston_pointer_motion_event) {
+			.mask = WESTON_POINTER_MOTION_REL |
+				WESTON_POINTER_MOTION_REL_UNACCEL,
+			.time_usec = i * 1000,
+			.dx = 0.25,
+			.dy = -0.5,
+			.dx_unaccel = 0.125,
+			.dy_unaccel = 0.375,
+		};
+		notify_motion(&seat, i, &event);
+		notify_pointer_frame(&seat);
+	}
+
+	/* Nothing is delivered before the frame or the next button... */
+	assert(grab.motions == 0);
+	assert(grab.frames == 0);
+
+	notify_button(&seat, N_EVENTS, BTN_LEFT,
+		      WL_POINTER_BUTTON_STATE_PRESSED);
+	notify_pointer_frame(&seat);
+
+	/* ...which sees all of the motion first, in a single event. */
+	assert(grab.motions == 1);
+	assert(grab.buttons == 1);
+	assert(grab.frames == 2);
+	assert(grab.motion_time == N_EVENTS - 1);
+	assert(grab.motion.time_usec == (N_EVENTS - 1) * 1000);
+	assert(grab.motion.dx == 0.25 * N_EVENTS);
+	assert(grab.motion.dy == -0.5 * N_EVENTS);
+	assert(grab.motion.dx_unaccel == 0.125 * N_EVENTS);
+	assert(grab.motion.dy_unaccel == 0.375 * N_EVENTS);
+
+	notify_button(&seat, N_EVENTS, BTN_LEFT,
+		      WL_POINTER_BUTTON_STATE_RELEASED);
+
+	/* Absolute motion does not merge with relative motion. */
+	event = (struct weston_pointer_motion_event) {
+		.mask = WESTON_POINTER_MOTION_REL,
+		.dx = 1.0,
+		.dy = 1.0,
+	};
+	notify_motion(&seat, N_EVENTS, &event);
+	notify_motion_absolute(&seat, N_EVENTS, 10.0, 20.0);
+	notify_motion_absolute(&seat, N_EVENTS, 30.0, 40.0);
+	assert(grab.motions == 2);
+	assert(grab.motion.mask == WESTON_POINTER_MOTION_REL);
+
+	weston_pointer_flush_motion(pointer);
+	assert(grab.motions == 3);
+	assert(grab.motion.mask == WESTON_POINTER_MOTION_ABS);
+	assert(grab.motion.x == 30.0);
+	assert(grab.motion.y == 40.0);
+
+	weston_pointer_end_grab(pointer);
+	weston_seat_release(&seat);
+
+	wl_display_terminate(compositor->wl_display);
+}
+
+WL_EXPORT int
+module_init(struct weston_compositor *compositor, int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, pointer_coalesce, compositor);
+
+	return 0;
+}
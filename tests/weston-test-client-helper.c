@@ -533,10 +533,50 @@ test_handle_capture_screenshot_done(void *data, struct weston_test *weston_test)
 	test->buffer_copy_done = 1;
 }
 
+static void
+test_handle_repaint_profile(void *data, struct weston_test *weston_test,
+			    uint32_t view_list, uint32_t assign_planes,
+			    uint32_t accumulate_damage, uint32_t render,
+			    uint32_t frame_callbacks)
+{
+	struct test *test = data;
+	struct repaint_profile *profile;
+
+	profile = wl_array_add(&test->repaint_profiles, sizeof *profile);
+	assert(profile);
+
+	profile->view_list = view_list;
+	profile->assign_planes = assign_planes;
+	profile->accumulate_damage = accumulate_damage;
+	profile->render = render;
+	profile->frame_callbacks = frame_callbacks;
+}
+
+static void
+test_handle_repaint_regions(void *data, struct weston_test *weston_test,
+			    uint32_t regions, uint32_t heap_regions,
+			    uint32_t allocs)
+{
+	struct test *test = data;
+	struct repaint_profile *profile;
+
+	/* follows the repaint_profile event of the same repaint */
+	assert(test->repaint_profiles.size >= sizeof *profile);
+	profile = (struct repaint_profile *)
+		((char *) test->repaint_profiles.data +
+		 test->repaint_profiles.size - sizeof *profile);
+
+	profile->regions = regions;
+	profile->heap_regions = heap_regions;
+	profile->region_allocs = allocs;
+}
+
 static const struct weston_test_listener test_listener = {
 	test_handle_pointer_position,
 	test_handle_n_egl_buffers,
 	test_handle_capture_screenshot_done,
+	test_handle_repaint_profile,
+	test_handle_repaint_regions,
 };
 
 static void
@@ -726,6 +766,7 @@ handle_global(void *data, struct wl_registry *registry,
 		client->output = output;
 	} else if (strcmp(interface, "weston_test") == 0) {
 		test = xzalloc(sizeof *test);
+		wl_array_init(&test->repaint_profiles);
 		test->weston_test =
 			wl_registry_bind(registry, id,
 					 &weston_test_interface, version);
@@ -65,12 +65,27 @@ struct global {
 	struct wl_list link;
 };
 
+/* durations of the stages of one output repaint, in nanoseconds, and
+ * the region temporaries it used */
+struct repaint_profile {
+	uint32_t view_list;
+	uint32_t assign_planes;
+	uint32_t accumulate_damage;
+	uint32_t render;
+	uint32_t frame_callbacks;
+
+	uint32_t regions;
+	uint32_t heap_regions;
+	uint32_t region_allocs;
+};
+
 struct test {
 	struct weston_test *weston_test;
 	int pointer_x;
 	int pointer_y;
 	uint32_t n_egl_buffers;
 	int buffer_copy_done;
+	struct wl_array repaint_profiles; /* struct repaint_profile */
 };
 
 struct input {
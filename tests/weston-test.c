@@ -49,6 +49,8 @@ struct weston_test {
 	struct weston_layer layer;
 	struct weston_process process;
 	struct weston_seat seat;
+	struct wl_list profile_resource_list;
+	struct wl_listener output_repainted_listener;
 };
 
 struct weston_test_surface {
@@ -527,6 +529,71 @@ capture_screenshot(struct wl_client *client,
 				     capture_screenshot_done, resource);
 }
 
+static void
+profile_repaint(struct wl_client *client, struct wl_resource *resource,
+		uint32_t enable)
+{
+	struct weston_test *test = wl_resource_get_user_data(resource);
+	struct wl_list *link = wl_resource_get_link(resource);
+
+	wl_list_remove(link);
+	wl_list_init(link);
+
+	if (enable)
+		wl_list_insert(&test->profile_resource_list, link);
+}
+
+static void
+output_repainted(struct wl_listener *listener, void *data)
+{
+	struct weston_test *test =
+		container_of(listener, struct weston_test,
+			     output_repainted_listener);
+	struct weston_output *output = data;
+	uint32_t *nsec = output->repaint_stage_nsec;
+	struct weston_region_arena_stats *regions =
+		&output->repaint_region_stats;
+	struct wl_resource *resource;
+
+	wl_resource_for_each(resource, &test->profile_resource_list) {
+		weston_test_send_repaint_profile(resource,
+			nsec[WESTON_REPAINT_STAGE_VIEW_LIST],
+			nsec[WESTON_REPAINT_STAGE_ASSIGN_PLANES],
+			nsec[WESTON_REPAINT_STAGE_ACCUMULATE_DAMAGE],
+			nsec[WESTON_REPAINT_STAGE_RENDER],
+			nsec[WESTON_REPAINT_STAGE_FRAME_CALLBACKS]);
+		weston_test_send_repaint_regions(resource, regions->regions,
+						 regions->heap_regions,
+						 regions->allocs);
+	}
+}
+
+static void
+set_surfaces_hidden(struct wl_client *client, struct wl_resource *resource,
+		    uint32_t hidden)
+{
+	struct weston_test *test = wl_resource_get_user_data(resource);
+	struct weston_compositor *ec = test->compositor;
+
+	wl_list_remove(&test->layer.link);
+	if (hidden)
+		wl_list_init(&test->layer.link);
+	else
+		wl_list_insert(&ec->cursor_layer.link, &test->layer.link);
+
+	weston_compositor_schedule_repaint(ec);
+}
+
+static void
+destroy_output(struct wl_client *client, struct wl_resource *resource,
+	       struct wl_resource *output_resource)
+{
+	struct weston_output *output =
+		wl_resource_get_user_data(output_resource);
+
+	output->destroy(output);
+}
+
 static const struct weston_test_interface test_implementation = {
 	move_surface,
 	move_pointer,
@@ -537,8 +604,17 @@ static const struct weston_test_interface test_implementation = {
 	device_add,
 	get_n_buffers,
 	capture_screenshot,
+	profile_repaint,
+	set_surfaces_hidden,
+	destroy_output,
 };
 
+static void
+unbind_test(struct wl_resource *resource)
+{
+	wl_list_remove(wl_resource_get_link(resource));
+}
+
 static void
 bind_test(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 {
@@ -552,7 +628,8 @@ bind_test(struct wl_client *client, void *data, uint32_t version, uint32_t id)
 	}
 
 	wl_resource_set_implementation(resource,
-				       &test_implementation, test, NULL);
+				       &test_implementation, test, unbind_test);
+	wl_list_init(wl_resource_get_link(resource));
 
 	notify_pointer_position(test, resource);
 }
@@ -598,6 +675,11 @@ module_init(struct weston_compositor *ec,
 	test->compositor = ec;
 	weston_layer_init(&test->layer, &ec->cursor_layer.link);
 
+	wl_list_init(&test->profile_resource_list);
+	test->output_repainted_listener.notify = output_repainted;
+	wl_signal_add(&ec->output_repainted_signal,
+		      &test->output_repainted_listener);
+
 	if (wl_global_create(ec->wl_display, &weston_test_interface, 1,
 			     test, bind_test) == NULL)
 		return -1;
@@ -0,0 +1,306 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Converts a binary weston timeline log to the JSON timeline format.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "timeline.h"
+#include "timeline-format.h"
+
+struct string {
+	char *data;
+	size_t len;
+	size_t alloc;
+};
+
+struct decoder {
+	FILE *in;
+	FILE *out;
+
+	char **names;		/* indexed by point name id */
+	uint32_t n_names;
+
+	struct string text;	/* string being reassembled */
+};
+
+static int
+string_append(struct string *str, const char *data, size_t len)
+{
+	char *p;
+	size_t alloc;
+
+	if (str->len + len + 1 > str->alloc) {
+		alloc = str->alloc ? str->alloc * 2 : 256;
+		while (alloc < str->len + len + 1)
+			alloc *= 2;
+
+		p = realloc(str->data, alloc);
+		if (!p)
+			return -1;
+
+		str->data = p;
+		str->alloc = alloc;
+	}
+
+	memcpy(str->data + str->len, data, len);
+	str->len += len;
+	str->data[str->len] = '\0';
+
+	return 0;
+}
+
+static void
+fprint_quoted_string(FILE *fp, const char *str)
+{
+	if (!str) {
+		fprintf(fp, "null");
+		return;
+	}
+
+	fprintf(fp, "\"%s\"", str);
+}
+
+/* Returns 1 when the string is complete, with *str NULL for a NULL
+ * string, 0 when more records are needed and -1 on error. */
+static int
+decode_string(struct decoder *dec, const struct weston_timeline_record *rec,
+	      const char **str)
+{
+	if (rec->flags & WESTON_TIMELINE_RECORD_NULL) {
+		dec->text.len = 0;
+		*str = NULL;
+		return 1;
+	}
+
+	if (string_append(&dec->text, rec->u.text,
+			  strnlen(rec->u.text, sizeof(rec->u.text))) < 0)
+		return -1;
+
+	if (rec->flags & WESTON_TIMELINE_RECORD_CONTINUED)
+		return 0;
+
+	dec->text.len = 0;
+	*str = dec->text.data ? dec->text.data : "";
+
+	return 1;
+}
+
+static int
+decode_name(struct decoder *dec, const struct weston_timeline_record *rec,
+	    const char *str)
+{
+	char **names;
+	uint32_t i;
+
+	if (rec->id >= dec->n_names) {
+		names = realloc(dec->names, (rec->id + 1) * sizeof(*names));
+		if (!names)
+			return -1;
+
+		for (i = dec->n_names; i <= rec->id; i++)
+			names[i] = NULL;
+
+		dec->names = names;
+		dec->n_names = rec->id + 1;
+	}
+
+	free(dec->names[rec->id]);
+	dec->names[rec->id] = strdup(str ? str : "");
+
+	return dec->names[rec->id] ? 0 : -1;
+}
+
+static void
+decode_point(struct decoder *dec, const struct weston_timeline_record *rec)
+{
+	const char *name = NULL;
+	uint32_t i;
+
+	if (rec->id < dec->n_names)
+		name = dec->names[rec->id];
+
+	fprintf(dec->out, "{ \"T\":[%" PRId64 ", %u], \"N\":",
+		rec->tv_sec, rec->tv_nsec);
+	fprint_quoted_string(dec->out, name);
+
+	for (i = 0; i < rec->aux && i < WESTON_TIMELINE_MAX_ARGS; i++) {
+		switch (rec->u.point.arg_type[i]) {
+		case TLT_OUTPUT:
+			fprintf(dec->out, ", \"wo\":%u", rec->u.point.output);
+			break;
+		case TLT_SURFACE:
+			fprintf(dec->out, ", \"ws\":%u", rec->u.point.surface);
+			break;
+		case TLT_VBLANK:
+			fprintf(dec->out, ", \"vblank\":[%" PRId64 ", %u]",
+				rec->u.point.vblank_sec,
+				rec->u.point.vblank_nsec);
+			break;
+		default:
+			break;
+		}
+	}
+
+	fprintf(dec->out, " }\n");
+}
+
+static int
+decode_record(struct decoder *dec, const struct weston_timeline_record *rec)
+{
+	const char *str;
+	int ret;
+
+	switch (rec->type) {
+	case WESTON_TIMELINE_RECORD_POINT:
+		decode_point(dec, rec);
+		return 0;
+	case WESTON_TIMELINE_RECORD_DROPPED:
+		fprintf(stderr, "%u timeline points lost before "
+			"%" PRId64 ".%09u\n", rec->aux, rec->tv_sec,
+			rec->tv_nsec);
+		return 0;
+	case WESTON_TIMELINE_RECORD_NAME:
+	case WESTON_TIMELINE_RECORD_OUTPUT:
+	case WESTON_TIMELINE_RECORD_SURFACE:
+		break;
+	default:
+		fprintf(stderr, "unknown record type %u\n", rec->type);
+		return -1;
+	}
+
+	ret = decode_string(dec, rec, &str);
+	if (ret <= 0)
+		return ret;
+
+	switch (rec->type) {
+	case WESTON_TIMELINE_RECORD_NAME:
+		return decode_name(dec, rec, str);
+	case WESTON_TIMELINE_RECORD_OUTPUT:
+		fprintf(dec->out, "{ \"id\":%u, "
+			"\"type\":\"weston_output\", \"name\":", rec->id);
+		fprint_quoted_string(dec->out, str);
+		fprintf(dec->out, " }\n");
+		break;
+	case WESTON_TIMELINE_RECORD_SURFACE:
+		fprintf(dec->out, "{ \"id\":%u, "
+			"\"type\":\"weston_surface\", \"desc\":", rec->id);
+		fprint_quoted_string(dec->out, str);
+		if (rec->aux)
+			fprintf(dec->out, ", \"main_surface\":%u", rec->aux);
+		fprintf(dec->out, " }\n");
+		break;
+	}
+
+	return 0;
+}
+
+static int
+decode(struct decoder *dec)
+{
+	struct weston_timeline_header header;
+	struct weston_timeline_record rec;
+
+	if (fread(&header, sizeof header, 1, dec->in) != 1 ||
+	    memcmp(header.magic, WESTON_TIMELINE_MAGIC,
+		   sizeof header.magic) != 0) {
+		fprintf(stderr, "not a weston timeline file\n");
+		return -1;
+	}
+
+	if (header.version != WESTON_TIMELINE_VERSION ||
+	    header.record_size != sizeof rec) {
+		fprintf(stderr, "unsupported timeline file version %u\n",
+			header.version);
+		return -1;
+	}
+
+	while (fread(&rec, sizeof rec, 1, dec->in) == 1)
+		if (decode_record(dec, &rec) < 0)
+			return -1;
+
+	if (ferror(dec->in)) {
+		fprintf(stderr, "error reading the timeline file\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr, "usage: %s TIMELINE_FILE [OUTPUT_FILE]\n\n"
+		"Convert a binary weston timeline log to JSON, written to\n"
+		"OUTPUT_FILE or the standard output.\n", name);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct decoder dec = { 0 };
+	uint32_t i;
+	int ret;
+
+	if (argc < 2 || argc > 3) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	dec.in = fopen(argv[1], "rb");
+	if (!dec.in) {
+		fprintf(stderr, "cannot open %s: %m\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	dec.out = stdout;
+	if (argc == 3) {
+		dec.out = fopen(argv[2], "w");
+		if (!dec.out) {
+			fprintf(stderr, "cannot open %s: %m\n", argv[2]);
+			fclose(dec.in);
+			return EXIT_FAILURE;
+		}
+	}
+
+	ret = decode(&dec);
+
+	for (i = 0; i < dec.n_names; i++)
+		free(dec.names[i]);
+	free(dec.names);
+	free(dec.text.data);
+
+	fclose(dec.in);
+	if (dec.out != stdout && fclose(dec.out) != 0)
+		ret = -1;
+
+	return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
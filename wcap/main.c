@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <sys/mman.h>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -40,6 +41,7 @@
 #include <cairo.h>
 
 #include "wcap-decode.h"
+#include "shared/pixel-convert.h"
 
 static void
 write_png(struct wcap_decoder *decoder, const char *filename)
@@ -55,56 +57,16 @@ write_png(struct wcap_decoder *decoder, const char *filename)
 	cairo_surface_destroy(surface);
 }
 
-static inline int
-rgb_to_yuv(uint32_t format, uint32_t p, int *u, int *v)
-{
-	int r, g, b, y;
-
-	switch (format) {
-	case WCAP_FORMAT_XRGB8888:
-		r = (p >> 16) & 0xff;
-		g = (p >> 8) & 0xff;
-		b = (p >> 0) & 0xff;
-		break;
-	case WCAP_FORMAT_XBGR8888:
-		r = (p >> 0) & 0xff;
-		g = (p >> 8) & 0xff;
-		b = (p >> 16) & 0xff;
-		break;
-	default:
-		assert(0);
-	}
-
-	y = (19595 * r + 38469 * g + 7472 * b) >> 16;
-	if (y > 255)
-		y = 255;
-
-	*u += 46727 * (r - y);
-	*v += 36962 * (b - y);
-
-	return y;
-}
-
-static inline
-int clamp_uv(int u)
-{
-	int clamp = (u >> 18) + 128;
-
-	if (clamp < 0)
-		return 0;
-	else if (clamp > 255)
-		return 255;
-	else
-		return clamp;
-}
-
 static void
 convert_to_yv12(struct wcap_decoder *decoder, unsigned char *out)
 {
+	const struct pixel_convert_funcs *convert = pixel_convert_get();
 	unsigned char *y1, *y2, *u, *v;
-	uint32_t *p1, *p2, *end;
-	int i, u_accum, v_accum, stride0, stride1;
-	uint32_t format = decoder->format;
+	uint32_t *p1, *p2;
+	int i, stride0, stride1;
+	bool xbgr = decoder->format == WCAP_FORMAT_XBGR8888;
+
+	assert(xbgr || decoder->format == WCAP_FORMAT_XRGB8888);
 
 	stride0 = decoder->width;
 	stride1 = decoder->width / 2;
@@ -115,37 +77,21 @@ convert_to_yv12(struct wcap_decoder *decoder, unsigned char *out)
 		u = v + stride1 * decoder->height / 2;
 		p1 = decoder->frame + decoder->width * i;
 		p2 = p1 + decoder->width;
-		end = p1 + decoder->width;
 
-		while (p1 < end) {
-			u_accum = 0;
-			v_accum = 0;
-			y1[0] = rgb_to_yuv(format, p1[0], &u_accum, &v_accum);
-			y1[1] = rgb_to_yuv(format, p1[1], &u_accum, &v_accum);
-			y2[0] = rgb_to_yuv(format, p2[0], &u_accum, &v_accum);
-			y2[1] = rgb_to_yuv(format, p2[1], &u_accum, &v_accum);
-			u[0] = clamp_uv(u_accum);
-			v[0] = clamp_uv(v_accum);
-
-			y1 += 2;
-			p1 += 2;
-			y2 += 2;
-			p2 += 2;
-			u++;
-			v++;
-		}
+		convert->yuv420(y1, y2, u, v, p1, p2, decoder->width, xbgr);
 	}
 }
 
 static void
 convert_to_yuv444(struct wcap_decoder *decoder, unsigned char *out)
 {
-
+	const struct pixel_convert_funcs *convert = pixel_convert_get();
 	unsigned char *yp, *up, *vp;
-	uint32_t *rp, *end;
-	int u, v;
+	uint32_t *rp;
 	int i, stride, psize;
-	uint32_t format = decoder->format;
+	bool xbgr = decoder->format == WCAP_FORMAT_XBGR8888;
+
+	assert(xbgr || decoder->format == WCAP_FORMAT_XRGB8888);
 
 	stride = decoder->width;
 	psize = stride * decoder->height;
@@ -154,18 +100,8 @@ convert_to_yuv444(struct wcap_decoder *decoder, unsigned char *out)
 		up = yp + (psize * 2);
 		vp = yp + (psize * 1);
 		rp = decoder->frame + decoder->width * i;
-		end = rp + decoder->width;
-		while (rp < end) {
-			u = 0;
-			v = 0;
-			yp[0] = rgb_to_yuv(format, rp[0], &u, &v);
-			up[0] = clamp_uv(u/.3);
-			vp[0] = clamp_uv(v/.3);
-			up++;
-			vp++;
-			yp++;
-			rp++;
-		}
+
+		convert->yuv444(yp, up, vp, rp, decoder->width, xbgr);
 	}
 }
 
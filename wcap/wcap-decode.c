@@ -38,13 +38,17 @@
 
 #include <cairo.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "wcap-decode.h"
 
 static void
 wcap_decoder_decode_rectangle(struct wcap_decoder *decoder,
 			      struct wcap_rectangle *rect)
 {
-	uint32_t v, *p = decoder->p, *d;
+	uint32_t v, *p = decoder->rle, *d;
 	int width = rect->x2 - rect->x1, height = rect->y2 - rect->y1;
 	int x, i, j, k, l, count = width * height;
 	unsigned char r, g, b, dr, dg, db;
@@ -82,7 +86,48 @@ wcap_decoder_decode_rectangle(struct wcap_decoder *decoder,
 		printf("rle encoding longer than expected (%d expected %d)\n",
 		       i, count);
 
-	decoder->p = p;
+	decoder->rle = p;
+}
+
+/* Inflate the run-length encoded rectangles of a version 2 frame, which
+ * follow the rectangle list as
+ *
+ *	uint32_t	size of the encoded data
+ *	uint32_t	size of the zlib stream
+ *	zlib stream, padded to 32 bits
+ */
+static int
+wcap_decoder_inflate(struct wcap_decoder *decoder)
+{
+#ifdef HAVE_ZLIB
+	uint32_t *sizes = decoder->p;
+	uLongf len = sizes[0];
+	uint32_t zlen = sizes[1];
+	void *inflated;
+
+	if (len > decoder->inflated_size) {
+		inflated = realloc(decoder->inflated, len);
+		if (!inflated)
+			return -1;
+		decoder->inflated = inflated;
+		decoder->inflated_size = len;
+	}
+
+	if (uncompress((Bytef *) decoder->inflated, &len,
+		       (const Bytef *) (sizes + 2), zlen) != Z_OK ||
+	    len != sizes[0]) {
+		fprintf(stderr, "corrupt compressed frame\n");
+		return -1;
+	}
+
+	decoder->rle = decoder->inflated;
+	decoder->p = (uint8_t *) (sizes + 2) + ((zlen + 3) & ~3u);
+
+	return 0;
+#else
+	fprintf(stderr, "compressed wcap files need zlib support\n");
+	return -1;
+#endif
 }
 
 int
@@ -101,9 +146,20 @@ wcap_decoder_get_frame(struct wcap_decoder *decoder)
 
 	rects = (void *) (header + 1);
 	decoder->p = (uint32_t *) (rects + header->nrects);
+
+	if (decoder->compression == WCAP_COMPRESSION_ZLIB) {
+		if (wcap_decoder_inflate(decoder) < 0)
+			return 0;
+	} else {
+		decoder->rle = decoder->p;
+	}
+
 	for (i = 0; i < header->nrects; i++)
 		wcap_decoder_decode_rectangle(decoder, &rects[i]);
 
+	if (decoder->compression == WCAP_COMPRESSION_NONE)
+		decoder->p = decoder->rle;
+
 	return 1;
 }
 
@@ -112,6 +168,7 @@ wcap_decoder_create(const char *filename)
 {
 	struct wcap_decoder *decoder;
 	struct wcap_header *header;
+	struct wcap_header_v2 *header_v2;
 	int frame_size;
 	struct stat buf;
 
@@ -142,6 +199,28 @@ wcap_decoder_create(const char *filename)
 	decoder->height = header->height;
 	decoder->p = header + 1;
 	decoder->end = decoder->map + decoder->size;
+	decoder->inflated = NULL;
+	decoder->inflated_size = 0;
+	decoder->compression = WCAP_COMPRESSION_NONE;
+
+	switch (header->magic) {
+	case WCAP_HEADER_MAGIC:
+		break;
+	case WCAP_HEADER_MAGIC_V2:
+		header_v2 = decoder->map;
+		decoder->compression = header_v2->compression;
+		decoder->p = header_v2 + 1;
+		if (decoder->compression == WCAP_COMPRESSION_NONE ||
+		    decoder->compression == WCAP_COMPRESSION_ZLIB)
+			break;
+		/* fall through */
+	default:
+		fprintf(stderr, "unsupported wcap file\n");
+		munmap(decoder->map, decoder->size);
+		close(decoder->fd);
+		free(decoder);
+		return NULL;
+	}
 
 	frame_size = header->width * header->height * 4;
 	decoder->frame = malloc(frame_size);
@@ -159,6 +238,7 @@ wcap_decoder_destroy(struct wcap_decoder *decoder)
 {
 	munmap(decoder->map, decoder->size);
 	close(decoder->fd);
+	free(decoder->inflated);
 	free(decoder->frame);
 	free(decoder);
 }
@@ -29,6 +29,7 @@
 #include <stdint.h>
 
 #define WCAP_HEADER_MAGIC	0x57434150
+#define WCAP_HEADER_MAGIC_V2	0x57434151
 
 #define WCAP_FORMAT_XRGB8888	0x34325258
 #define WCAP_FORMAT_XBGR8888	0x34324258
@@ -41,6 +42,16 @@ struct wcap_header {
 	uint32_t width, height;
 };
 
+#define WCAP_COMPRESSION_NONE	0
+#define WCAP_COMPRESSION_ZLIB	1
+
+struct wcap_header_v2 {
+	uint32_t magic;
+	uint32_t format;
+	uint32_t width, height;
+	uint32_t compression;
+};
+
 struct wcap_frame_header {
 	uint32_t msecs;
 	uint32_t nrects;
@@ -55,6 +66,10 @@ struct wcap_decoder {
 	size_t size;
 	void *map, *p, *end;
 	uint32_t *frame;
+	uint32_t *rle;
+	uint32_t *inflated;
+	size_t inflated_size;
+	uint32_t compression;
 	uint32_t format;
 	uint32_t msecs;
 	uint32_t count;
@@ -140,7 +140,7 @@ data_source_send(struct weston_data_source *base,
 
 	xcb_flush(wm->conn);
 
-	fcntl(fd, F_SETFL, O_WRONLY | O_NONBLOCK);
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 	wm->data_source_fd = fd;
 }
 
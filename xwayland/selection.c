@@ -30,6 +30,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 
 #include "xwayland.h"
 #include "shared/helpers.h"
@@ -46,7 +47,10 @@ writable_callback(int fd, uint32_t mask, void *data)
 		wm->property_start;
 
 	len = write(fd, property + wm->property_start, remainder);
-	if (len == -1) {
+	if (len == -1 && errno == EAGAIN) {
+		/* Written once the target reads. */
+		return 1;
+	} else if (len == -1) {
 		free(wm->property_reply);
 		wm->property_reply = NULL;
 		if (wm->property_source)
@@ -57,9 +61,9 @@ writable_callback(int fd, uint32_t mask, void *data)
 		return 1;
 	}
 
-	weston_log("wrote %d (chunk size %d) of %d bytes\n",
-		wm->property_start + len,
-		len, xcb_get_property_value_length(wm->property_reply));
+	wm_log("wrote %d (chunk size %d) of %d bytes\n",
+	       wm->property_start + len,
+	       len, xcb_get_property_value_length(wm->property_reply));
 
 	wm->property_start += len;
 	if (len == remainder) {
@@ -74,7 +78,7 @@ writable_callback(int fd, uint32_t mask, void *data)
 					    wm->selection_window,
 					    wm->atom.wl_selection);
 		} else {
-			weston_log("transfer complete\n");
+			wm_log("transfer complete\n");
 			close(fd);
 		}
 	}
@@ -98,36 +102,46 @@ weston_wm_write_property(struct weston_wm *wm, xcb_get_property_reply_t *reply)
 }
 
 static void
-weston_wm_get_incr_chunk(struct weston_wm *wm)
+weston_wm_incr_chunk_reply(struct weston_wm *wm, void *property_reply,
+			   void *data)
 {
-	xcb_get_property_cookie_t cookie;
-	xcb_get_property_reply_t *reply;
+	xcb_get_property_reply_t *reply = property_reply;
 
-	cookie = xcb_get_property(wm->conn,
-				  0, /* delete */
-				  wm->selection_window,
-				  wm->atom.wl_selection,
-				  XCB_GET_PROPERTY_TYPE_ANY,
-				  0, /* offset */
-				  0x1fffffff /* length */);
-
-	reply = xcb_get_property_reply(wm->conn, cookie, NULL);
 	if (reply == NULL)
 		return;
 
+#ifdef WM_DEBUG
 	dump_property(wm, wm->atom.wl_selection, reply);
+#endif
 
 	if (xcb_get_property_value_length(reply) > 0) {
 		/* reply's ownership is transferred to wm, which is responsible
 		 * for freeing it */
 		weston_wm_write_property(wm, reply);
 	} else {
-		weston_log("transfer complete\n");
+		wm_log("transfer complete\n");
 		close(wm->data_source_fd);
 		free(reply);
 	}
 }
 
+static void
+weston_wm_get_incr_chunk(struct weston_wm *wm)
+{
+	xcb_get_property_cookie_t cookie;
+
+	cookie = xcb_get_property(wm->conn,
+				  0, /* delete */
+				  wm->selection_window,
+				  wm->atom.wl_selection,
+				  XCB_GET_PROPERTY_TYPE_ANY,
+				  0, /* offset */
+				  0x1fffffff /* length */);
+
+	weston_wm_request(wm, cookie.sequence,
+			  weston_wm_incr_chunk_reply, NULL);
+}
+
 struct x11_data_source {
 	struct weston_data_source base;
 	struct weston_wm *wm;
@@ -157,7 +171,7 @@ data_source_send(struct weston_data_source *base,
 
 		xcb_flush(wm->conn);
 
-		fcntl(fd, F_SETFL, O_WRONLY | O_NONBLOCK);
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
 		wm->data_source_fd = fd;
 	}
 }
@@ -168,30 +182,23 @@ data_source_cancel(struct weston_data_source *source)
 }
 
 static void
-weston_wm_get_selection_targets(struct weston_wm *wm)
+weston_wm_selection_targets_reply(struct weston_wm *wm, void *property_reply,
+				  void *data)
 {
+	xcb_get_property_reply_t *reply = property_reply;
 	struct x11_data_source *source;
 	struct weston_compositor *compositor;
 	struct weston_seat *seat = weston_wm_pick_seat(wm);
-	xcb_get_property_cookie_t cookie;
-	xcb_get_property_reply_t *reply;
 	xcb_atom_t *value;
 	char **p;
 	uint32_t i;
 
-	cookie = xcb_get_property(wm->conn,
-				  1, /* delete */
-				  wm->selection_window,
-				  wm->atom.wl_selection,
-				  XCB_GET_PROPERTY_TYPE_ANY,
-				  0, /* offset */
-				  4096 /* length */);
-
-	reply = xcb_get_property_reply(wm->conn, cookie, NULL);
 	if (reply == NULL)
 		return;
 
+#ifdef WM_DEBUG
 	dump_property(wm, wm->atom.wl_selection, reply);
+#endif
 
 	if (reply->type != XCB_ATOM_ATOM) {
 		free(reply);
@@ -228,10 +235,9 @@ weston_wm_get_selection_targets(struct weston_wm *wm)
 }
 
 static void
-weston_wm_get_selection_data(struct weston_wm *wm)
+weston_wm_get_selection_targets(struct weston_wm *wm)
 {
 	xcb_get_property_cookie_t cookie;
-	xcb_get_property_reply_t *reply;
 
 	cookie = xcb_get_property(wm->conn,
 				  1, /* delete */
@@ -239,11 +245,21 @@ weston_wm_get_selection_data(struct weston_wm *wm)
 				  wm->atom.wl_selection,
 				  XCB_GET_PROPERTY_TYPE_ANY,
 				  0, /* offset */
-				  0x1fffffff /* length */);
+				  4096 /* length */);
 
-	reply = xcb_get_property_reply(wm->conn, cookie, NULL);
+	weston_wm_request(wm, cookie.sequence,
+			  weston_wm_selection_targets_reply, NULL);
+}
 
+static void
+weston_wm_selection_data_reply(struct weston_wm *wm, void *property_reply,
+			       void *data)
+{
+	xcb_get_property_reply_t *reply = property_reply;
+
+#ifdef WM_DEBUG
 	dump_property(wm, wm->atom.wl_selection, reply);
+#endif
 
 	if (reply == NULL) {
 		return;
@@ -258,6 +274,23 @@ weston_wm_get_selection_data(struct weston_wm *wm)
 	}
 }
 
+static void
+weston_wm_get_selection_data(struct weston_wm *wm)
+{
+	xcb_get_property_cookie_t cookie;
+
+	cookie = xcb_get_property(wm->conn,
+				  1, /* delete */
+				  wm->selection_window,
+				  wm->atom.wl_selection,
+				  XCB_GET_PROPERTY_TYPE_ANY,
+				  0, /* offset */
+				  0x1fffffff /* length */);
+
+	weston_wm_request(wm, cookie.sequence,
+			  weston_wm_selection_data_reply, NULL);
+}
+
 static void
 weston_wm_handle_selection_notify(struct weston_wm *wm,
 				xcb_generic_event_t *event)
@@ -274,7 +307,9 @@ weston_wm_handle_selection_notify(struct weston_wm *wm,
 	}
 }
 
-static const size_t incr_chunk_size = 64 * 1024;
+/* The first INCR chunk, doubled for every full chunk up to
+ * weston_wm::selection_chunk_max. */
+static const uint32_t incr_chunk_size = 64 * 1024;
 
 static void
 weston_wm_send_selection_notify(struct weston_wm *wm, xcb_atom_t property)
@@ -349,6 +384,14 @@ weston_wm_flush_source_data(struct weston_wm *wm)
 	length = wm->source_data.size;
 	wm->source_data.size = 0;
 
+	/* Fewer round trips for the next ones */
+	if (wm->incr && length == (int) wm->selection_chunk_size &&
+	    wm->selection_chunk_size < wm->selection_chunk_max) {
+		wm->selection_chunk_size *= 2;
+		if (wm->selection_chunk_size > wm->selection_chunk_max)
+			wm->selection_chunk_size = wm->selection_chunk_max;
+	}
+
 	return length;
 }
 
@@ -356,17 +399,29 @@ static int
 weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 {
 	struct weston_wm *wm = data;
-	int len, current, available;
+	size_t current, available;
+	ssize_t len;
 	void *p;
 
+	/* The buffer holds one chunk at most, reading stops when it is
+	 * full until the requestor took it. */
 	current = wm->source_data.size;
-	if (wm->source_data.size < incr_chunk_size)
-		p = wl_array_add(&wm->source_data, incr_chunk_size);
-	else
-		p = (char *) wm->source_data.data + wm->source_data.size;
-	available = wm->source_data.alloc - current;
+	if (wm->source_data.alloc < wm->selection_chunk_size) {
+		if (!wl_array_add(&wm->source_data,
+				  wm->selection_chunk_size - current)) {
+			len = -1;
+			goto err_read;
+		}
+		wm->source_data.size = current;
+	}
+	p = (char *) wm->source_data.data + current;
+	available = wm->selection_chunk_size - current;
 
 	len = read(fd, p, available);
+	if (len == -1 && errno == EAGAIN)
+		return 1;
+
+err_read:
 	if (len == -1) {
 		weston_log("read error from data source: %m\n");
 		weston_wm_send_selection_notify(wm, XCB_ATOM_NONE);
@@ -374,16 +429,18 @@ weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 		wm->property_source = NULL;
 		close(fd);
 		wl_array_release(&wm->source_data);
+		wl_array_init(&wm->source_data);
+		return 1;
 	}
 
-	weston_log("read %d (available %d, mask 0x%x) bytes: \"%.*s\"\n",
-		len, available, mask, len, (char *) p);
+	wm_log("read %zd (available %zu, mask 0x%x) bytes\n",
+	       len, available, mask);
 
 	wm->source_data.size = current + len;
-	if (wm->source_data.size >= incr_chunk_size) {
+	if (wm->source_data.size >= wm->selection_chunk_size) {
 		if (!wm->incr) {
-			weston_log("got %zu bytes, starting incr\n",
-				wm->source_data.size);
+			wm_log("got %zu bytes, starting incr\n",
+			       wm->source_data.size);
 			wm->incr = 1;
 			xcb_change_property(wm->conn,
 					    XCB_PROP_MODE_REPLACE,
@@ -398,20 +455,20 @@ weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 			wm->property_source = NULL;
 			weston_wm_send_selection_notify(wm, wm->selection_request.property);
 		} else if (wm->selection_property_set) {
-			weston_log("got %zu bytes, waiting for "
-				"property delete\n", wm->source_data.size);
+			wm_log("got %zu bytes, waiting for "
+			       "property delete\n", wm->source_data.size);
 
 			wm->flush_property_on_delete = 1;
 			wl_event_source_remove(wm->property_source);
 			wm->property_source = NULL;
 		} else {
-			weston_log("got %zu bytes, "
-				"property deleted, seting new property\n",
-				wm->source_data.size);
+			wm_log("got %zu bytes, "
+			       "property deleted, seting new property\n",
+			       wm->source_data.size);
 			weston_wm_flush_source_data(wm);
 		}
 	} else if (len == 0 && !wm->incr) {
-		weston_log("non-incr transfer complete\n");
+		wm_log("non-incr transfer complete\n");
 		/* Non-incr transfer all done. */
 		weston_wm_flush_source_data(wm);
 		weston_wm_send_selection_notify(wm, wm->selection_request.property);
@@ -422,16 +479,16 @@ weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 		wl_array_release(&wm->source_data);
 		wm->selection_request.requestor = XCB_NONE;
 	} else if (len == 0 && wm->incr) {
-		weston_log("incr transfer complete\n");
+		wm_log("incr transfer complete\n");
 
 		wm->flush_property_on_delete = 1;
 		if (wm->selection_property_set) {
-			weston_log("got %zu bytes, waiting for "
-				"property delete\n", wm->source_data.size);
+			wm_log("got %zu bytes, waiting for "
+			       "property delete\n", wm->source_data.size);
 		} else {
-			weston_log("got %zu bytes, "
-				"property deleted, seting new property\n",
-				wm->source_data.size);
+			wm_log("got %zu bytes, "
+			       "property deleted, seting new property\n",
+			       wm->source_data.size);
 			weston_wm_flush_source_data(wm);
 		}
 		xcb_flush(wm->conn);
@@ -441,7 +498,7 @@ weston_wm_read_data_source(int fd, uint32_t mask, void *data)
 		wm->data_source_fd = -1;
 		close(fd);
 	} else {
-		weston_log("nothing happened, buffered the bytes\n");
+		wm_log("nothing happened, buffered the bytes\n");
 	}
 
 	return 1;
@@ -461,6 +518,7 @@ weston_wm_send_data(struct weston_wm *wm, xcb_atom_t target, const char *mime_ty
 	}
 
 	wl_array_init(&wm->source_data);
+	wm->selection_chunk_size = incr_chunk_size;
 	wm->selection_target = target;
 	wm->data_source_fd = p[0];
 	wm->property_source = wl_event_loop_add_fd(wm->server->loop,
@@ -479,12 +537,12 @@ weston_wm_send_incr_chunk(struct weston_wm *wm)
 {
 	int length;
 
-	weston_log("property deleted\n");
+	wm_log("property deleted\n");
 
 	wm->selection_property_set = 0;
 	if (wm->flush_property_on_delete) {
-		weston_log("setting new property, %zu bytes\n",
-			wm->source_data.size);
+		wm_log("setting new property, %zu bytes\n",
+		       wm->source_data.size);
 		wm->flush_property_on_delete = 0;
 		length = weston_wm_flush_source_data(wm);
 
@@ -539,12 +597,14 @@ weston_wm_handle_selection_request(struct weston_wm *wm,
 	xcb_selection_request_event_t *selection_request =
 		(xcb_selection_request_event_t *) event;
 
-	weston_log("selection request, %s, ",
-		get_atom_name(wm->conn, selection_request->selection));
-	weston_log_continue("target %s, ",
-		get_atom_name(wm->conn, selection_request->target));
-	weston_log_continue("property %s\n",
-		get_atom_name(wm->conn, selection_request->property));
+#ifdef WM_DEBUG
+	wm_log("selection request, %s, ",
+	       get_atom_name(wm->conn, selection_request->selection));
+	wm_log_continue("target %s, ",
+			get_atom_name(wm->conn, selection_request->target));
+	wm_log_continue("property %s\n",
+			get_atom_name(wm->conn, selection_request->property));
+#endif
 
 	wm->selection_request = *selection_request;
 	wm->incr = 0;
@@ -568,7 +628,7 @@ weston_wm_handle_selection_request(struct weston_wm *wm,
 		weston_wm_send_data(wm, wm->atom.utf8_string,
 				  "text/plain;charset=utf-8");
 	} else {
-		weston_log("can only handle UTF8_STRING targets...\n");
+		wm_log("can only handle UTF8_STRING targets...\n");
 		weston_wm_send_selection_notify(wm, XCB_ATOM_NONE);
 	}
 }
@@ -586,7 +646,7 @@ weston_wm_handle_xfixes_selection_notify(struct weston_wm *wm,
 	if (xfixes_selection_notify->selection != wm->atom.clipboard)
 		return 0;
 
-	weston_log("xfixes selection notify event: owner %d\n",
+	wm_log("xfixes selection notify event: owner %d\n",
 	       xfixes_selection_notify->owner);
 
 	if (xfixes_selection_notify->owner == XCB_WINDOW_NONE) {
@@ -610,7 +670,7 @@ weston_wm_handle_xfixes_selection_notify(struct weston_wm *wm,
 	 * answer TIMESTAMP conversion requests correctly. */
 	if (xfixes_selection_notify->owner == wm->selection_window) {
 		wm->selection_timestamp = xfixes_selection_notify->timestamp;
-		weston_log("our window, skipping\n");
+		wm_log("our window, skipping\n");
 		return 1;
 	}
 
@@ -680,9 +740,17 @@ weston_wm_selection_init(struct weston_wm *wm)
 {
 	struct weston_seat *seat;
 	uint32_t values[1], mask;
+	uint64_t max_request;
 
 	wm->selection_request.requestor = XCB_NONE;
 
+	/* A chunk is sent in a single ChangeProperty request, leave room
+	 * for its header. The length is in units of four bytes. */
+	max_request = xcb_get_maximum_request_length(wm->conn);
+	wm->selection_chunk_max = MIN(max_request * 4 - 64, 1024 * 1024);
+	wm->selection_chunk_max = MAX(wm->selection_chunk_max,
+				      incr_chunk_size);
+
 	values[0] = XCB_EVENT_MASK_PROPERTY_CHANGE;
 	wm->selection_window = xcb_generate_id(wm->conn);
 	xcb_create_window(wm->conn,
@@ -125,6 +125,32 @@ struct motif_wm_hints {
 #define _NET_WM_MOVERESIZE_MOVE_KEYBOARD    10   /* move via keyboard */
 #define _NET_WM_MOVERESIZE_CANCEL           11   /* cancel operation */
 
+/* The properties read by weston_wm_window_fetch_properties(), as bits of
+ * weston_wm_window::properties_dirty */
+enum window_property_index {
+	WINDOW_PROP_CLASS = 0,
+	WINDOW_PROP_NAME,
+	WINDOW_PROP_TRANSIENT_FOR,
+	WINDOW_PROP_PROTOCOLS,
+	WINDOW_PROP_NORMAL_HINTS,
+	WINDOW_PROP_NET_WM_STATE,
+	WINDOW_PROP_WINDOW_TYPE,
+	WINDOW_PROP_NET_WM_NAME,
+	WINDOW_PROP_PID,
+	WINDOW_PROP_MOTIF_HINTS,
+	WINDOW_PROP_CLIENT_MACHINE,
+	WINDOW_PROPERTY_COUNT
+};
+
+#define WINDOW_PROPERTIES_ALL ((1u << WINDOW_PROPERTY_COUNT) - 1)
+
+/* What the frame window shows */
+enum window_decoration {
+	WINDOW_DECORATION_NONE = 0,
+	WINDOW_DECORATION_FRAME,
+	WINDOW_DECORATION_SHADOW,
+};
+
 struct weston_wm_window {
 	struct weston_wm *wm;
 	xcb_window_t id;
@@ -137,7 +163,18 @@ struct weston_wm_window {
 	struct wl_listener surface_destroy_listener;
 	struct wl_event_source *repaint_source;
 	struct wl_event_source *configure_source;
-	int properties_dirty;
+	enum window_decoration drawn_decoration;
+	int drawn_width, drawn_height;
+	uint32_t properties_dirty;
+	uint32_t properties_fetching;
+	struct weston_wm_request *property_request;
+	xcb_get_property_cookie_t property_cookies[WINDOW_PROPERTY_COUNT];
+	xcb_get_geometry_cookie_t geometry_cookie;
+	bool geometry_pending;
+	/* Waiting for the properties to handle these */
+	bool map_request_pending;
+	bool shell_surface_pending;
+	bool repaint_deferred;
 	int pid;
 	char *machine;
 	char *class;
@@ -174,7 +211,7 @@ static void
 xserver_map_shell_surface(struct weston_wm_window *window,
 			  struct weston_surface *surface);
 
-static int __attribute__ ((format (printf, 1, 2)))
+int
 wm_log(const char *fmt, ...)
 {
 #ifdef WM_DEBUG
@@ -191,7 +228,7 @@ wm_log(const char *fmt, ...)
 #endif
 }
 
-static int __attribute__ ((format (printf, 1, 2)))
+int
 wm_log_continue(const char *fmt, ...)
 {
 #ifdef WM_DEBUG
@@ -218,6 +255,108 @@ wm_lookup_window(struct weston_wm *wm, xcb_window_t hash,
 	return false;
 }
 
+/* A request whose reply is handled once it arrives, from the event loop,
+ * instead of waiting for it. The replies come in the order the requests
+ * were sent, so once a reply is in, the earlier ones are too and can be
+ * read without blocking. */
+struct weston_wm_request {
+	struct wl_list link;
+	unsigned int sequence;
+	weston_wm_reply_func_t func;
+	void *data;
+};
+
+/** Handle the reply to a request when it arrives
+ *
+ * \param wm The window manager.
+ * \param sequence The sequence number of the request, from its cookie.
+ * \param func The reply handler.
+ * \param data User data for the handler.
+ * \return The pending request, or NULL if the handler was called already.
+ *
+ * The request must be flushed by the caller, which the event handler does
+ * after handling the X events.
+ */
+struct weston_wm_request *
+weston_wm_request(struct weston_wm *wm, unsigned int sequence,
+		  weston_wm_reply_func_t func, void *data)
+{
+	struct weston_wm_request *request;
+	xcb_generic_error_t *error = NULL;
+
+	request = zalloc(sizeof *request);
+	if (request == NULL) {
+		/* Better late than never. */
+		func(wm, xcb_wait_for_reply(wm->conn, sequence, &error), data);
+		free(error);
+		return NULL;
+	}
+
+	request->sequence = sequence;
+	request->func = func;
+	request->data = data;
+	wl_list_insert(wm->request_list.prev, &request->link);
+
+	return request;
+}
+
+/** Drop a pending request, discarding its reply */
+void
+weston_wm_request_cancel(struct weston_wm *wm,
+			 struct weston_wm_request *request)
+{
+	xcb_discard_reply(wm->conn, request->sequence);
+	wl_list_remove(&request->link);
+	free(request);
+}
+
+/* Whether the server handled the request before sending the event, by
+ * the low 16 bits of the sequence numbers the event carries. */
+static bool
+request_precedes_event(struct weston_wm_request *request,
+		       const xcb_generic_event_t *event)
+{
+	uint16_t diff = event->sequence - (uint16_t) request->sequence;
+
+	return diff < 0x8000;
+}
+
+/* Run the handlers of the replies that arrived, in order, stopping at
+ * the first request that was handled after the event, if one is given,
+ * so that the handlers and the event handlers see the server state
+ * changes in the order the server made them. */
+static int
+weston_wm_dispatch_replies(struct weston_wm *wm,
+			   const xcb_generic_event_t *event)
+{
+	struct weston_wm_request *request;
+	xcb_generic_error_t *error;
+	void *reply;
+	int count = 0;
+
+	/* The handlers may cancel or send requests. */
+	while (!wl_list_empty(&wm->request_list)) {
+		request = container_of(wm->request_list.next,
+				       struct weston_wm_request, link);
+
+		if (event && !request_precedes_event(request, event))
+			break;
+
+		error = NULL;
+		if (!xcb_poll_for_reply(wm->conn, request->sequence,
+					&reply, &error))
+			break;
+		free(error);
+
+		wl_list_remove(&request->link);
+		request->func(wm, reply, request->data);
+		free(request);
+		count++;
+	}
+
+	return count;
+}
+
 const char *
 get_atom_name(xcb_connection_t *c, xcb_atom_t atom)
 {
@@ -370,21 +509,29 @@ dump_property(struct weston_wm *wm,
 	}
 }
 
+#ifdef WM_DEBUG
+static void
+dump_property_reply(struct weston_wm *wm, void *reply, void *data)
+{
+	xcb_atom_t property = (uintptr_t) data;
+
+	dump_property(wm, property, reply);
+
+	free(reply);
+}
+
 static void
 read_and_dump_property(struct weston_wm *wm,
 		       xcb_window_t window, xcb_atom_t property)
 {
-	xcb_get_property_reply_t *reply;
 	xcb_get_property_cookie_t cookie;
 
 	cookie = xcb_get_property(wm->conn, 0, window,
 				  property, XCB_ATOM_ANY, 0, 2048);
-	reply = xcb_get_property_reply(wm->conn, cookie, NULL);
-
-	dump_property(wm, property, reply);
-
-	free(reply);
+	weston_wm_request(wm, cookie.sequence, dump_property_reply,
+			  (void *) (uintptr_t) property);
 }
+#endif
 
 /* We reuse some predefined, but otherwise useles atoms */
 #define TYPE_WM_PROTOCOLS	XCB_ATOM_CUT_BUFFER0
@@ -392,139 +539,335 @@ read_and_dump_property(struct weston_wm *wm,
 #define TYPE_NET_WM_STATE	XCB_ATOM_CUT_BUFFER2
 #define TYPE_WM_NORMAL_HINTS	XCB_ATOM_CUT_BUFFER3
 
+struct window_property {
+	xcb_atom_t atom;
+	xcb_atom_t type;
+	int offset;
+};
+
 static void
-weston_wm_window_read_properties(struct weston_wm_window *window)
+weston_wm_get_window_properties(struct weston_wm *wm,
+				struct window_property *props)
 {
-	struct weston_wm *wm = window->wm;
-	const struct weston_desktop_xwayland_interface *xwayland_interface =
-		wm->server->compositor->xwayland_interface;
-
 #define F(field) offsetof(struct weston_wm_window, field)
-	const struct {
-		xcb_atom_t atom;
-		xcb_atom_t type;
-		int offset;
-	} props[] = {
-		{ XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, F(class) },
-		{ XCB_ATOM_WM_NAME, XCB_ATOM_STRING, F(name) },
-		{ XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, F(transient_for) },
-		{ wm->atom.wm_protocols, TYPE_WM_PROTOCOLS, F(protocols) },
-		{ wm->atom.wm_normal_hints, TYPE_WM_NORMAL_HINTS, F(protocols) },
-		{ wm->atom.net_wm_state, TYPE_NET_WM_STATE },
-		{ wm->atom.net_wm_window_type, XCB_ATOM_ATOM, F(type) },
-		{ wm->atom.net_wm_name, XCB_ATOM_STRING, F(name) },
-		{ wm->atom.net_wm_pid, XCB_ATOM_CARDINAL, F(pid) },
-		{ wm->atom.motif_wm_hints, TYPE_MOTIF_WM_HINTS, 0 },
-		{ wm->atom.wm_client_machine, XCB_ATOM_WM_CLIENT_MACHINE, F(machine) },
+	const struct window_property table[WINDOW_PROPERTY_COUNT] = {
+		[WINDOW_PROP_CLASS] =
+			{ XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, F(class) },
+		[WINDOW_PROP_NAME] =
+			{ XCB_ATOM_WM_NAME, XCB_ATOM_STRING, F(name) },
+		[WINDOW_PROP_TRANSIENT_FOR] =
+			{ XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, F(transient_for) },
+		[WINDOW_PROP_PROTOCOLS] =
+			{ wm->atom.wm_protocols, TYPE_WM_PROTOCOLS, F(protocols) },
+		[WINDOW_PROP_NORMAL_HINTS] =
+			{ wm->atom.wm_normal_hints, TYPE_WM_NORMAL_HINTS, F(protocols) },
+		[WINDOW_PROP_NET_WM_STATE] =
+			{ wm->atom.net_wm_state, TYPE_NET_WM_STATE },
+		[WINDOW_PROP_WINDOW_TYPE] =
+			{ wm->atom.net_wm_window_type, XCB_ATOM_ATOM, F(type) },
+		[WINDOW_PROP_NET_WM_NAME] =
+			{ wm->atom.net_wm_name, XCB_ATOM_STRING, F(name) },
+		[WINDOW_PROP_PID] =
+			{ wm->atom.net_wm_pid, XCB_ATOM_CARDINAL, F(pid) },
+		[WINDOW_PROP_MOTIF_HINTS] =
+			{ wm->atom.motif_wm_hints, TYPE_MOTIF_WM_HINTS, 0 },
+		[WINDOW_PROP_CLIENT_MACHINE] =
+			{ wm->atom.wm_client_machine, XCB_ATOM_WM_CLIENT_MACHINE, F(machine) },
 	};
 #undef F
 
-	xcb_get_property_cookie_t cookie[ARRAY_LENGTH(props)];
-	xcb_get_property_reply_t *reply;
-	void *p;
-	uint32_t *xid;
-	xcb_atom_t *atom;
-	uint32_t i;
-	char name[1024];
+	memcpy(props, table, sizeof table);
+}
+
+static void
+weston_wm_window_properties_reply(struct weston_wm *wm, void *reply,
+				  void *data);
 
-	if (!window->properties_dirty)
+/* The properties to read again when the given one changes. WM_NAME and
+ * _NET_WM_NAME both set the title, the latter winning, and the pid is
+ * only trusted along with the client machine, so those go in pairs. */
+static uint32_t
+window_property_dirty_mask(enum window_property_index index)
+{
+	const uint32_t title = 1u << WINDOW_PROP_NAME |
+			       1u << WINDOW_PROP_NET_WM_NAME;
+	const uint32_t pid = 1u << WINDOW_PROP_PID |
+			     1u << WINDOW_PROP_CLIENT_MACHINE;
+
+	if (title & (1u << index))
+		return title;
+	if (pid & (1u << index))
+		return pid;
+
+	return 1u << index;
+}
+
+/* The last property read by a fetch, whose reply comes after the others */
+static int
+window_properties_last(uint32_t mask)
+{
+	return 31 - __builtin_clz(mask);
+}
+
+/* Ask for the dirty properties of the window, all at once. The replies
+ * are applied when they arrive; until then the window keeps the values
+ * it has, and the actions that need them up to date wait for them. */
+static void
+weston_wm_window_fetch_properties(struct weston_wm_window *window)
+{
+	struct weston_wm *wm = window->wm;
+	struct window_property props[WINDOW_PROPERTY_COUNT];
+	struct weston_wm_request *request;
+	int i;
+
+	/* Fetched when the replies in flight are in. */
+	if (window->property_request || !window->properties_dirty)
 		return;
-	window->properties_dirty = 0;
 
-	for (i = 0; i < ARRAY_LENGTH(props); i++)
-		cookie[i] = xcb_get_property(wm->conn,
-					     0, /* delete */
-					     window->id,
-					     props[i].atom,
-					     XCB_ATOM_ANY, 0, 2048);
-
-	window->decorate = window->override_redirect ? 0 : MWM_DECOR_EVERYTHING;
-	window->size_hints.flags = 0;
-	window->motif_hints.flags = 0;
-	window->delete_window = 0;
-
-	for (i = 0; i < ARRAY_LENGTH(props); i++)  {
-		reply = xcb_get_property_reply(wm->conn, cookie[i], NULL);
-		if (!reply)
-			/* Bad window, typically */
+	weston_wm_get_window_properties(wm, props);
+	for (i = 0; i < WINDOW_PROPERTY_COUNT; i++) {
+		if (!(window->properties_dirty & (1u << i)))
 			continue;
-		if (reply->type == XCB_ATOM_NONE) {
-			/* No such property */
-			free(reply);
+
+		window->property_cookies[i] =
+			xcb_get_property(wm->conn,
+					 0, /* delete */
+					 window->id,
+					 props[i].atom,
+					 XCB_ATOM_ANY, 0, 2048);
+	}
+
+	window->properties_fetching = window->properties_dirty;
+	window->properties_dirty = 0;
+
+	i = window_properties_last(window->properties_fetching);
+	request = weston_wm_request(wm, window->property_cookies[i].sequence,
+				    weston_wm_window_properties_reply, window);
+	if (request)
+		window->property_request = request;
+}
+
+/* Mark a property changed, if the window manager reads it, and fetch it */
+static void
+weston_wm_window_property_changed(struct weston_wm_window *window,
+				  xcb_atom_t atom)
+{
+	struct window_property props[WINDOW_PROPERTY_COUNT];
+	int i;
+
+	weston_wm_get_window_properties(window->wm, props);
+	for (i = 0; i < WINDOW_PROPERTY_COUNT; i++) {
+		if (props[i].atom != atom)
 			continue;
-		}
 
-		p = ((char *) window + props[i].offset);
+		window->properties_dirty |= window_property_dirty_mask(i);
+		weston_wm_window_fetch_properties(window);
+		return;
+	}
+}
 
-		switch (props[i].type) {
-		case XCB_ATOM_WM_CLIENT_MACHINE:
-		case XCB_ATOM_STRING:
-			/* FIXME: We're using this for both string and
-			   utf8_string */
-			if (*(char **) p)
-				free(*(char **) p);
+/* Discard the replies to the requests of a window in flight */
+static void
+weston_wm_window_cancel_requests(struct weston_wm_window *window)
+{
+	struct weston_wm *wm = window->wm;
+	int i, last;
 
-			*(char **) p =
-				strndup(xcb_get_property_value(reply),
-					xcb_get_property_value_length(reply));
-			break;
-		case XCB_ATOM_WINDOW:
-			xid = xcb_get_property_value(reply);
-			if (!wm_lookup_window(wm, *xid, p))
-				weston_log("XCB_ATOM_WINDOW contains window"
-					   " id not found in hash table.\n");
-			break;
-		case XCB_ATOM_CARDINAL:
-		case XCB_ATOM_ATOM:
-			atom = xcb_get_property_value(reply);
-			*(xcb_atom_t *) p = *atom;
-			break;
-		case TYPE_WM_PROTOCOLS:
-			atom = xcb_get_property_value(reply);
-			for (i = 0; i < reply->value_len; i++)
-				if (atom[i] == wm->atom.wm_delete_window) {
-					window->delete_window = 1;
-					break;
-				}
-			break;
-		case TYPE_WM_NORMAL_HINTS:
-			memcpy(&window->size_hints,
-			       xcb_get_property_value(reply),
-			       sizeof window->size_hints);
-			break;
-		case TYPE_NET_WM_STATE:
-			window->fullscreen = 0;
-			atom = xcb_get_property_value(reply);
-			for (i = 0; i < reply->value_len; i++) {
-				if (atom[i] == wm->atom.net_wm_state_fullscreen)
-					window->fullscreen = 1;
-				if (atom[i] == wm->atom.net_wm_state_maximized_vert)
-					window->maximized_vert = 1;
-				if (atom[i] == wm->atom.net_wm_state_maximized_horz)
-					window->maximized_horz = 1;
-			}
-			break;
-		case TYPE_MOTIF_WM_HINTS:
-			memcpy(&window->motif_hints,
-			       xcb_get_property_value(reply),
-			       sizeof window->motif_hints);
-			if (window->motif_hints.flags & MWM_HINTS_DECORATIONS) {
-				if (window->motif_hints.decorations & MWM_DECOR_ALL)
-					/* MWM_DECOR_ALL means all except the other values listed. */
-					window->decorate =
-						MWM_DECOR_EVERYTHING & (~window->motif_hints.decorations);
-				else
-					window->decorate =
-						window->motif_hints.decorations;
+	if (window->geometry_pending)
+		xcb_discard_reply(wm->conn, window->geometry_cookie.sequence);
+	window->geometry_pending = false;
+
+	if (!window->property_request)
+		return;
+
+	last = window_properties_last(window->properties_fetching);
+	for (i = 0; i < last; i++)
+		if (window->properties_fetching & (1u << i))
+			xcb_discard_reply(wm->conn,
+					  window->property_cookies[i].sequence);
+	weston_wm_request_cancel(wm, window->property_request);
+	window->property_request = NULL;
+	window->properties_fetching = 0;
+}
+
+/* Returns whether a string property differs from the value the window
+ * holds, so the unchanged ones are neither copied again nor redrawn. */
+static bool
+weston_wm_window_apply_property(struct weston_wm_window *window,
+				const struct window_property *prop,
+				xcb_get_property_reply_t *reply)
+{
+	struct weston_wm *wm = window->wm;
+	void *p = ((char *) window + prop->offset);
+	const char *value;
+	uint32_t *xid;
+	xcb_atom_t *atom;
+	uint32_t i;
+	int len;
+
+	switch (prop->type) {
+	case XCB_ATOM_WM_CLIENT_MACHINE:
+	case XCB_ATOM_STRING:
+		/* FIXME: We're using this for both string and
+		   utf8_string */
+		value = xcb_get_property_value(reply);
+		len = xcb_get_property_value_length(reply);
+		if (*(char **) p &&
+		    strnlen(*(char **) p, len + 1) == (size_t) len &&
+		    memcmp(*(char **) p, value, len) == 0)
+			return false;
+
+		free(*(char **) p);
+		*(char **) p = strndup(value, len);
+		break;
+	case XCB_ATOM_WINDOW:
+		xid = xcb_get_property_value(reply);
+		if (!wm_lookup_window(wm, *xid, p))
+			weston_log("XCB_ATOM_WINDOW contains window"
+				   " id not found in hash table.\n");
+		break;
+	case XCB_ATOM_CARDINAL:
+	case XCB_ATOM_ATOM:
+		atom = xcb_get_property_value(reply);
+		*(xcb_atom_t *) p = *atom;
+		break;
+	case TYPE_WM_PROTOCOLS:
+		atom = xcb_get_property_value(reply);
+		for (i = 0; i < reply->value_len; i++)
+			if (atom[i] == wm->atom.wm_delete_window) {
+				window->delete_window = 1;
+				break;
 			}
-			break;
-		default:
-			break;
+		break;
+	case TYPE_WM_NORMAL_HINTS:
+		memcpy(&window->size_hints,
+		       xcb_get_property_value(reply),
+		       sizeof window->size_hints);
+		break;
+	case TYPE_NET_WM_STATE:
+		window->fullscreen = 0;
+		atom = xcb_get_property_value(reply);
+		for (i = 0; i < reply->value_len; i++) {
+			if (atom[i] == wm->atom.net_wm_state_fullscreen)
+				window->fullscreen = 1;
+			if (atom[i] == wm->atom.net_wm_state_maximized_vert)
+				window->maximized_vert = 1;
+			if (atom[i] == wm->atom.net_wm_state_maximized_horz)
+				window->maximized_horz = 1;
 		}
-		free(reply);
+		break;
+	case TYPE_MOTIF_WM_HINTS:
+		memcpy(&window->motif_hints,
+		       xcb_get_property_value(reply),
+		       sizeof window->motif_hints);
+		if (window->motif_hints.flags & MWM_HINTS_DECORATIONS) {
+			if (window->motif_hints.decorations & MWM_DECOR_ALL)
+				/* MWM_DECOR_ALL means all except the other values listed. */
+				window->decorate =
+					MWM_DECOR_EVERYTHING & (~window->motif_hints.decorations);
+			else
+				window->decorate =
+					window->motif_hints.decorations;
+		}
+		break;
+	default:
+		break;
+	}
+
+	return true;
+}
+
+static void
+weston_wm_window_properties_ready(struct weston_wm_window *window,
+				  bool visible_changed);
+
+static void
+weston_wm_window_properties_reply(struct weston_wm *wm, void *last_reply,
+				  void *data)
+{
+	struct weston_wm_window *window = data;
+	const struct weston_desktop_xwayland_interface *xwayland_interface =
+		wm->server->compositor->xwayland_interface;
+	xcb_get_property_reply_t *replies[WINDOW_PROPERTY_COUNT] = { NULL };
+	struct window_property props[WINDOW_PROPERTY_COUNT];
+	xcb_get_geometry_reply_t *geometry_reply;
+	uint32_t fetched = window->properties_fetching;
+	bool title_changed = false, visible_changed;
+	int decorate, fullscreen, maximized_vert, maximized_horz, has_alpha;
+	uint32_t i;
+	int last;
+	char name[1024];
+
+	window->property_request = NULL;
+	window->properties_fetching = 0;
+
+	decorate = window->decorate;
+	fullscreen = window->fullscreen;
+	maximized_vert = window->maximized_vert;
+	maximized_horz = window->maximized_horz;
+	has_alpha = window->has_alpha;
+
+	/* The earlier replies are in already, these do not block. */
+	if (window->geometry_pending) {
+		geometry_reply =
+			xcb_get_geometry_reply(wm->conn,
+					       window->geometry_cookie, NULL);
+		/* technically we should use XRender and check the visual
+		 * format's alpha_mask, but checking depth is simpler and
+		 * works in all known cases */
+		if (geometry_reply != NULL)
+			window->has_alpha = geometry_reply->depth == 32;
+		free(geometry_reply);
+		window->geometry_pending = false;
+	}
+
+	last = window_properties_last(fetched);
+	for (i = 0; i < WINDOW_PROPERTY_COUNT; i++) {
+		if (!(fetched & (1u << i)))
+			continue;
+		if (i == (uint32_t) last)
+			replies[i] = last_reply;
+		else
+			replies[i] = xcb_get_property_reply(wm->conn,
+						window->property_cookies[i],
+						NULL);
+		/* A bad window typically, or a deleted property */
+		if (replies[i] && replies[i]->type == XCB_ATOM_NONE) {
+			free(replies[i]);
+			replies[i] = NULL;
+		}
+	}
+
+	/* Only the state derived from the properties read again is reset,
+	 * the rest is as the earlier replies left it. */
+	if (fetched & (1u << WINDOW_PROP_MOTIF_HINTS)) {
+		window->decorate = window->override_redirect ?
+			0 : MWM_DECOR_EVERYTHING;
+		window->motif_hints.flags = 0;
+	}
+	if (fetched & (1u << WINDOW_PROP_NORMAL_HINTS))
+		window->size_hints.flags = 0;
+	if (fetched & (1u << WINDOW_PROP_PROTOCOLS))
+		window->delete_window = 0;
+
+	/* _NET_WM_NAME takes precedence over WM_NAME. */
+	if (replies[WINDOW_PROP_NET_WM_NAME]) {
+		free(replies[WINDOW_PROP_NAME]);
+		replies[WINDOW_PROP_NAME] = NULL;
+	}
+
+	weston_wm_get_window_properties(wm, props);
+	for (i = 0; i < WINDOW_PROPERTY_COUNT; i++)  {
+		if (!replies[i])
+			continue;
+		if (weston_wm_window_apply_property(window, &props[i],
+						    replies[i]) &&
+		    (i == WINDOW_PROP_NAME || i == WINDOW_PROP_NET_WM_NAME))
+			title_changed = true;
+		free(replies[i]);
 	}
 
-	if (window->pid > 0) {
+	if ((fetched & (1u << WINDOW_PROP_PID)) && window->pid > 0) {
 		gethostname(name, sizeof(name));
 		for (i = 0; i < sizeof(name); i++) {
 			if (name[i] == '\0')
@@ -540,12 +883,26 @@ weston_wm_window_read_properties(struct weston_wm_window *window)
 			window->pid = 0;
 	}
 
-	if (window->shsurf && window->name)
+	if (title_changed && window->shsurf && window->name)
 		xwayland_interface->set_title(window->shsurf, window->name);
-	if (window->frame && window->name)
+	if (title_changed && window->frame && window->name)
 		frame_set_title(window->frame, window->name);
-	if (window->shsurf && window->pid > 0)
+	if ((fetched & (1u << WINDOW_PROP_PID)) &&
+	    window->shsurf && window->pid > 0)
 		xwayland_interface->set_pid(window->shsurf, window->pid);
+
+	/* Nothing is drawn before the first replies. */
+	visible_changed = fetched == WINDOW_PROPERTIES_ALL ||
+			  title_changed ||
+			  window->decorate != decorate ||
+			  window->fullscreen != fullscreen ||
+			  window->maximized_vert != maximized_vert ||
+			  window->maximized_horz != maximized_horz ||
+			  window->has_alpha != has_alpha;
+
+	weston_wm_window_fetch_properties(window);
+
+	weston_wm_window_properties_ready(window, visible_changed);
 }
 
 static void
@@ -945,6 +1302,25 @@ weston_wm_window_set_virtual_desktop(struct weston_wm_window *window,
 	}
 }
 
+static void
+weston_wm_window_map(struct weston_wm_window *window)
+{
+	struct weston_wm *wm = window->wm;
+
+	if (window->frame_id == XCB_WINDOW_NONE)
+		weston_wm_window_create_frame(window);
+
+	wm_log("XCB_MAP_REQUEST (window %d, %p, frame %d)\n",
+	       window->id, window, window->frame_id);
+
+	weston_wm_window_set_wm_state(window, ICCCM_NORMAL_STATE);
+	weston_wm_window_set_net_wm_state(window);
+	weston_wm_window_set_virtual_desktop(window, 0);
+
+	xcb_map_window(wm->conn, window->id);
+	xcb_map_window(wm->conn, window->frame_id);
+}
+
 static void
 weston_wm_handle_map_request(struct weston_wm *wm, xcb_generic_event_t *event)
 {
@@ -961,20 +1337,14 @@ weston_wm_handle_map_request(struct weston_wm *wm, xcb_generic_event_t *event)
 	if (!wm_lookup_window(wm, map_request->window, &window))
 		return;
 
-	weston_wm_window_read_properties(window);
-
-	if (window->frame_id == XCB_WINDOW_NONE)
-		weston_wm_window_create_frame(window);
-
-	wm_log("XCB_MAP_REQUEST (window %d, %p, frame %d)\n",
-	       window->id, window, window->frame_id);
-
-	weston_wm_window_set_wm_state(window, ICCCM_NORMAL_STATE);
-	weston_wm_window_set_net_wm_state(window);
-	weston_wm_window_set_virtual_desktop(window, 0);
+	if (window->property_request) {
+		wm_log("XCB_MAP_REQUEST (window %d, waiting for properties)\n",
+		       window->id);
+		window->map_request_pending = true;
+		return;
+	}
 
-	xcb_map_window(wm->conn, map_request->window);
-	xcb_map_window(wm->conn, window->frame_id);
+	weston_wm_window_map(window);
 }
 
 static void
@@ -1028,11 +1398,14 @@ weston_wm_handle_unmap_notify(struct weston_wm *wm, xcb_generic_event_t *event)
 		wl_list_remove(&window->surface_destroy_listener.link);
 	window->surface = NULL;
 	window->shsurf = NULL;
+	window->shell_surface_pending = false;
 
 	weston_wm_window_set_wm_state(window, ICCCM_WITHDRAWN_STATE);
 	weston_wm_window_set_virtual_desktop(window, -1);
 
+	/* The server drops the contents of unmapped windows. */
 	xcb_unmap_window(wm->conn, window->frame_id);
+	window->drawn_decoration = WINDOW_DECORATION_NONE;
 }
 
 static void
@@ -1048,32 +1421,57 @@ weston_wm_window_draw_decoration(void *data)
 		wm->server->compositor->xwayland_interface;
 	uint32_t flags = 0;
 	struct weston_view *view;
-
-	weston_wm_window_read_properties(window);
+	bool unchanged;
 
 	window->repaint_source = NULL;
 
+	/* Repainted again when the properties are in. The replies refetch
+	 * what changed meanwhile, so a client that keeps changing its
+	 * properties always has a request in flight: defer only once and
+	 * draw with the current properties the next time. */
+	if (window->property_request && !window->repaint_deferred) {
+		window->repaint_deferred = true;
+		return;
+	}
+	window->repaint_deferred = false;
+
 	weston_wm_window_get_frame_size(window, &width, &height);
 	weston_wm_window_get_child_position(window, &x, &y);
 
 	cairo_xcb_surface_set_size(window->cairo_surface, width, height);
 	cr = cairo_create(window->cairo_surface);
 
+	/* The frame window keeps what was drawn last, only the changes
+	 * are drawn again. */
+	unchanged = window->drawn_width == width &&
+		    window->drawn_height == height;
+
 	if (window->fullscreen) {
 		/* nothing */
+		window->drawn_decoration = WINDOW_DECORATION_NONE;
 	} else if (window->decorate) {
 		if (wm->focus_window == window)
 			flags |= THEME_FRAME_ACTIVE;
 
-		frame_repaint(window->frame, cr);
-	} else {
+		if (unchanged &&
+		    window->drawn_decoration == WINDOW_DECORATION_FRAME)
+			frame_repaint_damaged(window->frame, cr);
+		else
+			frame_repaint(window->frame, cr);
+		window->drawn_decoration = WINDOW_DECORATION_FRAME;
+	} else if (!unchanged ||
+		   window->drawn_decoration != WINDOW_DECORATION_SHADOW) {
 		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
 		cairo_set_source_rgba(cr, 0, 0, 0, 0);
 		cairo_paint(cr);
 
 		render_shadow(cr, t->shadow, 2, 2, width + 8, height + 8, 64, 64);
+		window->drawn_decoration = WINDOW_DECORATION_SHADOW;
 	}
 
+	window->drawn_width = width;
+	window->drawn_height = height;
+
 	cairo_destroy(cr);
 
 	if (window->surface) {
@@ -1089,6 +1487,7 @@ weston_wm_window_draw_decoration(void *data)
 						  window->width + 2,
 						  window->height + 2);
 		}
+		window->surface->pending.opaque_changed = true;
 		wl_list_for_each(view, &window->surface->views, surface_link)
 			weston_view_geometry_dirty(view);
 
@@ -1106,6 +1505,7 @@ weston_wm_window_draw_decoration(void *data)
 
 		pixman_region32_init_rect(&window->surface->pending.input,
 					  input_x, input_y, input_w, input_h);
+		window->surface->pending.input_changed = true;
 
 		xwayland_interface->set_window_geometry(window->shsurf,
 							input_x, input_y, input_w, input_h);
@@ -1129,6 +1529,7 @@ weston_wm_window_schedule_repaint(struct weston_wm_window *window)
 				pixman_region32_init_rect(&window->surface->pending.opaque, 0, 0,
 							  width, height);
 			}
+			window->surface->pending.opaque_changed = true;
 			wl_list_for_each(view, &window->surface->views, surface_link)
 				weston_view_geometry_dirty(view);
 		}
@@ -1154,18 +1555,16 @@ weston_wm_handle_property_notify(struct weston_wm *wm, xcb_generic_event_t *even
 	if (!wm_lookup_window(wm, property_notify->window, &window))
 		return;
 
-	window->properties_dirty = 1;
+	weston_wm_window_property_changed(window, property_notify->atom);
 
 	wm_log("XCB_PROPERTY_NOTIFY: window %d, ", property_notify->window);
 	if (property_notify->state == XCB_PROPERTY_DELETE)
 		wm_log("deleted\n");
+#ifdef WM_DEBUG
 	else
 		read_and_dump_property(wm, property_notify->window,
 				       property_notify->atom);
-
-	if (property_notify->atom == wm->atom.net_wm_name ||
-	    property_notify->atom == XCB_ATOM_WM_NAME)
-		weston_wm_window_schedule_repaint(window);
+#endif
 }
 
 static void
@@ -1174,8 +1573,6 @@ weston_wm_window_create(struct weston_wm *wm,
 {
 	struct weston_wm_window *window;
 	uint32_t values[1];
-	xcb_get_geometry_cookie_t geometry_cookie;
-	xcb_get_geometry_reply_t *geometry_reply;
 
 	window = zalloc(sizeof *window);
 	if (window == NULL) {
@@ -1183,7 +1580,9 @@ weston_wm_window_create(struct weston_wm *wm,
 		return;
 	}
 
-	geometry_cookie = xcb_get_geometry(wm->conn, id);
+	/* Read along with the properties fetched below */
+	window->geometry_cookie = xcb_get_geometry(wm->conn, id);
+	window->geometry_pending = true;
 
 	values[0] = XCB_EVENT_MASK_PROPERTY_CHANGE |
                     XCB_EVENT_MASK_FOCUS_CHANGE;
@@ -1191,22 +1590,17 @@ weston_wm_window_create(struct weston_wm *wm,
 
 	window->wm = wm;
 	window->id = id;
-	window->properties_dirty = 1;
 	window->override_redirect = override;
 	window->width = width;
 	window->height = height;
 	window->x = x;
 	window->y = y;
 	window->pos_dirty = false;
-
-	geometry_reply = xcb_get_geometry_reply(wm->conn, geometry_cookie, NULL);
-	/* technically we should use XRender and check the visual format's
-	alpha_mask, but checking depth is simpler and works in all known cases */
-	if (geometry_reply != NULL)
-		window->has_alpha = geometry_reply->depth == 32;
-	free(geometry_reply);
+	window->properties_dirty = WINDOW_PROPERTIES_ALL;
 
 	hash_table_insert(wm->window_hash, id, window);
+
+	weston_wm_window_fetch_properties(window);
 }
 
 static void
@@ -1214,6 +1608,8 @@ weston_wm_window_destroy(struct weston_wm_window *window)
 {
 	struct weston_wm *wm = window->wm;
 
+	weston_wm_window_cancel_requests(window);
+
 	if (window->repaint_source)
 		wl_event_source_remove(window->repaint_source);
 	if (window->cairo_surface)
@@ -1497,6 +1893,7 @@ surface_destroy(struct wl_listener *listener, void *data)
 	 * Don't try to use it later. */
 	window->shsurf = NULL;
 	window->surface = NULL;
+	window->shell_surface_pending = false;
 }
 
 static void
@@ -1901,6 +2298,8 @@ weston_wm_handle_event(int fd, uint32_t mask, void *data)
 	int count = 0;
 
 	while (event = xcb_poll_for_event(wm->conn), event != NULL) {
+		count += weston_wm_dispatch_replies(wm, event);
+
 		if (weston_wm_handle_selection_event(wm, event)) {
 			free(event);
 			count++;
@@ -1969,6 +2368,10 @@ weston_wm_handle_event(int fd, uint32_t mask, void *data)
 		count++;
 	}
 
+	/* Reading the replies may queue events, which the check of the
+	 * source handles once this returns non-zero. */
+	count += weston_wm_dispatch_replies(wm, NULL);
+
 	if (count != 0)
 		xcb_flush(wm->conn);
 
@@ -2219,6 +2622,7 @@ weston_wm_create(struct weston_xserver *wxs, int fd)
 		return NULL;
 
 	wm->server = wxs;
+	wl_list_init(&wm->request_list);
 	wm->window_hash = hash_table_create();
 	if (wm->window_hash == NULL) {
 		free(wm);
@@ -2308,6 +2712,11 @@ weston_wm_create(struct weston_xserver *wxs, int fd)
 void
 weston_wm_destroy(struct weston_wm *wm)
 {
+	struct weston_wm_request *request, *next;
+
+	wl_list_for_each_safe(request, next, &wm->request_list, link)
+		free(request);
+
 	/* FIXME: Free windows in hash. */
 	hash_table_destroy(wm->window_hash);
 	weston_wm_destroy_cursors(wm);
@@ -2501,19 +2910,16 @@ weston_wm_window_type_inactive(struct weston_wm_window *window)
 	       window->type == wm->atom.net_wm_window_type_utility;
 }
 
+static void
+weston_wm_window_create_shell_surface(struct weston_wm_window *window);
+
 static void
 xserver_map_shell_surface(struct weston_wm_window *window,
 			  struct weston_surface *surface)
 {
 	struct weston_wm *wm = window->wm;
-	struct weston_desktop_xwayland *xwayland =
-		wm->server->compositor->xwayland;
 	const struct weston_desktop_xwayland_interface *xwayland_interface =
 		wm->server->compositor->xwayland_interface;
-	struct weston_output *output;
-	struct weston_wm_window *parent;
-
-	weston_wm_window_read_properties(window);
 
 	/* A weston_wm_window may have many different surfaces assigned
 	 * throughout its life, so we must make sure to remove the listener
@@ -2531,6 +2937,25 @@ xserver_map_shell_surface(struct weston_wm_window *window,
 	if (!xwayland_interface)
 		return;
 
+	if (window->property_request) {
+		window->shell_surface_pending = true;
+		return;
+	}
+
+	weston_wm_window_create_shell_surface(window);
+}
+
+static void
+weston_wm_window_create_shell_surface(struct weston_wm_window *window)
+{
+	struct weston_wm *wm = window->wm;
+	struct weston_desktop_xwayland *xwayland =
+		wm->server->compositor->xwayland;
+	const struct weston_desktop_xwayland_interface *xwayland_interface =
+		wm->server->compositor->xwayland_interface;
+	struct weston_output *output;
+	struct weston_wm_window *parent;
+
 	if (window->surface->committed) {
 		weston_log("warning, unexpected in %s: "
 			   "surface's configure hook is already set.\n",
@@ -2584,6 +3009,28 @@ xserver_map_shell_surface(struct weston_wm_window *window,
 	}
 }
 
+/* Carry on with what waited for the properties of the window, and redraw
+ * the decoration if they changed how it looks. */
+static void
+weston_wm_window_properties_ready(struct weston_wm_window *window,
+				  bool visible_changed)
+{
+	if (window->map_request_pending) {
+		window->map_request_pending = false;
+		weston_wm_window_map(window);
+	}
+
+	if (window->shell_surface_pending) {
+		window->shell_surface_pending = false;
+		if (window->surface)
+			weston_wm_window_create_shell_surface(window);
+	}
+
+	/* The decoration, or the opaque region of undecorated windows */
+	if (visible_changed || window->repaint_deferred)
+		weston_wm_window_schedule_repaint(window);
+}
+
 const struct weston_xwayland_surface_api surface_api = {
 	is_wm_window,
 	send_position,
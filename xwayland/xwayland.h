@@ -72,6 +72,7 @@ struct weston_wm {
 	struct wl_listener activate_listener;
 	struct wl_listener kill_listener;
 	struct wl_list unpaired_window_list;
+	struct wl_list request_list;	/* weston_wm_request::link */
 
 	xcb_window_t selection_window;
 	xcb_window_t selection_owner;
@@ -81,6 +82,8 @@ struct weston_wm {
 	xcb_get_property_reply_t *property_reply;
 	int property_start;
 	struct wl_array source_data;
+	uint32_t selection_chunk_size;	/* the current INCR chunk */
+	uint32_t selection_chunk_max;
 	xcb_selection_request_event_t selection_request;
 	xcb_atom_t selection_target;
 	xcb_timestamp_t selection_timestamp;
@@ -157,6 +160,25 @@ struct weston_wm {
 	} atom;
 };
 
+/* Called with the reply to a request, or NULL if it failed. The reply
+ * is freed by the handler. */
+typedef void (*weston_wm_reply_func_t)(struct weston_wm *wm, void *reply,
+				       void *data);
+
+struct weston_wm_request;
+
+struct weston_wm_request *
+weston_wm_request(struct weston_wm *wm, unsigned int sequence,
+		  weston_wm_reply_func_t func, void *data);
+void
+weston_wm_request_cancel(struct weston_wm *wm,
+			 struct weston_wm_request *request);
+
+int __attribute__ ((format (printf, 1, 2)))
+wm_log(const char *fmt, ...);
+int __attribute__ ((format (printf, 1, 2)))
+wm_log_continue(const char *fmt, ...);
+
 void
 dump_property(struct weston_wm *wm, xcb_atom_t property,
 	      xcb_get_property_reply_t *reply);